@@ -0,0 +1,264 @@
+#include "apic.h"
+#include "lib.h"
+#include "i8259.h"
+#include "idt.h"
+#include "paging.h"
+#include "timer.h"
+
+uint32_t lapic_base = 0;
+uint32_t ioapic_base = 0;
+
+// the APICs deliver the device interrupts instead of the 8259
+static uint32_t apic_on = 0;
+static uint32_t lapic_is_mapped = 0;
+// redirection entries of the I/O APIC, and the cpu they deliver to
+static uint32_t ioapic_pins = 0;
+static uint32_t boot_apic_id = 0;
+// pin and MP flags of each ISA line, the MP table overrides the identity
+static uint8_t isa_pin[ISA_IRQS] = {
+    0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15
+};
+static uint16_t isa_flags[ISA_IRQS];
+
+/* read an I/O APIC register */
+static uint32_t ioapic_read(uint32_t reg);
+/* write an I/O APIC register */
+static void ioapic_write(uint32_t reg, uint32_t value);
+/* program the redirection entry of an ISA line, masked or not */
+static void ioapic_route(uint32_t irq, uint32_t masked);
+
+/* void init_apic()
+ * --------------------------------------------------------------------------------------
+ * Descriptions:    Switch the device interrupts from the 8259 to the I/O
+ *                  APIC and the local APIC of the boot cpu. Needs the
+ *                  addresses smp_detect read from the MP table; without
+ *                  them, without an APIC in cpuid or with "noapic" on the
+ *                  boot command line the 8259 stays. Must run after
+ *                  i8259_init and before the first enable_irq of a device.
+ * Inputs:          None
+ * Outputs:         None
+ * Side Effects:    Masks every line of the 8259 and the I/O APIC
+ */
+void init_apic() {
+    uint32_t features;
+    uint32_t pin;
+
+    if (cmdline_has(boot_cmdline, (int8_t*)"noapic") || lapic_base == 0 || ioapic_base == 0)
+        return;
+
+    // cpuid leaf 1 reports the local APIC in bit 9 of edx
+    asm volatile(
+        "movl $1, %%eax                     ;"
+        "cpuid                              ;"
+        : "=d" (features)
+        :
+        : "eax", "ebx", "ecx");
+    if (!(features & CPUID_APIC))
+        return;
+
+    lapic_map();
+    map_mmio(ioapic_base);
+
+    // the 8259 stays programmed, but raises nothing
+    i8259_mask_all();
+
+    lapic_write(LAPIC_TPR, 0);
+    lapic_write(LAPIC_LVT_TIMER, LAPIC_LVT_MASKED);
+    lapic_write(LAPIC_SVR, LAPIC_SVR_ENABLE | IDT_SPURIOUS);
+    boot_apic_id = lapic_read(LAPIC_ID) >> LAPIC_ID_SHIFT;
+
+    ioapic_pins = ((ioapic_read(IOAPIC_VER) >> IOAPIC_MAX_SHIFT) & IOAPIC_MAX_MASK) + 1;
+    for (pin = 0; pin < ioapic_pins; pin++)
+        ioapic_write(IOAPIC_REDTBL + 2 * pin, IOAPIC_MASKED);
+
+    apic_on = 1;
+    printf("APIC: I/O APIC with %d pins\n", ioapic_pins);
+}
+
+/* uint32_t apic_enabled()
+ * Inputs: none
+ * Return Value: 1 if the APICs deliver the device interrupts, 0 for the 8259
+ * Function: tell enable_irq, send_eoi and the timer which hardware to use
+ */
+uint32_t apic_enabled() {
+    return apic_on;
+}
+
+/* void ioapic_set_isa_irq(uint32_t irq, uint32_t pin, uint32_t flags)
+ * Inputs: irq -- an ISA line
+ *         pin -- the I/O APIC pin it is wired to
+ *         flags -- polarity and trigger mode of the MP table entry
+ * Return Value: none
+ * Function: record an interrupt entry of the MP table, like IRQ 0 on pin 2
+ */
+void ioapic_set_isa_irq(uint32_t irq, uint32_t pin, uint32_t flags) {
+    if (irq >= ISA_IRQS)
+        return;
+    isa_pin[irq] = pin;
+    isa_flags[irq] = flags;
+}
+
+/* void ioapic_enable_irq(uint32_t irq)
+ * Inputs: irq -- an ISA line
+ * Return Value: none
+ * Function: deliver the line to the boot cpu on vector IRQ_VECTOR_BASE + irq
+ */
+void ioapic_enable_irq(uint32_t irq) {
+    ioapic_route(irq, 0);
+}
+
+/* void ioapic_disable_irq(uint32_t irq)
+ * Inputs: irq -- an ISA line
+ * Return Value: none
+ * Function: mask the line
+ */
+void ioapic_disable_irq(uint32_t irq) {
+    ioapic_route(irq, IOAPIC_MASKED);
+}
+
+/* uint32_t ioapic_irq_entry(uint32_t irq)
+ * Inputs: irq -- an ISA line
+ * Return Value: low half of its redirection entry, IOAPIC_MASKED without one
+ * Function: read back how the line is routed
+ */
+uint32_t ioapic_irq_entry(uint32_t irq) {
+    uint32_t flags;
+    uint32_t entry;
+
+    if (!apic_on || irq >= ISA_IRQS || isa_pin[irq] >= ioapic_pins)
+        return IOAPIC_MASKED;
+    cli_and_save(flags);
+    entry = ioapic_read(IOAPIC_REDTBL + 2 * isa_pin[irq]);
+    restore_flags(flags);
+    return entry;
+}
+
+/* void lapic_eoi()
+ * Inputs: none
+ * Return Value: none
+ * Function: finish the interrupt in service with the highest priority
+ */
+void lapic_eoi() {
+    lapic_write(LAPIC_EOI, 0);
+}
+
+/* void lapic_map()
+ * Inputs: none
+ * Return Value: none
+ * Function: map the registers of the local APIC the first time
+ */
+void lapic_map() {
+    if (lapic_is_mapped)
+        return;
+    map_mmio(lapic_base);
+    lapic_is_mapped = 1;
+}
+
+/* uint32_t lapic_mapped()
+ * Inputs: none
+ * Return Value: 1 if the local APIC registers can be read
+ * Function: tell smp_cpu_id whether it can ask the local APIC
+ */
+uint32_t lapic_mapped() {
+    return lapic_is_mapped;
+}
+
+/* uint32_t lapic_read(uint32_t reg)
+ * Inputs: reg -- register offset
+ * Return Value: the register
+ * Function: read a local APIC register
+ */
+uint32_t lapic_read(uint32_t reg) {
+    return *(volatile uint32_t*)(lapic_base + reg);
+}
+
+/* void lapic_write(uint32_t reg, uint32_t value)
+ * Inputs: reg -- register offset
+ *         value -- what to write
+ * Return Value: none
+ * Function: write a local APIC register
+ */
+void lapic_write(uint32_t reg, uint32_t value) {
+    *(volatile uint32_t*)(lapic_base + reg) = value;
+}
+
+/* uint32_t lapic_timer_calibrate()
+ * --------------------------------------------------------------------------------------
+ * Descriptions:    Count down the local APIC timer for LAPIC_CALIBRATE_MS
+ *                  on the TSC to learn its rate, which depends on the bus
+ *                  clock. Called by init_pit once the TSC is calibrated.
+ * Inputs:          None
+ * Outputs:         timer counts per millisecond, 0 without the APICs or a TSC
+ * Side Effects:    Leaves the timer masked and stopped
+ */
+uint32_t lapic_timer_calibrate() {
+    uint32_t elapsed;
+
+    if (!apic_on || timer_tsc_per_ms() == 0)
+        return 0;
+
+    lapic_write(LAPIC_TIMER_DIV, LAPIC_DIV_16);
+    lapic_write(LAPIC_LVT_TIMER, LAPIC_LVT_MASKED);
+    lapic_write(LAPIC_TIMER_INIT, 0xFFFFFFFF);
+    timer_udelay(LAPIC_CALIBRATE_MS * 1000);
+    elapsed = 0xFFFFFFFF - lapic_read(LAPIC_TIMER_CUR);
+    lapic_write(LAPIC_TIMER_INIT, 0);
+
+    return elapsed / LAPIC_CALIBRATE_MS;
+}
+
+/* void lapic_timer_oneshot(uint32_t count)
+ * Inputs: count -- timer counts until the interrupt, at least 1
+ * Return Value: none
+ * Function: arm the timer, a timer still counting starts over
+ */
+void lapic_timer_oneshot(uint32_t count) {
+    lapic_write(LAPIC_LVT_TIMER, IDT_PIT);
+    lapic_write(LAPIC_TIMER_INIT, count > 0 ? count : 1);
+}
+
+/* void lapic_timer_stop()
+ * Inputs: none
+ * Return Value: none
+ * Function: disarm the timer
+ */
+void lapic_timer_stop() {
+    lapic_write(LAPIC_LVT_TIMER, LAPIC_LVT_MASKED);
+    lapic_write(LAPIC_TIMER_INIT, 0);
+}
+
+static uint32_t ioapic_read(uint32_t reg) {
+    *(volatile uint32_t*)(ioapic_base + IOAPIC_IOREGSEL) = reg;
+    return *(volatile uint32_t*)(ioapic_base + IOAPIC_IOWIN);
+}
+
+static void ioapic_write(uint32_t reg, uint32_t value) {
+    *(volatile uint32_t*)(ioapic_base + IOAPIC_IOREGSEL) = reg;
+    *(volatile uint32_t*)(ioapic_base + IOAPIC_IOWIN) = value;
+}
+
+static void ioapic_route(uint32_t irq, uint32_t masked) {
+    uint32_t entry;
+    uint32_t flags;
+    uint32_t pin;
+
+    // the 8259 cascade is no line of its own
+    if (!apic_on || irq >= ISA_IRQS || irq == PIC_CASCADE_IRQ)
+        return;
+    pin = isa_pin[irq];
+    if (pin >= ioapic_pins)
+        return;
+
+    // ISA lines are edge triggered and active high unless the MP table says otherwise
+    entry = (IRQ_VECTOR_BASE + irq) | masked;
+    if ((isa_flags[irq] & MP_IRQ_POLARITY) == MP_IRQ_ACTIVE_LOW)
+        entry |= IOAPIC_ACTIVE_LOW;
+    if ((isa_flags[irq] & MP_IRQ_TRIGGER) == MP_IRQ_LEVEL)
+        entry |= IOAPIC_LEVEL;
+
+    // the index and the window are one access
+    cli_and_save(flags);
+    ioapic_write(IOAPIC_REDTBL + 2 * pin + 1, boot_apic_id << IOAPIC_DEST_SHIFT);
+    ioapic_write(IOAPIC_REDTBL + 2 * pin, entry);
+    restore_flags(flags);
+}
@@ -0,0 +1,98 @@
+#ifndef APIC_H
+#define APIC_H
+
+#include "types.h"
+
+/*
+ * The local APIC and the I/O APIC take over from the 8259 and the PIT when
+ * the MP table lists an I/O APIC, unless "noapic" is on the boot command
+ * line. The I/O APIC sends the ISA lines to the boot cpu on the vectors the
+ * 8259 used, so the idt does not change, and enable_irq, disable_irq and
+ * send_eoi forward here. The tick comes from the local APIC timer in one
+ * shot mode on the PIT vector, measured against the TSC at boot. An EOI
+ * is one register write instead of port I/O to one or two PICs.
+ */
+#define LAPIC_DEFAULT_BASE  0xFEE00000
+#define IOAPIC_DEFAULT_BASE 0xFEC00000
+
+// local APIC registers, offsets from lapic_base
+#define LAPIC_ID            0x020
+#define LAPIC_TPR           0x080
+#define LAPIC_EOI           0x0B0
+#define LAPIC_SVR           0x0F0
+#define LAPIC_ICR_LOW       0x300
+#define LAPIC_ICR_HIGH      0x310
+#define LAPIC_LVT_TIMER     0x320
+#define LAPIC_TIMER_INIT    0x380
+#define LAPIC_TIMER_CUR     0x390
+#define LAPIC_TIMER_DIV     0x3E0
+#define LAPIC_ID_SHIFT      24
+#define LAPIC_SVR_ENABLE    0x100
+#define LAPIC_LVT_MASKED    0x10000         // one shot mode when the periodic bit is clear
+#define LAPIC_DIV_16        0x3
+#define LAPIC_CALIBRATE_MS  10
+
+// I/O APIC registers, through the index at IOREGSEL and the window at IOWIN
+#define IOAPIC_IOREGSEL     0x00
+#define IOAPIC_IOWIN        0x10
+#define IOAPIC_VER          0x01
+#define IOAPIC_REDTBL       0x10            // two registers per pin
+#define IOAPIC_MAX_SHIFT    16
+#define IOAPIC_MAX_MASK     0xFF
+#define IOAPIC_VECTOR_MASK  0xFF
+#define IOAPIC_MASKED       0x10000
+#define IOAPIC_LEVEL        0x8000
+#define IOAPIC_ACTIVE_LOW   0x2000
+#define IOAPIC_DEST_SHIFT   24              // in the high register
+
+#define ISA_IRQS            16
+#define IRQ_VECTOR_BASE     0x20            // vector of IRQ 0, as on the 8259
+#define PIC_CASCADE_IRQ     2               // no such line on the I/O APIC
+
+// polarity and trigger of an interrupt entry of the MP table
+#define MP_IRQ_POLARITY     0x3
+#define MP_IRQ_ACTIVE_LOW   0x3
+#define MP_IRQ_TRIGGER      0xC
+#define MP_IRQ_LEVEL        0xC
+
+#define CPUID_APIC          0x00000200
+
+#ifndef ASM
+
+extern uint32_t lapic_base;
+extern uint32_t ioapic_base;
+
+/* switch from the 8259 to the APICs if the MP table found them, after init_page */
+extern void init_apic();
+/* 1 once init_apic switched to the APICs */
+extern uint32_t apic_enabled();
+/* record the I/O APIC pin and MP flags of an ISA line, called by smp_detect */
+extern void ioapic_set_isa_irq(uint32_t irq, uint32_t pin, uint32_t flags);
+/* unmask an ISA line on the I/O APIC */
+extern void ioapic_enable_irq(uint32_t irq);
+/* mask an ISA line on the I/O APIC */
+extern void ioapic_disable_irq(uint32_t irq);
+/* low half of the redirection entry of an ISA line */
+extern uint32_t ioapic_irq_entry(uint32_t irq);
+/* end of interrupt on the local APIC */
+extern void lapic_eoi();
+
+/* map the local APIC registers, can be called again */
+extern void lapic_map();
+/* 1 once the local APIC registers are mapped */
+extern uint32_t lapic_mapped();
+/* read a local APIC register */
+extern uint32_t lapic_read(uint32_t reg);
+/* write a local APIC register */
+extern void lapic_write(uint32_t reg, uint32_t value);
+
+/* local APIC timer counts per millisecond, measured with the TSC, 0 if unusable */
+extern uint32_t lapic_timer_calibrate();
+/* fire the PIT vector once after count timer counts */
+extern void lapic_timer_oneshot(uint32_t count);
+/* stop the local APIC timer */
+extern void lapic_timer_stop();
+
+#endif /* ASM */
+
+#endif
@@ -0,0 +1,211 @@
+#include "cpu_group.h"
+#include "scheduling.h"
+
+// a group's share of the cpu, in microseconds it ran
+typedef struct {
+    uint32_t quota;
+    uint32_t period_us;
+    uint64_t total_us;
+    uint32_t throttle_count;
+    uint32_t throttled;
+} cpu_group_t;
+
+static cpu_group_t groups[MAX_TERMINAL_NUM] = {
+    {GROUP_QUOTA_MAX, 0, 0, 0, 0},
+    {GROUP_QUOTA_MAX, 0, 0, 0, 0},
+    {GROUP_QUOTA_MAX, 0, 0, 0, 0}
+};
+// timer_now_ms when the current period started
+static uint32_t period_start = 0;
+// fires at the end of a period in which a group was throttled
+static ktimer_t period_timer;
+// time stamp up to which the task on the cpu was charged
+static uint64_t charged_tsc = 0;
+
+/* the group pcb is charged to, NULL for kernel and real time tasks */
+static cpu_group_t* task_group(pcb_t* pcb);
+/* microseconds since the last charge, a whole tick without a TSC */
+static uint32_t charge_time(uint32_t tick);
+/* add time to a group, and throttle it once it used its quota */
+static uint32_t charge_group(cpu_group_t* group, uint32_t used_us);
+/* start a new period, every throttled group gets the cpu back */
+static void new_period(uint32_t now);
+/* timer callback at the end of a period */
+static void period_expire(uint32_t data);
+
+/* uint32_t cpu_group_charge(pcb_t* pcb)
+ * --------------------------------------------------------------------------------------
+ * Descriptions:    Called by pit_handler for the task a tick hit. Starts a
+ *                  new period when the last one is over, then charges the
+ *                  group of the task the time the task ran since its last
+ *                  charge. A group that reaches its quota is throttled until
+ *                  the end of the period, and a timer makes sure that end
+ *                  comes even if the cpu goes idle meanwhile.
+ * Inputs:          pcb_t* pcb :    the task on the cpu
+ * Outputs:         1 if the group is throttled, its queued tasks have to
+ *                  come off the run queue, 0 otherwise
+ * Side Effects:    Arms the period timer
+ */
+uint32_t cpu_group_charge(pcb_t* pcb) {
+    cpu_group_t * group = task_group(pcb);
+    uint32_t now = timer_now_ms();
+    uint32_t used_us = charge_time(1);
+
+    if ((int32_t)(now - period_start) >= GROUP_PERIOD_MS)
+        new_period(now);
+    if (group == NULL)
+        return 0;
+    return charge_group(group, used_us);
+}
+
+/* void cpu_group_switch(pcb_t* prev)
+ * Inputs: prev -- the task leaving the cpu, NULL for the idle loop
+ * Return Value: none
+ * Function: called by schedule with interrupts disabled. Charges prev the
+ *           part of its slice after the last tick, so a task that always
+ *           blocks before the tick pays too. A group that used its quota
+ *           is marked throttled, its woken tasks stay off the run queue and
+ *           the queued ones come off at the next tick that hits one.
+ */
+void cpu_group_switch(pcb_t* prev) {
+    cpu_group_t * group = task_group(prev);
+    uint32_t used_us = charge_time(0);
+
+    if (group != NULL)
+        charge_group(group, used_us);
+}
+
+/* uint32_t cpu_group_throttled(pcb_t* pcb)
+ * Inputs: pcb -- a task
+ * Return Value: 1 if its group used its quota for this period, 0 otherwise
+ * Function: tell sched_wake to keep a woken task off the run queue
+ */
+uint32_t cpu_group_throttled(pcb_t* pcb) {
+    cpu_group_t * group = task_group(pcb);
+
+    return group != NULL && group->throttled;
+}
+
+/*
+ * Function:  int32_t cpu_quota(uint32_t terminal, uint32_t percent)
+ * --------------------
+ * This function sets how much of each period the processes of a terminal
+ * may run together. GROUP_QUOTA_MAX lifts the limit. A throttled terminal
+ * whose new quota is above what it used runs again right away.
+ *
+ *  Inputs:     uint32_t terminal: 0 to MAX_TERMINAL_NUM - 1
+ *              uint32_t percent: GROUP_QUOTA_MIN to GROUP_QUOTA_MAX
+ *
+ *  Returns:    -1: no such terminal or percent out of range
+ *              0: success
+ *
+ *  Side effects: may change the run queue
+ *
+ */
+int32_t cpu_quota(uint32_t terminal, uint32_t percent) {
+    cpu_group_t * group;
+    uint32_t flags;
+
+    if (terminal >= MAX_TERMINAL_NUM || percent < GROUP_QUOTA_MIN || percent > GROUP_QUOTA_MAX)
+        return -1;
+
+    cli_and_save(flags);
+    group = &groups[terminal];
+    group->quota = percent;
+    if (group->throttled && (percent >= GROUP_QUOTA_MAX
+            || group->period_us < percent * (GROUP_PERIOD_MS * 1000 / GROUP_QUOTA_MAX))) {
+        group->throttled = 0;
+        sched_unthrottle(terminal);
+    }
+    restore_flags(flags);
+    return 0;
+}
+
+/*
+ * Function:  int32_t cpu_groups(cpu_group_info_t* buf)
+ * --------------------
+ * This function reports the quota and the cpu time of every terminal.
+ *
+ *  Inputs:     cpu_group_info_t* buf: room for MAX_TERMINAL_NUM entries in
+ *                                     the program page
+ *
+ *  Returns:    -1: the buffer is not writable
+ *              n: the number of entries, MAX_TERMINAL_NUM
+ *
+ *  Side effects: none
+ *
+ */
+int32_t cpu_groups(cpu_group_info_t* buf) {
+    cpu_group_info_t info[MAX_TERMINAL_NUM];
+    uint32_t i;
+    uint32_t flags;
+
+    if (user_writable((uint32_t)buf, sizeof(info)) == -1)
+        return -1;
+
+    // a consistent picture, then copy it out where a page fault may come
+    cli_and_save(flags);
+    for (i = 0; i < MAX_TERMINAL_NUM; i++) {
+        info[i].terminal_id = i;
+        info[i].quota = groups[i].quota;
+        info[i].period_ms = groups[i].period_us / 1000;
+        info[i].total_ms = (uint32_t)udiv64(groups[i].total_us, 1000);
+        info[i].throttle_count = groups[i].throttle_count;
+        info[i].throttled = groups[i].throttled;
+    }
+    restore_flags(flags);
+
+    memcpy(buf, info, sizeof(info));
+    return MAX_TERMINAL_NUM;
+}
+
+static cpu_group_t* task_group(pcb_t* pcb) {
+    if (pcb == NULL || pcb->kthread || pcb->policy != SCHED_NORMAL || pcb->terminal_id >= MAX_TERMINAL_NUM)
+        return NULL;
+    return &groups[pcb->terminal_id];
+}
+
+static uint32_t charge_time(uint32_t tick) {
+    uint64_t now = timer_tsc();
+    uint64_t used;
+
+    if (now == 0)
+        return tick ? timer_tick_us() : 0;
+    used = charged_tsc != 0 ? now - charged_tsc : 0;
+    charged_tsc = now;
+    return (uint32_t)udiv64(used * 1000, timer_tsc_per_ms());
+}
+
+static uint32_t charge_group(cpu_group_t* group, uint32_t used_us) {
+    group->period_us += used_us;
+    group->total_us += used_us;
+    if (group->throttled)
+        return 1;
+    if (group->quota >= GROUP_QUOTA_MAX
+            || group->period_us < group->quota * (GROUP_PERIOD_MS * 1000 / GROUP_QUOTA_MAX))
+        return 0;
+
+    group->throttled = 1;
+    group->throttle_count++;
+    if (!period_timer.pending)
+        timer_add(&period_timer, period_start + GROUP_PERIOD_MS, period_expire, 0);
+    return 1;
+}
+
+static void new_period(uint32_t now) {
+    uint32_t i;
+
+    period_start = now;
+    timer_del(&period_timer);
+    for (i = 0; i < MAX_TERMINAL_NUM; i++) {
+        groups[i].period_us = 0;
+        if (groups[i].throttled) {
+            groups[i].throttled = 0;
+            sched_unthrottle(i);
+        }
+    }
+}
+
+static void period_expire(uint32_t data) {
+    new_period(timer_now_ms());
+}
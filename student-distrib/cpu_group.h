@@ -0,0 +1,44 @@
+#ifndef CPU_GROUP_H
+#define CPU_GROUP_H
+
+#include "types.h"
+#include "lib.h"
+
+/*
+ * CPU bandwidth groups, one per terminal: the processes and threads of a
+ * terminal, background jobs included, share a quota of each period of
+ * GROUP_PERIOD_MS. A task is charged the time it actually ran, measured
+ * with the TSC at every switch and every tick, or the length of a tick
+ * without a TSC. Once a group used its quota, the scheduler takes its tasks off
+ * the run queue until the period ends, whatever the scheduling class
+ * thinks of them, so a runaway program on one terminal leaves the rest of
+ * each period to the others. Kernel tasks and real time tasks belong to
+ * no group. Every quota starts at GROUP_QUOTA_MAX, which never throttles.
+ */
+#define GROUP_PERIOD_MS     1000
+#define GROUP_QUOTA_MAX     100             // percent of a period, no limit
+#define GROUP_QUOTA_MIN     1
+
+// what cpu_groups reports for each terminal, same layout in the programs
+typedef struct {
+    uint32_t terminal_id;
+    uint32_t quota;                     // percent of each period
+    uint32_t period_ms;                 // used in the current period
+    uint32_t total_ms;                  // used since boot
+    uint32_t throttle_count;            // periods cut short by the quota
+    uint32_t throttled;                 // off the cpu until the period ends
+} cpu_group_info_t;
+
+/* charge pcb the time it ran since it was last charged, 1 if its group is out of quota */
+extern uint32_t cpu_group_charge(pcb_t* pcb);
+/* charge prev the rest of its slice when it leaves the cpu */
+extern void cpu_group_switch(pcb_t* prev);
+/* 1 if pcb belongs to a group that used its quota */
+extern uint32_t cpu_group_throttled(pcb_t* pcb);
+
+/* system call: set the quota of a terminal in percent of each period */
+extern int32_t cpu_quota(uint32_t terminal, uint32_t percent);
+/* system call: fill buf with one cpu_group_info_t per terminal */
+extern int32_t cpu_groups(cpu_group_info_t* buf);
+
+#endif
@@ -0,0 +1,151 @@
+#include "cpustat.h"
+#include "scheduling.h"
+
+// cost of the context switches since boot or the last reset
+static uint32_t switch_count = 0;
+static uint64_t switch_cycles = 0;
+static uint64_t switch_mm_cycles = 0;
+static uint32_t switch_min = 0;
+static uint32_t switch_max = 0;
+static uint32_t switch_hist[SWITCH_HIST_BUCKETS];
+
+/* convert time stamp counter cycles to milliseconds, 0 without a TSC */
+static uint32_t tsc_to_ms(uint64_t cycles);
+
+/*
+ * Function:  int32_t cpustat(cpustat_t* buf)
+ * --------------------
+ * This function reports where the cpu time went: the uptime, the time the
+ * idle loop had the cpu, and for the first CPUSTAT_MAX_PROCS processes and
+ * threads their runtime, context switches and system calls. Kernel tasks
+ * are not listed, their time is what the rest leaves of the uptime.
+ *
+ *  Inputs:     cpustat_t* buf: a writable buffer in the program page
+ *
+ *  Returns:    -1: failed
+ *              n: the number of processes that exist
+ *
+ *  Side effects: none
+ *
+ */
+int32_t cpustat(cpustat_t* buf) {
+    cpustat_t stat;
+    cpustat_proc_t * proc;
+    pcb_t * pcb;
+    uint32_t pid;
+    uint32_t flags;
+
+    if (user_writable((uint32_t)buf, sizeof(cpustat_t)) == -1)
+        return -1;
+
+    // the pcbs change under a context switch or an exit, copy them out first
+    cli_and_save(flags);
+    stat.uptime_ms = timer_now_ms();
+    stat.idle_ms = tsc_to_ms(sched_idle_time());
+    stat.switches = sched_switch_count();
+
+    stat.num_procs = 0;
+    for (pid = 0; pid < max_task; pid++) {
+        if ((pcb = get_pcb_by_index(pid)) == NULL)
+            continue;
+        if (stat.num_procs < CPUSTAT_MAX_PROCS) {
+            proc = &stat.procs[stat.num_procs];
+            proc->pid = pcb->pid;
+            proc->parent_pid = pcb->parent_pid;
+            proc->terminal_id = pcb->terminal_id;
+            proc->state = pcb->state;
+            proc->nice = pcb->nice;
+            proc->runtime_ms = tsc_to_ms(sched_runtime(pcb));
+            proc->nvcsw = pcb->nvcsw;
+            proc->nivcsw = pcb->nivcsw;
+            proc->syscalls = pcb->syscall_count;
+            strncpy((int8_t*)proc->name, (int8_t*)pcb->name, PROC_NAME_LEN);
+            proc->name[PROC_NAME_LEN - 1] = '\0';
+        }
+        stat.num_procs++;
+    }
+    restore_flags(flags);
+
+    memcpy(buf, &stat, sizeof(stat));
+    return stat.num_procs;
+}
+
+/*
+ * Function:  int32_t switch_stat(switch_stat_t* buf, uint32_t reset)
+ * --------------------
+ * This function reports what a context switch cost so far: from the
+ * moment schedule() starts to install the next task to the moment that
+ * task runs on its own stack, with the part spent on the program page,
+ * the video mapping and the tlb flushes apart. A benchmark resets the
+ * figures before it starts, so they only cover its own switches.
+ *
+ *  Inputs:     switch_stat_t* buf: a writable buffer in the program page
+ *              uint32_t reset: nonzero to start counting again afterwards
+ *
+ *  Returns:    -1: failed
+ *              n: the number of switches measured
+ *
+ *  Side effects: none
+ *
+ */
+int32_t switch_stat(switch_stat_t* buf, uint32_t reset) {
+    switch_stat_t stat;
+    uint32_t i;
+    uint32_t flags;
+
+    if (user_writable((uint32_t)buf, sizeof(switch_stat_t)) == -1)
+        return -1;
+
+    cli_and_save(flags);
+    stat.tsc_per_ms = timer_tsc_per_ms();
+    stat.count = switch_count;
+    stat.avg_cycles = switch_count == 0 ? 0 : (uint32_t)udiv64(switch_cycles, switch_count);
+    stat.min_cycles = switch_min;
+    stat.max_cycles = switch_max;
+    stat.avg_mm_cycles = switch_count == 0 ? 0 : (uint32_t)udiv64(switch_mm_cycles, switch_count);
+    for (i = 0; i < SWITCH_HIST_BUCKETS; i++)
+        stat.hist[i] = switch_hist[i];
+    if (reset) {
+        switch_count = 0;
+        switch_cycles = 0;
+        switch_mm_cycles = 0;
+        switch_min = 0;
+        switch_max = 0;
+        memset(switch_hist, 0, sizeof(switch_hist));
+    }
+    restore_flags(flags);
+
+    memcpy(buf, &stat, sizeof(stat));
+    return stat.count;
+}
+
+/* void switch_record(uint32_t cycles, uint32_t mm_cycles)
+ * Inputs: cycles -- what the whole switch took
+ *         mm_cycles -- the part switch_address_space took
+ * Return Value: none
+ * Function: called by schedule_tail with interrupts disabled
+ */
+void switch_record(uint32_t cycles, uint32_t mm_cycles) {
+    uint32_t bucket = 0;
+    uint32_t c = cycles >> SWITCH_HIST_SHIFT;
+
+    while (c > 1 && bucket < SWITCH_HIST_BUCKETS - 1) {
+        c >>= 1;
+        bucket++;
+    }
+    switch_hist[bucket]++;
+
+    if (switch_count == 0 || cycles < switch_min)
+        switch_min = cycles;
+    if (cycles > switch_max)
+        switch_max = cycles;
+    switch_count++;
+    switch_cycles += cycles;
+    switch_mm_cycles += mm_cycles;
+}
+
+static uint32_t tsc_to_ms(uint64_t cycles) {
+    uint32_t per_ms = timer_tsc_per_ms();
+
+    return per_ms == 0 ? 0 : (uint32_t)udiv64(cycles, per_ms);
+}
@@ -0,0 +1,50 @@
+#ifndef CPUSTAT_H
+#define CPUSTAT_H
+
+#include "types.h"
+#include "lib.h"
+
+#define CPUSTAT_MAX_PROCS   16          // processes one cpustat call reports
+#define SWITCH_HIST_BUCKETS 16
+#define SWITCH_HIST_SHIFT   8               // bucket 0 holds switches under 512 cycles
+
+typedef struct {
+    uint32_t pid;
+    uint32_t parent_pid;
+    uint32_t terminal_id;
+    uint32_t state;                     // TASK_RUNNABLE, TASK_BLOCKED, ...
+    int32_t nice;
+    uint32_t runtime_ms;                // time on the cpu, measured with the TSC
+    uint32_t nvcsw;                     // voluntary context switches
+    uint32_t nivcsw;                    // involuntary context switches
+    uint32_t syscalls;
+    uint8_t name[PROC_NAME_LEN];
+} cpustat_proc_t;
+
+typedef struct {
+    uint32_t uptime_ms;
+    uint32_t idle_ms;                   // time the cpu had no task to run
+    uint32_t switches;                  // context switches since boot
+    uint32_t num_procs;                 // processes that exist
+    cpustat_proc_t procs[CPUSTAT_MAX_PROCS];
+} cpustat_t;
+
+// what a context switch costs, in time stamp counter cycles
+typedef struct {
+    uint32_t tsc_per_ms;                // to convert the cycles, 0 without a TSC
+    uint32_t count;                     // switches measured
+    uint32_t avg_cycles;
+    uint32_t min_cycles;
+    uint32_t max_cycles;
+    uint32_t avg_mm_cycles;             // of that, the switch of the address space
+    uint32_t hist[SWITCH_HIST_BUCKETS]; // bucket i from 2^(i + 8) to 2^(i + 9) cycles
+} switch_stat_t;
+
+// system calls
+int32_t cpustat(cpustat_t* buf);
+int32_t switch_stat(switch_stat_t* buf, uint32_t reset);
+
+/* add the cost of one context switch to the switch statistics */
+extern void switch_record(uint32_t cycles, uint32_t mm_cycles);
+
+#endif
@@ -21,7 +21,14 @@ void bound_range_exception() {
 void invalid_opcode_exception() {
     print_exception("EXCEPTION: invalid_opcode_exception!\n");
 }
-void device_not_available_exception() {
+/* void device_not_available_handler()
+ * Inputs: none
+ * Return Value: void
+ * Function: hand the FPU to the task that tried to use it, the
+ *           instruction then runs again */
+void device_not_available_handler() {
+    if (fpu_trap() == 0)
+        return;
     print_exception("EXCEPTION: device_not_available_exception!\n");
 }
 void double_fault_exception() {
@@ -42,20 +49,24 @@ void stack_fault_exception() {
 void general_protection_exception() {
     print_exception("EXCEPTION: general_protection_exception!\n");
 }
-void page_fault_exception() {
-    uint32_t * addr;
-    uint32_t  addr1;
-    uint32_t val;
+/* void page_fault_handler(uint32_t error)
+ * Inputs: uint32_t error -- the error code pushed by the processor
+ * Return Value: void
+ * Function: bring back a page that is in swap, any other page fault
+ *           kills the program */
+void page_fault_handler(uint32_t error) {
+    uint32_t addr;
     asm volatile(
         "movl %%cr2, %%eax;"
-        "movl %%esp, %%ebx"
-        : "=a" (addr),  "=b" (addr1)
+        : "=a" (addr)
         :
         : "cc"
     );
-    val = *(uint32_t*)((uint32_t)(addr1) - 12);
+    // a non-present page may only be in swap
+    if (!(error & PRESENT_MASK) && swap_in(addr) == 0)
+        return;
     printf("exception occur at address: 0x%x\n", addr);
-    printf("user esp at address: 0x%x\n", val);
+    printf("error code: 0x%x\n", error);
     print_exception("EXCEPTION: page_fault_exception!\n");
 }
 void fpu_floating_point_exception() {
@@ -4,6 +4,8 @@
 #include "lib.h"
 #include "x86_desc.h"
 #include "syscall.h"
+#include "swap.h"
+#include "fpu.h"
 
 #define EXCEPTION_MAGIC 0x0F
 
@@ -15,14 +17,14 @@ void breakpoint_exception();
 void overflow_exception();
 void bound_range_exception();
 void invalid_opcode_exception();
-void device_not_available_exception();
+void device_not_available_handler();
 void double_fault_exception();
 void coprocessor_exception();
 void invalid_tss_exception();
 void segment_not_present_exception();
 void stack_fault_exception();
 void general_protection_exception();
-void page_fault_exception();
+void page_fault_handler(uint32_t error);
 void fpu_floating_point_exception();
 void alignment_check_exception();
 void machine_check_exception();
@@ -227,6 +227,27 @@ int32_t read_data(uint32_t inode, uint32_t offset, uint8_t* buf, uint32_t length
     return real_length;
 }
 
+/*
+ * Function:  int32_t get_file_size(uint32_t inode)
+ * --------------------
+ * This function returns the length of a file, which is the first field
+ * of its index node.
+ *
+ *  Inputs:     uint32_t inode: the index node of the file
+ *
+ *  Returns:    >=0: size of the file in bytes
+ *              -1: invalid index of index node
+ *
+ *  Side effects: none
+ *
+ */
+int32_t get_file_size(uint32_t inode){
+    if(inode >= num_inodes - 1){
+        return -1;              // invalid inode
+    }
+    return *((uint32_t*)(inode_addr + BLOCKSIZE * inode));
+}
+
 /*            driver for file system directory              */
 
 /*
@@ -389,7 +410,7 @@ int32_t file_read(int32_t fd, void *buf, int32_t nbytes){
     pcb_t * pcb;            // pcb pointer
     uint32_t offset;
 
-    pcb = get_curr_pcb();
+    pcb = get_curr_proc();
     
     inode_idx = pcb->files[fd].inode;
     offset = pcb->files[fd].file_pos;
@@ -43,6 +43,8 @@ void filesystem_init(uint32_t starting_addr);
 int32_t read_dentry_by_name(const uint8_t* fname, dentry_t* dentry);
 int32_t read_dentry_by_index(uint32_t index, dentry_t* dentry);
 int32_t read_data(uint32_t inode, uint32_t offset, uint8_t* buf, uint32_t length);
+// size in bytes of the file behind an inode
+int32_t get_file_size(uint32_t inode);
 
 // driver functions for directories
 int32_t dir_open(const uint8_t *filename);
@@ -0,0 +1,181 @@
+#include "fpu.h"
+#include "lib.h"
+#include "scheduling.h"
+
+// the task whose registers are in the FPU, NULL if nobody's
+static pcb_t* fpu_owner = NULL;
+// the cpu has FXSAVE/FXRSTOR, and SSE
+static uint32_t fpu_fxsr = 0;
+static uint32_t fpu_sse = 0;
+static uint32_t trap_cnt = 0;
+static uint32_t restore_cnt = 0;
+static uint32_t save_cnt = 0;
+
+/* set CR0.TS, the next FPU instruction traps */
+static void stts();
+/* clear CR0.TS */
+static void clts();
+/* store the FPU registers into the pcb of a task */
+static void fpu_save(pcb_t* pcb);
+/* load the FPU registers from the pcb of a task */
+static void fpu_load(pcb_t* pcb);
+
+/* void init_fpu()
+ * --------------------------------------------------------------------------------------
+ * Descriptions:    Enable the FPU, and SSE when the cpu has FXSAVE, then set
+ *                  TS so that the first task that uses them traps
+ * Inputs:          None
+ * Outputs:         None
+ * Side Effects:    Changing cr0 and cr4
+ */
+void init_fpu() {
+    uint32_t features;
+    uint32_t cr0;
+    uint32_t cr4;
+
+    asm volatile(
+        "movl $1, %%eax                     ;"
+        "cpuid                              ;"
+        : "=d" (features)
+        :
+        : "eax", "ebx", "ecx");
+    fpu_fxsr = (features & CPUID_FXSR) != 0;
+    fpu_sse = fpu_fxsr && (features & CPUID_SSE) != 0;
+
+    asm volatile("movl %%cr0, %0" : "=r" (cr0));
+    cr0 = (cr0 & ~(CR0_EM | CR0_TS)) | CR0_MP | CR0_NE;
+    asm volatile("movl %0, %%cr0" : : "r" (cr0));
+
+    if (fpu_fxsr) {
+        asm volatile("movl %%cr4, %0" : "=r" (cr4));
+        cr4 |= CR4_OSFXSR;
+        if (fpu_sse)
+            cr4 |= CR4_OSXMMEXCPT;
+        asm volatile("movl %0, %%cr4" : : "r" (cr4));
+    }
+
+    asm volatile("fninit");
+    fpu_owner = NULL;
+    stts();
+}
+
+/* int32_t fpu_trap()
+ * --------------------------------------------------------------------------------------
+ * Descriptions:    A task used the FPU while TS was set. If the registers
+ *                  hold the state of another task, save it to that task's
+ *                  pcb, then load the state of the current task, or a clean
+ *                  one the first time it uses the FPU.
+ * Inputs:          None
+ * Outputs:         0 when the instruction can be run again, -1 if no task runs
+ * Side Effects:    Changing cr0 and the FPU registers
+ */
+int32_t fpu_trap() {
+    pcb_t * curr = sched_current();
+    uint32_t flags;
+    uint32_t mxcsr = MXCSR_DEFAULT;
+
+    if (curr == NULL)
+        return -1;
+
+    // a switch in the middle would set TS under us
+    cli_and_save(flags);
+    clts();
+    trap_cnt++;
+    if (fpu_owner != curr) {
+        if (fpu_owner != NULL) {
+            fpu_save(fpu_owner);
+            save_cnt++;
+        }
+        if (curr->fpu_used) {
+            fpu_load(curr);
+            restore_cnt++;
+        } else {
+            asm volatile("fninit");
+            if (fpu_sse)
+                asm volatile("ldmxcsr %0" : : "m" (mxcsr));
+            curr->fpu_used = 1;
+        }
+        fpu_owner = curr;
+    }
+    restore_flags(flags);
+    return 0;
+}
+
+/* void fpu_switch(pcb_t* next)
+ * Inputs: next -- the task about to run, NULL for the idle loop
+ * Return Value: none
+ * Function: leave the FPU open only to the task whose registers it holds
+ */
+void fpu_switch(pcb_t* next) {
+    if (next != NULL && next == fpu_owner)
+        clts();
+    else
+        stts();
+}
+
+/* void fpu_exit(pcb_t* pcb)
+ * Inputs: pcb -- a task that halts
+ * Return Value: none
+ * Function: drop the registers of the task, nobody has to save them
+ */
+void fpu_exit(pcb_t* pcb) {
+    uint32_t flags;
+
+    cli_and_save(flags);
+    if (fpu_owner == pcb)
+        fpu_owner = NULL;
+    restore_flags(flags);
+}
+
+/* uint32_t fpu_trap_count()
+ * Inputs: none
+ * Return Value: number of device-not-available traps so far
+ * Function: report how often a task found the FPU closed
+ */
+uint32_t fpu_trap_count() {
+    return trap_cnt;
+}
+
+/* uint32_t fpu_restore_count()
+ * Inputs: none
+ * Return Value: number of lazy restores so far
+ * Function: report how often the state of a task had to be loaded again
+ */
+uint32_t fpu_restore_count() {
+    return restore_cnt;
+}
+
+/* uint32_t fpu_save_count()
+ * Inputs: none
+ * Return Value: number of saves so far
+ * Function: report how often a task lost the FPU to another one
+ */
+uint32_t fpu_save_count() {
+    return save_cnt;
+}
+
+static void stts() {
+    uint32_t cr0;
+
+    asm volatile("movl %%cr0, %0" : "=r" (cr0));
+    if (!(cr0 & CR0_TS))
+        asm volatile("movl %0, %%cr0" : : "r" (cr0 | CR0_TS));
+}
+
+static void clts() {
+    asm volatile("clts");
+}
+
+static void fpu_save(pcb_t* pcb) {
+    if (fpu_fxsr)
+        asm volatile("fxsave (%0)" : : "r" (pcb->fpu_state) : "memory");
+    else
+        asm volatile("fnsave (%0)" : : "r" (pcb->fpu_state) : "memory");
+}
+
+static void fpu_load(pcb_t* pcb) {
+    if (fpu_fxsr)
+        asm volatile("fxrstor (%0)" : : "r" (pcb->fpu_state) : "memory");
+    else
+        asm volatile("frstor (%0)" : : "r" (pcb->fpu_state) : "memory");
+}
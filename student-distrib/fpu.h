@@ -0,0 +1,39 @@
+#ifndef FPU_H
+#define FPU_H
+
+#include "types.h"
+
+/*
+ * Lazy switching of the x87/SSE registers. A context switch only sets
+ * CR0.TS; the first FPU or SSE instruction of the next task then traps
+ * with device-not-available, and only if the registers belong to another
+ * task are they saved into that task's pcb and the task's own loaded.
+ * A task that never touches the FPU costs one CR0 write per switch.
+ */
+#define CR0_MP              0x00000002      // wait and TS trap together
+#define CR0_EM              0x00000004      // no FPU, every instruction traps
+#define CR0_TS              0x00000008      // task switched, the next FPU use traps
+#define CR0_NE              0x00000020      // report FPU errors with the exception
+#define CR4_OSFXSR          0x00000200      // FXSAVE/FXRSTOR and SSE enabled
+#define CR4_OSXMMEXCPT      0x00000400      // SSE errors raise the SIMD exception
+#define CPUID_FXSR          0x01000000      // cpuid leaf 1 edx bit 24
+#define CPUID_SSE           0x02000000      // cpuid leaf 1 edx bit 25
+#define MXCSR_DEFAULT       0x00001F80      // every SSE exception masked
+
+/* turn on the FPU and SSE, with the first use of each task trapping */
+extern void init_fpu();
+/* the device-not-available trap: hand the FPU to the current task, -1 if no task runs */
+extern int32_t fpu_trap();
+/* called on every context switch, makes the next FPU use trap unless next owns the FPU */
+extern void fpu_switch(pcb_t* next);
+/* forget the FPU state of a task that halts */
+extern void fpu_exit(pcb_t* pcb);
+
+/* number of device-not-available traps */
+extern uint32_t fpu_trap_count();
+/* number of traps that loaded the saved state of a task */
+extern uint32_t fpu_restore_count();
+/* number of times a task's state was saved because another task took the FPU */
+extern uint32_t fpu_save_count();
+
+#endif
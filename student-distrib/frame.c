@@ -0,0 +1,288 @@
+#include "frame.h"
+#include "paging.h"
+
+// reference count of every frame in the pool, 0 means the frame is free
+static uint8_t frame_ref[FRAME_NUM_MAX];
+// number of frames that actually exist below mem_top
+static uint32_t frame_num = 0;
+// number of free frames
+static uint32_t frame_free_num = 0;
+// where the next search starts
+static uint32_t frame_hint = 0;
+// allocated frames that hold only zeros, waiting for frame_alloc_zeroed
+static uint32_t zero_pool[ZERO_POOL_SIZE];
+static uint32_t zero_cnt = 0;
+static uint32_t zero_hit_cnt = 0;
+static uint32_t zero_miss_cnt = 0;
+
+/* hand the frames of the zeroed pool back to the free frames */
+static void zero_pool_drain();
+/* find and take num free frames in a row, called with interrupts off */
+static uint32_t block_search(uint32_t num);
+
+/* void init_frame(uint32_t mem_top)
+ * --------------------------------------------------------------------------------------
+ * Descriptions:    Initialize the frame pool. Only the frames that are below both
+ *                  mem_top and FRAME_POOL_LIMIT are handed out, and the pool
+ *                  is identity mapped for the kernel.
+ * Inputs:          uint32_t mem_top :  the first physical address that does not exist
+ * Outputs:         None
+ * Side Effects:    Changing page_directory
+ */
+void init_frame(uint32_t mem_top) {
+    uint32_t i;
+
+    if (mem_top > FRAME_POOL_LIMIT || mem_top == 0)
+        mem_top = FRAME_POOL_LIMIT;
+
+    if (mem_top <= FRAME_POOL_START) {
+        frame_num = 0;
+    } else {
+        frame_num = (mem_top - FRAME_POOL_START) / FOUR_KB_SIZE;
+    }
+
+    for (i = 0; i < FRAME_NUM_MAX; i++)
+        frame_ref[i] = 0;
+
+    frame_free_num = frame_num;
+    frame_hint = 0;
+
+    map_kernel_pool(FRAME_POOL_START, FRAME_POOL_START + frame_num * FOUR_KB_SIZE);
+}
+
+/* uint32_t frame_alloc()
+ * --------------------------------------------------------------------------------------
+ * Descriptions:    Find a free frame, starting from where the last search stopped
+ * Inputs:          None
+ * Outputs:         the physical address of the frame, 0 if the pool is empty
+ * Side Effects:    The frame gets a reference count of 1
+ */
+uint32_t frame_alloc() {
+    uint32_t i;
+    uint32_t idx;
+    uint32_t frame = 0;
+    uint32_t flags;
+
+    cli_and_save(flags);
+    if (frame_free_num == 0) {
+        // a zeroed frame is still a free frame
+        if (zero_cnt != 0)
+            frame = zero_pool[--zero_cnt];
+        restore_flags(flags);
+        return frame;
+    }
+
+    for (i = 0; i < frame_num; i++) {
+        idx = (frame_hint + i) % frame_num;
+        if (frame_ref[idx] == 0) {
+            frame_ref[idx] = 1;
+            frame_free_num--;
+            frame_hint = idx + 1;
+            restore_flags(flags);
+            return FRAME_POOL_START + idx * FOUR_KB_SIZE;
+        }
+    }
+
+    restore_flags(flags);
+    return 0;
+}
+
+/* uint32_t frame_alloc_block(uint32_t num)
+ * --------------------------------------------------------------------------------------
+ * Descriptions:    Find num free frames in a row, starting at a multiple of num.
+ *                  Kernel stacks use this so the pcb can be found by masking esp.
+ * Inputs:          uint32_t num :      number of frames, a power of 2
+ * Outputs:         the physical address of the first frame, 0 if nothing fits
+ * Side Effects:    Every frame of the block gets a reference count of 1
+ */
+uint32_t frame_alloc_block(uint32_t num) {
+    uint32_t addr;
+    uint32_t flags;
+
+    cli_and_save(flags);
+    // the zeroed pool may hold the frames a block needs
+    if ((addr = block_search(num)) == 0 && zero_cnt != 0) {
+        zero_pool_drain();
+        addr = block_search(num);
+    }
+    restore_flags(flags);
+    return addr;
+}
+
+/* uint32_t frame_alloc_zeroed()
+ * --------------------------------------------------------------------------------------
+ * Descriptions:    Take a frame from the pool the idle loop zeroed. When the pool
+ *                  is empty, allocate a frame and clear it here.
+ * Inputs:          None
+ * Outputs:         the physical address of the frame, 0 if memory is full
+ * Side Effects:    The frame gets a reference count of 1
+ */
+uint32_t frame_alloc_zeroed() {
+    uint32_t frame;
+    uint32_t flags;
+
+    cli_and_save(flags);
+    if (zero_cnt != 0) {
+        frame = zero_pool[--zero_cnt];
+        zero_hit_cnt++;
+        restore_flags(flags);
+        return frame;
+    }
+    restore_flags(flags);
+
+    if ((frame = frame_alloc()) == 0)
+        return 0;
+    memset((void*)frame, 0, FOUR_KB_SIZE);
+    zero_miss_cnt++;
+    return frame;
+}
+
+/* void frame_zero_idle()
+ * --------------------------------------------------------------------------------------
+ * Descriptions:    Move one free frame into the zeroed pool. The frame is cleared
+ *                  with interrupts on, so this can run from any idle loop.
+ *                  Frames are only taken while plenty of memory is free.
+ * Inputs:          None
+ * Outputs:         None
+ * Side Effects:    None
+ */
+void frame_zero_idle() {
+    uint32_t frame;
+    uint32_t flags;
+
+    if (zero_cnt >= ZERO_POOL_SIZE || frame_free_num <= ZERO_POOL_SIZE)
+        return;
+    if ((frame = frame_alloc()) == 0)
+        return;
+
+    memset((void*)frame, 0, FOUR_KB_SIZE);
+
+    cli_and_save(flags);
+    if (zero_cnt < ZERO_POOL_SIZE) {
+        zero_pool[zero_cnt++] = frame;
+        restore_flags(flags);
+        return;
+    }
+    restore_flags(flags);
+    frame_put(frame);
+}
+
+/* int32_t frame_get(uint32_t addr)
+ * --------------------------------------------------------------------------------------
+ * Descriptions:    Take another reference on a frame that is already allocated
+ * Inputs:          uint32_t addr :     physical address of the frame
+ * Outputs:         0 on success, -1 if the frame is not in use or cannot be shared more
+ * Side Effects:    None
+ */
+int32_t frame_get(uint32_t addr) {
+    uint32_t idx = (addr - FRAME_POOL_START) / FOUR_KB_SIZE;
+    uint32_t flags;
+
+    if (addr < FRAME_POOL_START || idx >= frame_num)
+        return -1;
+
+    cli_and_save(flags);
+    if (frame_ref[idx] == 0 || frame_ref[idx] == FRAME_REF_MAX) {
+        restore_flags(flags);
+        return -1;
+    }
+    frame_ref[idx]++;
+    restore_flags(flags);
+    return 0;
+}
+
+/* void frame_put(uint32_t addr)
+ * --------------------------------------------------------------------------------------
+ * Descriptions:    Drop one reference on a frame, free it when nobody uses it
+ * Inputs:          uint32_t addr :     physical address of the frame
+ * Outputs:         None
+ * Side Effects:    None
+ */
+void frame_put(uint32_t addr) {
+    uint32_t idx = (addr - FRAME_POOL_START) / FOUR_KB_SIZE;
+    uint32_t flags;
+
+    if (addr < FRAME_POOL_START || idx >= frame_num)
+        return;
+
+    cli_and_save(flags);
+    if (frame_ref[idx] != 0) {
+        frame_ref[idx]--;
+        if (frame_ref[idx] == 0)
+            frame_free_num++;
+    }
+    restore_flags(flags);
+}
+
+/* uint32_t frame_free_count()
+ * Inputs: none
+ * Return Value: number of free frames, zeroed ones included
+ * Function: report how much of the pool is left
+ */
+uint32_t frame_free_count() {
+    return frame_free_num + zero_cnt;
+}
+
+/* uint32_t frame_total_count()
+ * Inputs: none
+ * Return Value: number of frames in the pool
+ * Function: report how large the pool is
+ */
+uint32_t frame_total_count() {
+    return frame_num;
+}
+
+/* uint32_t frame_zeroed_count()
+ * Inputs: none
+ * Return Value: number of frames in the zeroed pool
+ * Function: report how many zeroed frames are ready
+ */
+uint32_t frame_zeroed_count() {
+    return zero_cnt;
+}
+
+/* uint32_t frame_zero_hits()
+ * Inputs: none
+ * Return Value: number of zeroed allocations served by the pool
+ * Function: report how often the idle loop saved a memset
+ */
+uint32_t frame_zero_hits() {
+    return zero_hit_cnt;
+}
+
+/* uint32_t frame_zero_misses()
+ * Inputs: none
+ * Return Value: number of zeroed allocations that found the pool empty
+ * Function: report how often the allocation path had to clear a frame
+ */
+uint32_t frame_zero_misses() {
+    return zero_miss_cnt;
+}
+
+static void zero_pool_drain() {
+    uint32_t flags;
+
+    cli_and_save(flags);
+    while (zero_cnt != 0)
+        frame_put(zero_pool[--zero_cnt]);
+    restore_flags(flags);
+}
+
+static uint32_t block_search(uint32_t num) {
+    uint32_t idx;
+    uint32_t i;
+
+    for (idx = 0; idx + num <= frame_num; idx += num) {
+        for (i = 0; i < num; i++) {
+            if (frame_ref[idx + i] != 0)
+                break;
+        }
+        if (i == num) {
+            for (i = 0; i < num; i++)
+                frame_ref[idx + i] = 1;
+            frame_free_num -= num;
+            return FRAME_POOL_START + idx * FOUR_KB_SIZE;
+        }
+    }
+    return 0;
+}
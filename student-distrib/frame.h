@@ -0,0 +1,54 @@
+#ifndef FRAME_H
+#define FRAME_H
+
+#include "types.h"
+#include "lib.h"
+
+/*
+ * Physical frame pool
+ *
+ *      ------------------------------------------------------
+ *      | 0MB  - 4MB   | video memory and terminal buffers   |
+ *      ------------------------------------------------------
+ *      | 4MB  - 8MB   | kernel page                         |
+ *      ------------------------------------------------------
+ *      | 8MB  - 128MB | 4KB frames handed out by frame.c    |
+ *      ------------------------------------------------------
+ *
+ * Kernel stacks, page tables and user pages all come from the pool. It is
+ * identity mapped with supervisor-only 4MB pages, so the kernel can touch
+ * any frame through its physical address. It stops at 128MB, where the
+ * user program page begins.
+ */
+#define FRAME_POOL_START    EIGHT_MB_SIZE
+#define FRAME_POOL_LIMIT    _128_MB_SIZE
+#define FRAME_NUM_MAX       ((FRAME_POOL_LIMIT - FRAME_POOL_START) / FOUR_KB_SIZE)
+#define FRAME_REF_MAX       0xFF
+#define ZERO_POOL_SIZE      64          // free frames kept zeroed by the idle loop
+
+/* initialize the frame pool for physical memory ending at mem_top */
+extern void init_frame(uint32_t mem_top);
+/* allocate one 4KB frame, returns its physical address or 0 */
+extern uint32_t frame_alloc();
+/* allocate num contiguous frames aligned to their total size, num is a power of 2 */
+extern uint32_t frame_alloc_block(uint32_t num);
+/* allocate one 4KB frame filled with zeros, from the pre-zeroed pool if possible */
+extern uint32_t frame_alloc_zeroed();
+/* zero one free frame into the pool, called when there is nothing else to do */
+extern void frame_zero_idle();
+/* take another reference on an allocated frame */
+extern int32_t frame_get(uint32_t addr);
+/* drop a reference, the frame is freed when the last one is gone */
+extern void frame_put(uint32_t addr);
+/* number of frames that are currently free */
+extern uint32_t frame_free_count();
+/* number of frames that the pool manages */
+extern uint32_t frame_total_count();
+/* number of frames in the pre-zeroed pool */
+extern uint32_t frame_zeroed_count();
+/* zeroed allocations served from the pool since boot */
+extern uint32_t frame_zero_hits();
+/* zeroed allocations that had to clear the frame themselves */
+extern uint32_t frame_zero_misses();
+
+#endif
@@ -4,6 +4,7 @@
 
 #include "i8259.h"
 #include "lib.h"
+#include "apic.h"
 
 #define IRQ_NUMBER      15
 #define MASTER_BOUND    0x08
@@ -39,8 +40,21 @@ void i8259_init(void) {
     outb(slave_mask, SLAVE_8259_DATA);
 }
 
+/* Mask every line, the APICs deliver the interrupts instead */
+void i8259_mask_all(void) {
+    master_mask = 0xFF;
+    slave_mask = 0xFF;
+    outb(master_mask, MASTER_8259_DATA);
+    outb(slave_mask, SLAVE_8259_DATA);
+}
+
 /* Enable (unmask) the specified IRQ */
 void enable_irq(uint32_t irq_num) {
+    if (apic_enabled()) {
+        ioapic_enable_irq(irq_num);
+        return;
+    }
+
     // check if the irq_num is out of range
     if (irq_num < 0 || irq_num > IRQ_NUMBER)
         return;
@@ -61,6 +75,11 @@ void enable_irq(uint32_t irq_num) {
 
 /* Disable (mask) the specified IRQ */
 void disable_irq(uint32_t irq_num) {
+    if (apic_enabled()) {
+        ioapic_disable_irq(irq_num);
+        return;
+    }
+
     // check if the irq_num is out of range
     if (irq_num < 0 || irq_num > IRQ_NUMBER)
         return;
@@ -81,6 +100,12 @@ void disable_irq(uint32_t irq_num) {
 
 /* Send end-of-interrupt signal for the specified IRQ */
 void send_eoi(uint32_t irq_num) {
+    // one register write, for whichever line is in service
+    if (apic_enabled()) {
+        lapic_eoi();
+        return;
+    }
+
     // check if the irq_num is out of range
     if (irq_num < 0 || irq_num > IRQ_NUMBER)
         return;
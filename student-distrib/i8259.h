@@ -33,6 +33,8 @@
 
 /* Initialize both PICs */
 void i8259_init(void);
+/* Mask every IRQ, when the APICs take over */
+void i8259_mask_all(void);
 /* Enable (unmask) the specified IRQ */
 void enable_irq(uint32_t irq_num);
 /* Disable (mask) the specified IRQ */
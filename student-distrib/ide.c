@@ -0,0 +1,130 @@
+#include "ide.h"
+
+// number of sectors of the slave drive, 0 if it does not exist
+static uint32_t ide_sectors = 0;
+
+/* wait until the drive is not busy, then check it is ready for data */
+static int32_t ide_wait(uint32_t need_drq);
+/* select the slave drive and send a read or write command for lba */
+static void ide_command(uint32_t lba, uint32_t count, uint8_t command);
+
+/* uint32_t ide_init()
+ * --------------------------------------------------------------------------------------
+ * Descriptions:    Send IDENTIFY to the slave drive of the primary bus. The drive
+ *                  is used in PIO mode with its interrupt disabled.
+ * Inputs:          None
+ * Outputs:         number of sectors of the drive, 0 if no ATA drive is attached
+ * Side Effects:    None
+ */
+uint32_t ide_init() {
+    uint32_t i;
+    uint8_t status;
+    uint16_t id[IDE_IDENTIFY_WORDS];
+
+    outb(IDE_NIEN, IDE_CTRL);
+    outb(IDE_SLAVE_LBA, IDE_IOBASE + IDE_DRIVE);
+    outb(0, IDE_IOBASE + IDE_SECCOUNT);
+    outb(0, IDE_IOBASE + IDE_LBA_LO);
+    outb(0, IDE_IOBASE + IDE_LBA_MID);
+    outb(0, IDE_IOBASE + IDE_LBA_HI);
+    outb(IDE_CMD_IDENTIFY, IDE_IOBASE + IDE_COMMAND);
+
+    // a floating bus reads as 0 or 0xFF when there is no drive
+    status = inb(IDE_IOBASE + IDE_STATUS);
+    if (status == 0 || status == 0xFF)
+        return 0;
+
+    for (i = 0; i < IDE_TIMEOUT && (inb(IDE_IOBASE + IDE_STATUS) & IDE_STATUS_BSY); i++);
+    // ATAPI and SATA devices set the signature in the lba registers
+    if (inb(IDE_IOBASE + IDE_LBA_MID) != 0 || inb(IDE_IOBASE + IDE_LBA_HI) != 0)
+        return 0;
+    if (ide_wait(1) == -1)
+        return 0;
+
+    for (i = 0; i < IDE_IDENTIFY_WORDS; i++)
+        id[i] = inw(IDE_IOBASE + IDE_DATA);
+
+    ide_sectors = id[IDE_LBA28_WORD] | ((uint32_t)id[IDE_LBA28_WORD + 1] << 16);
+    return ide_sectors;
+}
+
+/* int32_t ide_read(uint32_t lba, uint32_t count, void* buf)
+ * --------------------------------------------------------------------------------------
+ * Descriptions:    Read sectors from the slave drive by polling
+ * Inputs:          uint32_t lba :      the first sector
+ *                  uint32_t count :    number of sectors, at most IDE_MAX_SECTORS
+ *                  void* buf :         count * IDE_SECTOR_SIZE bytes
+ * Outputs:         0 on success, -1 if the drive failed
+ * Side Effects:    None
+ */
+int32_t ide_read(uint32_t lba, uint32_t count, void* buf) {
+    uint32_t i, j;
+    uint16_t* data = (uint16_t*)buf;
+
+    if (count == 0 || count > IDE_MAX_SECTORS || lba + count > ide_sectors)
+        return -1;
+
+    ide_command(lba, count, IDE_CMD_READ);
+    for (i = 0; i < count; i++) {
+        if (ide_wait(1) == -1)
+            return -1;
+        for (j = 0; j < IDE_SECTOR_SIZE / 2; j++)
+            *data++ = inw(IDE_IOBASE + IDE_DATA);
+    }
+    return 0;
+}
+
+/* int32_t ide_write(uint32_t lba, uint32_t count, const void* buf)
+ * --------------------------------------------------------------------------------------
+ * Descriptions:    Write sectors to the slave drive by polling, then flush the
+ *                  write cache of the drive
+ * Inputs:          uint32_t lba :      the first sector
+ *                  uint32_t count :    number of sectors, at most IDE_MAX_SECTORS
+ *                  const void* buf :   count * IDE_SECTOR_SIZE bytes
+ * Outputs:         0 on success, -1 if the drive failed
+ * Side Effects:    None
+ */
+int32_t ide_write(uint32_t lba, uint32_t count, const void* buf) {
+    uint32_t i, j;
+    const uint16_t* data = (const uint16_t*)buf;
+
+    if (count == 0 || count > IDE_MAX_SECTORS || lba + count > ide_sectors)
+        return -1;
+
+    ide_command(lba, count, IDE_CMD_WRITE);
+    for (i = 0; i < count; i++) {
+        if (ide_wait(1) == -1)
+            return -1;
+        for (j = 0; j < IDE_SECTOR_SIZE / 2; j++)
+            outw(*data++, IDE_IOBASE + IDE_DATA);
+    }
+
+    outb(IDE_CMD_FLUSH, IDE_IOBASE + IDE_COMMAND);
+    return ide_wait(0);
+}
+
+static int32_t ide_wait(uint32_t need_drq) {
+    uint32_t i;
+    uint8_t status = 0;
+
+    for (i = 0; i < IDE_TIMEOUT; i++) {
+        status = inb(IDE_IOBASE + IDE_STATUS);
+        if (status & IDE_STATUS_BSY)
+            continue;
+        if (status & (IDE_STATUS_ERR | IDE_STATUS_DF))
+            return -1;
+        if (!need_drq || (status & IDE_STATUS_DRQ))
+            return 0;
+    }
+    return -1;
+}
+
+static void ide_command(uint32_t lba, uint32_t count, uint8_t command) {
+    outb(IDE_SLAVE_LBA | ((lba >> 24) & 0x0F), IDE_IOBASE + IDE_DRIVE);
+    // a count of 0 means 256 sectors
+    outb(count & 0xFF, IDE_IOBASE + IDE_SECCOUNT);
+    outb(lba & 0xFF, IDE_IOBASE + IDE_LBA_LO);
+    outb((lba >> 8) & 0xFF, IDE_IOBASE + IDE_LBA_MID);
+    outb((lba >> 16) & 0xFF, IDE_IOBASE + IDE_LBA_HI);
+    outb(command, IDE_IOBASE + IDE_COMMAND);
+}
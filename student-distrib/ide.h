@@ -0,0 +1,46 @@
+#ifndef IDE_H
+#define IDE_H
+
+#include "types.h"
+#include "lib.h"
+
+// primary ATA bus, the swap disk is the slave drive (qemu -hdb)
+#define IDE_IOBASE          0x1F0
+#define IDE_CTRL            0x3F6
+#define IDE_DATA            0
+#define IDE_ERROR           1
+#define IDE_SECCOUNT        2
+#define IDE_LBA_LO          3
+#define IDE_LBA_MID         4
+#define IDE_LBA_HI          5
+#define IDE_DRIVE           6
+#define IDE_STATUS          7
+#define IDE_COMMAND         7
+
+#define IDE_SLAVE_LBA       0xF0        // LBA mode, slave drive
+#define IDE_NIEN            0x02        // no interrupts, the driver polls
+
+#define IDE_STATUS_ERR      0x01
+#define IDE_STATUS_DRQ      0x08
+#define IDE_STATUS_DF       0x20
+#define IDE_STATUS_BSY      0x80
+
+#define IDE_CMD_READ        0x20
+#define IDE_CMD_WRITE       0x30
+#define IDE_CMD_FLUSH       0xE7
+#define IDE_CMD_IDENTIFY    0xEC
+
+#define IDE_SECTOR_SIZE     512
+#define IDE_IDENTIFY_WORDS  256
+#define IDE_LBA28_WORD      60          // identify word holding the number of LBA28 sectors
+#define IDE_MAX_SECTORS     256         // one command moves at most this many sectors
+#define IDE_TIMEOUT         100000
+
+/* detect the swap disk, returns its number of sectors, 0 if there is none */
+extern uint32_t ide_init();
+/* read count sectors starting at lba into buf */
+extern int32_t ide_read(uint32_t lba, uint32_t count, void* buf);
+/* write count sectors starting at lba from buf */
+extern int32_t ide_write(uint32_t lba, uint32_t count, const void* buf);
+
+#endif
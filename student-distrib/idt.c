@@ -36,7 +36,7 @@ int init_idt() {
 		}
 
 		// if the current index is an interrupt
-		if (i == IDT_PIT || i == IDT_RTC || i == IDT_KEYBOARD || i == IDT_SB16) {
+		if (i == IDT_PIT || i == IDT_RTC || i == IDT_KEYBOARD || i == IDT_SB16 || i == IDT_SPURIOUS) {
 			// set present
 			idt[i].present = 1;
 		}
@@ -51,14 +51,14 @@ int init_idt() {
 	SET_IDT_ENTRY(idt[IDT_OVERFLOW], overflow_exception);
 	SET_IDT_ENTRY(idt[IDT_BOUND_RANGE], bound_range_exception);
 	SET_IDT_ENTRY(idt[IDT_INV_OPCODE], invalid_opcode_exception);
-	SET_IDT_ENTRY(idt[IDT_DEV_NOAVL], device_not_available_exception);
+	SET_IDT_ENTRY(idt[IDT_DEV_NOAVL], device_not_available_assembly);
 	SET_IDT_ENTRY(idt[IDT_DOUBLE_FA], double_fault_exception);
 	SET_IDT_ENTRY(idt[IDT_COPROCESSOR], coprocessor_exception);
 	SET_IDT_ENTRY(idt[IDT_INALID_TSS], invalid_tss_exception);
 	SET_IDT_ENTRY(idt[IDT_SEG_NOPRE], segment_not_present_exception);
 	SET_IDT_ENTRY(idt[IDT_STACK_FA], stack_fault_exception);
 	SET_IDT_ENTRY(idt[IDT_GEN_PROTEC], general_protection_exception);
-	SET_IDT_ENTRY(idt[IDT_PAGE_FAULT], page_fault_exception);
+	SET_IDT_ENTRY(idt[IDT_PAGE_FAULT], page_fault_assembly);
 	SET_IDT_ENTRY(idt[IDT_FLOAT_POINT], fpu_floating_point_exception);
 	SET_IDT_ENTRY(idt[IDT_ALIGNMENT], alignment_check_exception);
 	SET_IDT_ENTRY(idt[IDT_MACHINE], machine_check_exception);
@@ -72,6 +72,8 @@ int init_idt() {
 	SET_IDT_ENTRY(idt[IDT_SB16], sb16_assembly);
 	// set the RTC idt
 	SET_IDT_ENTRY(idt[IDT_RTC], rtc_assembly);
+	// set the local APIC spurious interrupt idt
+	SET_IDT_ENTRY(idt[IDT_SPURIOUS], spurious_assembly);
 
 	// set the system call idt
 	SET_IDT_ENTRY(idt[IDT_SYS_CALL], syscall_assembly);
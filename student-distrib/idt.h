@@ -37,6 +37,7 @@
 #define IDT_SB16        0x25
 #define IDT_RTC 		0x28
 #define IDT_SYS_CALL	0x80
+#define IDT_SPURIOUS    0xFF
 
 // function to initialize interrupt discriptor table
 extern int init_idt();
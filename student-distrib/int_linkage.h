@@ -5,5 +5,8 @@ extern void keyboard_assembly();
 extern void rtc_assembly();
 extern void pit_assembly();
 extern void sb16_assembly();
+extern void page_fault_assembly();
+extern void device_not_available_assembly();
+extern void spurious_assembly();
 
 #endif
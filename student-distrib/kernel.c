@@ -14,6 +14,14 @@
 #include "terminal.h"
 #include "filesystem.h"
 #include "scheduling.h"
+#include "frame.h"
+#include "process.h"
+#include "swap.h"
+#include "smp.h"
+#include "apic.h"
+#include "fpu.h"
+#include "sysenter.h"
+#include "work.h"
 
 #include "paging.h"
 
@@ -24,6 +32,7 @@
 #define CHECK_FLAG(flags, bit)   ((flags) & (1 << (bit)))
 
 uint32_t fs_start_addr;
+uint32_t mem_top = 0;           // first physical address past the end of memory
 
 /* Check if MAGIC is valid and print the Multiboot information structure
    pointed by ADDR. */
@@ -47,16 +56,26 @@ void entry(unsigned long magic, unsigned long addr) {
     printf("flags = 0x%#x\n", (unsigned)mbi->flags);
 
     /* Are mem_* valid? */
-    if (CHECK_FLAG(mbi->flags, 0))
+    if (CHECK_FLAG(mbi->flags, 0)) {
         printf("mem_lower = %uKB, mem_upper = %uKB\n", (unsigned)mbi->mem_lower, (unsigned)mbi->mem_upper);
+        // mem_upper counts the memory that starts at 1MB
+        if (mbi->mem_upper + 1024 < (FRAME_POOL_LIMIT >> 10))
+            mem_top = (mbi->mem_upper + 1024) * 1024;
+        else
+            mem_top = FRAME_POOL_LIMIT;
+    }
 
     /* Is boot_device valid? */
     if (CHECK_FLAG(mbi->flags, 1))
         printf("boot_device = 0x%#x\n", (unsigned)mbi->boot_device);
 
     /* Is the command line passed? */
-    if (CHECK_FLAG(mbi->flags, 2))
+    if (CHECK_FLAG(mbi->flags, 2)) {
         printf("cmdline = %s\n", (char *)mbi->cmdline);
+        // the command line is not mapped once paging is on
+        strncpy(boot_cmdline, (int8_t*)mbi->cmdline, CMDLINE_MAX - 1);
+        boot_cmdline[CMDLINE_MAX - 1] = '\0';
+    }
 
     if (CHECK_FLAG(mbi->flags, 3)) {
         int mod_count = 0;
@@ -152,12 +171,24 @@ void entry(unsigned long magic, unsigned long addr) {
 
     init_idt();
 
+    /* find the other processors while the BIOS tables are still reachable */
+    smp_detect();
+
     /* initialize Paging*/
-    printf("Enabling Paging :)\n");
+    select_paging_mode();
+    printf(paging_pae ? "Enabling PAE Paging :)\n" : "Enabling Paging :)\n");
     init_page();
 
-    /* Init the PIC */
+    /* hand the memory above the kernel to the frame allocator */
+    init_frame(mem_top);
+    /* size the process table from the frame pool */
+    init_process();
+    /* use the second IDE disk, if any, as swap */
+    init_swap();
+
+    /* Init the PIC, then hand the interrupts to the APICs if there are any */
     i8259_init();
+    init_apic();
     enable_irq(ICW3_SLAVE);
 
     /* Initialize devices, memory, filesystem, enable device interrupts on the
@@ -180,23 +211,29 @@ void entry(unsigned long magic, unsigned long addr) {
      * without showing you any output */
 
     // initialize scheduling, set frequency as 20Hz
+    sched_init();
+    init_fpu();
+    init_sysenter();
     init_pit(20);
+    // start the other processors, they park until the kernel can use them
+    smp_init();
+    // the bottom halves of the device interrupts run in a kernel task
+    init_work();
     //sti();
     // Reset_DSP();
     // play_music("testaudio");
     // Initialize terminal
+    sb16_init();
     enable_irq(5);
     play_music("testaudio");
     init_terminal();
     sti();
 
 #ifdef RUN_TESTS
-    /* Run tests */
-    //launch_tests();
+    /* Start the test task, with "tests" on the boot command line */
+    if (cmdline_has(boot_cmdline, (int8_t*)"tests"))
+        launch_tests();
 #endif
-    /* Execute the first program ("shell") ... */
-    execute((uint8_t*)"shell");
-
-    /* Spin (nicely, so we don't chew up cycles) */
-    asm volatile (".1: hlt; jmp .1;");
+    /* Run the shell init_terminal queued, the boot stack becomes the idle loop */
+    sched_idle();
 }
@@ -2,6 +2,8 @@
 #include "lib.h"
 #include "syscall.h"
 #include "terminal.h"
+#include "scheduling.h"
+#include "work.h"
 
 // variables defined
 volatile uint8_t caps_lock_enabled = 0;
@@ -9,6 +11,17 @@ volatile uint8_t shift_state = 0;
 volatile uint8_t ctrl_state = 0;
 volatile uint8_t alt_state = 0;
 
+// scancodes the top half read and the bottom half did not handle yet
+static uint8_t key_queue[KEY_QUEUE_SIZE];
+static volatile uint32_t key_queue_head = 0;
+static volatile uint32_t key_queue_tail = 0;
+static work_t keyboard_work_item;
+
+/* handle the queued scancodes, the bottom half of keyboard_handler */
+static void keyboard_work(uint32_t data);
+/* handle one scancode */
+static void key_process(unsigned scancode);
+
 // reference of the scan code: https://wiki.osdev.org/PS/2_Keyboard
 // some keys are not used currently and are marked as '\0'
 char key_scancode[TOTAL_STATE][SCANCODE_NUM] = {
@@ -75,6 +88,7 @@ char key_scancode[TOTAL_STATE][SCANCODE_NUM] = {
  * Function: initialize the keyboard by enabling the corresponding irq
  */
 void init_keyboard() {
+    work_init(&keyboard_work_item, keyboard_work, 0);
     enable_irq(KEYBOARD_IRQ);
     key_arr_ptr = 0;
     enter_state = 0;
@@ -85,17 +99,13 @@ void init_keyboard() {
 /* void keyboard_handler();
  * Inputs: none
  * Return Value: none
- * Function: read the keyboard port and display the corresponding
- *           character onto the screen
+ * Function: the top half: read the keyboard port, queue the scancode and
+ *           acknowledge the pic. Echoing and scrolling run in
+ *           keyboard_work with interrupts enabled.
  */
 void keyboard_handler() {
-    //clear();
     // get the scan code from the keyboard
 
-    unsigned flages = 0;
-    // enter critical section
-    cli_and_save(flages);
-
     unsigned scancode = 0;
 
     // wait for port to send signal
@@ -106,7 +116,47 @@ void keyboard_handler() {
         }
     }
 
-    // execute the scancode
+    // a key typed while the queue is full is lost, like on a full controller
+    if(key_queue_tail - key_queue_head < KEY_QUEUE_SIZE){
+        key_queue[key_queue_tail % KEY_QUEUE_SIZE] = scancode;
+        key_queue_tail++;
+    }
+    send_eoi(KEYBOARD_IRQ);
+
+    // the work task gets the cpu in irq_exit rather than at the next tick
+    work_queue(&keyboard_work_item);
+}
+
+/* void keyboard_work(uint32_t data);
+ * Inputs: data -- unused
+ * Return Value: none
+ * Function: the bottom half: handle the queued scancodes in order
+ */
+static void keyboard_work(uint32_t data) {
+    unsigned scancode;
+    uint32_t flags;
+
+    while(1){
+        cli_and_save(flags);
+        if(key_queue_head == key_queue_tail){
+            restore_flags(flags);
+            return;
+        }
+        scancode = key_queue[key_queue_head % KEY_QUEUE_SIZE];
+        key_queue_head++;
+        restore_flags(flags);
+
+        key_process(scancode);
+    }
+}
+
+/* void key_process(unsigned scancode);
+ * Inputs: scancode -- a scancode read by keyboard_handler
+ * Return Value: none
+ * Function: update the modifier state, or display the corresponding
+ *           character onto the screen
+ */
+static void key_process(unsigned scancode) {
     switch(scancode){
         case L_SHIFT_CODE:
             shift_state = 1;
@@ -139,6 +189,7 @@ void keyboard_handler() {
             key_arr_push(key_scancode[NOTHING_PRESS][scancode]);
             enter_state = 1;
             enter_handler();
+            terminal_wake(current_terminal);
             break;
 
         case BKSP_CODE:
@@ -163,12 +214,6 @@ void keyboard_handler() {
             input_handler(scancode);
 
     }
-    // send eoi to pic
-    send_eoi(KEYBOARD_IRQ);
-
-    // leave critical section
-    restore_flags(flages);
-
 }
 
 
@@ -194,13 +239,13 @@ void input_handler(unsigned s_code){
 
     if (ctrl_state == 1 && s_code == SCANCODE_C) {
         // ctrl-c halts the current program
-        send_eoi(KEYBOARD_IRQ);
         stop();
         cli();
         // printf("%d\n", current_terminal);
         // wait for scheduling to execute the current terminal and then halt
-        pcb_t * pcb = get_pcb_by_index(process_terminal[current_terminal][process_terminal_cnt[current_terminal] - 1]);
-        pcb->pending_signal = INTERRUPT;
+        pcb_t * pcb = get_pcb_by_index(process_terminal[current_terminal]);
+        if (pcb != NULL)
+            post_signal(pcb, INTERRUPT);
         sti();
         return;
     }
@@ -212,20 +257,14 @@ void input_handler(unsigned s_code){
 
     // Alt + Fx: switch to xth terminal
     if(alt_state == 1 && s_code == F1_CODE){
-        send_eoi(KEYBOARD_IRQ);
-        sti();
         switch_to_terminal(0);
         return;
     }
     if(alt_state == 1 && s_code == F2_CODE){
-        send_eoi(KEYBOARD_IRQ);
-        sti();
         switch_to_terminal(1);
         return;
     }
     if(alt_state == 1 && s_code == F3_CODE){
-        send_eoi(KEYBOARD_IRQ);
-        sti();
         switch_to_terminal(2);
         return;
     }
@@ -46,6 +46,7 @@
 #define PRESSED             1
 
 #define KEY_ARR_SIZE        128
+#define KEY_QUEUE_SIZE      16          // scancodes waiting for the bottom half, a power of 2
 
 #define SCANCODE_L          0x26
 #define SCANCODE_C          0x2E
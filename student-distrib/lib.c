@@ -673,6 +673,44 @@ void* memmove(void* dest, const void* src, uint32_t n) {
     return dest;
 }
 
+/* int32_t cmdline_has(const int8_t* cmdline, const int8_t* word)
+ * Inputs: const int8_t* cmdline = space separated options
+ *         const int8_t* word = the option to look for
+ * Return Value: 1 if one of the options is exactly word, 0 otherwise
+ * Function: check the boot command line for an option */
+int32_t cmdline_has(const int8_t* cmdline, const int8_t* word) {
+    uint32_t len = strlen(word);
+    while (*cmdline != '\0') {
+        if (strncmp(cmdline, word, len) == 0 && (cmdline[len] == ' ' || cmdline[len] == '\0'))
+            return 1;
+        // skip to the next option
+        while (*cmdline != ' ' && *cmdline != '\0')
+            cmdline++;
+        while (*cmdline == ' ')
+            cmdline++;
+    }
+    return 0;
+}
+
+/* uint64_t udiv64(uint64_t n, uint32_t d)
+ * Inputs: uint64_t n = dividend
+ *         uint32_t d = divisor, not 0
+ * Return Value: n / d
+ * Function: divide the high half first, so the remainder fed to divl with
+ *           the low half is below d and the quotient fits in 32 bits */
+uint64_t udiv64(uint64_t n, uint32_t d) {
+    uint32_t high = (uint32_t)(n >> 32);
+    uint32_t low = (uint32_t)n;
+    uint32_t q_high = high / d;
+    uint32_t q_low;
+    uint32_t rem = high % d;
+
+    asm volatile("divl %4"
+                 : "=a" (q_low), "=d" (rem)
+                 : "a" (low), "d" (rem), "rm" (d));
+    return ((uint64_t)q_high << 32) | q_low;
+}
+
 /* int32_t strncmp(const int8_t* s1, const int8_t* s2, uint32_t n)
  * Inputs: const int8_t* s1 = first string to compare
  *         const int8_t* s2 = second string to compare
@@ -954,11 +992,13 @@ pcb_t* get_curr_pcb() {
 }
 
 /*
- * pcb_t* get_pcb_by_index(uint32_t index)
- * Inputs: index -- the process number
- * Return Value: pcb pointer
- * Function: get the pcb pointer corresponding to the process number
+ * pcb_t* get_curr_proc()
+ * Inputs: none
+ * Return Value: pcb pointer of the current process
+ * Function: the pcb that holds the files and shared memory of the current
+ *           task, which is the leader for a thread
  */
-pcb_t* get_pcb_by_index(uint32_t index) {
-    return (pcb_t*)(EIGHT_MB_SIZE - (index + 1) * EIGHT_KB_SIZE);
+pcb_t* get_curr_proc() {
+    pcb_t * pcb = get_curr_pcb();
+    return pcb->leader != NULL ? pcb->leader : pcb;
 }
@@ -14,17 +14,17 @@
 #define KEY_ARR_SIZE            128
 #define CURSOR_MAX              15
 #define MAX_TERMINAL_NUM        3
-#define MAX_TASK                6               // maximum processes that can be run
 #define FOUR_KB_SIZE            4096
 #define EIGHT_KB_SIZE           8192
 #define FOUR_MB_SIZE            0x00400000
 #define EIGHT_MB_SIZE           0x00800000
 #define _128_MB_SIZE            0x08000000
-#define PCB_MASK                0x007FE000      // mask to get the current pcb pointer
+#define PCB_MASK                0xFFFFE000      // mask to get the current pcb pointer
 #define TERMINAL_BUFFER_1       (0x000B8000 + FOUR_KB_SIZE)
 #define TERMINAL_BUFFER_2       (0x000B8000 + 2 * FOUR_KB_SIZE)
 #define TERMINAL_BUFFER_3       (0x000B8000 + 3 * FOUR_KB_SIZE)
 #define CPU_CYCLE_PER_SEC       10000000
+#define CMDLINE_MAX             128
 
 #include "types.h"
 
@@ -47,6 +47,13 @@ int32_t strncmp(const int8_t* s1, const int8_t* s2, uint32_t n);
 int8_t* strcpy(int8_t* dest, const int8_t*src);
 int8_t* strncpy(int8_t* dest, const int8_t*src, uint32_t n);
 
+// copy of the multiboot command line, kept for options read after paging is on
+int8_t boot_cmdline[CMDLINE_MAX];
+int32_t cmdline_has(const int8_t* cmdline, const int8_t* word);
+
+/* 64-bit by 32-bit division, gcc would call into libgcc for it */
+uint64_t udiv64(uint64_t n, uint32_t d);
+
 /* Userspace address-check functions */
 int32_t bad_userspace_addr(const void* addr, int32_t len);
 int32_t safe_strncpy(int8_t* dest, const int8_t* src, int32_t n);
@@ -90,8 +97,10 @@ int set_column_stack_in(int cs);
 
 // pcb helper functions
 pcb_t* get_curr_pcb();
+pcb_t* get_curr_proc();
 pcb_t* get_pcb_by_index(uint32_t index);
-uint32_t process_terminal[MAX_TERMINAL_NUM][MAX_TASK];
+// pid of the foreground process of every terminal, and how many processes it runs
+uint32_t process_terminal[MAX_TERMINAL_NUM];
 uint32_t process_terminal_cnt[MAX_TERMINAL_NUM];
 volatile uint8_t current_terminal;
 volatile uint8_t running_terminal;
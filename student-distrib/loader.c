@@ -0,0 +1,386 @@
+#include "loader.h"
+
+// text of the executables that ran recently, shared by all their instances
+static text_cache_t text_cache[TEXT_CACHE_SIZE];
+
+/* count the leading pages of an executable that are never written */
+static uint32_t text_shared_pages(uint32_t inode);
+/* find the first page after everything the executable loads */
+static uint32_t program_end(uint32_t inode);
+/* back [start, end) of the program page with private frames holding the file, zeroed from zero_from on */
+static int32_t map_private(uint32_t pid, uint32_t inode, uint32_t start, uint32_t end, uint32_t zero_from);
+/* find or load the shared text of an executable */
+static int32_t text_lookup(uint32_t inode, uint32_t num_pages);
+/* free the text of an executable that no process is running */
+static int32_t text_evict();
+/* give the frames of a cache entry back to the pool */
+static void text_free(int32_t text_id);
+
+/*
+ * Function:  int32_t load_program(uint32_t pid, uint32_t inode)
+ * --------------------
+ * This function builds the program page of a process and copies the
+ * executable into it. Only the pages the executable occupies and a small
+ * user stack get memory. The text pages of an executable are loaded once:
+ * when another process already runs the same inode, its frames are
+ * mapped read-only instead, and only the writable part of the file is
+ * copied into the private memory of the process. The program page that
+ * is mapped does not change.
+ *
+ *  Inputs:     uint32_t pid: the process that runs the executable
+ *              uint32_t inode: inode of the executable
+ *
+ *  Returns:    0: success
+ *              -1: the executable is too large or memory ran out
+ *
+ *  Side effects: fill the program page table of pid
+ *
+ */
+int32_t load_program(uint32_t pid, uint32_t inode) {
+    uint32_t i;
+    uint32_t num_shared;
+    uint32_t start, end, file_end;
+    int32_t text_id = NO_TEXT;
+    pcb_t * pcb = get_pcb_by_index(pid);
+
+    clear_program_table(pid);
+    pcb->text_id = NO_TEXT;
+
+    end = program_end(inode);
+    if (end == 0 || end > USER_STACK_BOTTOM)
+        return -1;
+
+    num_shared = text_shared_pages(inode);
+    if (num_shared > 0)
+        text_id = text_lookup(inode, num_shared);
+
+    if (text_id != NO_TEXT) {
+        for (i = 0; i < num_shared; i++)
+            map_program_text(pid, PROGRAM_OFFSET + i * FOUR_KB_SIZE, text_cache[text_id].frames[i]);
+    } else {
+        // fall back to a private copy of the whole file
+        num_shared = 0;
+    }
+    pcb->text_id = text_id;
+
+    // pages the file fills completely do not need to be zeroed
+    start = PROGRAM_OFFSET + num_shared * FOUR_KB_SIZE;
+    file_end = (PROGRAM_OFFSET + get_file_size(inode)) & FOUR_LB_PB_MASK;
+    // everything after the shared text is copied as the pages are mapped
+    if (map_private(pid, inode, start, end, file_end) == -1
+            || map_private(pid, NO_INODE, USER_STACK_BOTTOM, _128_MB_SIZE + FOUR_MB_SIZE, USER_STACK_BOTTOM) == -1) {
+        unload_program(pid);
+        return -1;
+    }
+
+    return 0;
+}
+
+/*
+ * Function:  void unload_program(uint32_t pid)
+ * --------------------
+ * This function gives the private pages of a halting process back to the
+ * frame pool or the swap area and drops its reference on its text. The text stays
+ * resident so the next launch of the same executable does not have to
+ * load it again.
+ *
+ *  Inputs:     uint32_t pid: the halting process
+ *
+ *  Returns:    none
+ *
+ *  Side effects: unmap the program page of pid
+ *
+ */
+void unload_program(uint32_t pid) {
+    uint32_t i;
+    uint32_t pte;
+    uint32_t flags;
+    pcb_t * pcb = get_pcb_by_index(pid);
+
+    for (i = 0; i < TABLE_SIZE; i++) {
+        // the swap clock may take the page while we look at it, and then
+        // it is the one to put the frame
+        cli_and_save(flags);
+        pte = pte_read(pcb->program_table, i);
+        pte_write(pcb->program_table, i, 0);
+        restore_flags(flags);
+        if ((pte & PRESENT_MASK) && !(pte & SHARED_MASK)) {
+            frame_put(pte & FOUR_LB_PB_MASK);
+            mem_charge(MEM_USER, -1);
+        } else if (pte & SWAPPED_MASK)
+            swap_release(pte);
+    }
+    flush_tlb();
+
+    cli_and_save(flags);
+    if (pcb->text_id != NO_TEXT && text_cache[pcb->text_id].ref_cnt > 0)
+        text_cache[pcb->text_id].ref_cnt--;
+    pcb->text_id = NO_TEXT;
+    restore_flags(flags);
+}
+
+/*
+ * Function:  int32_t load_stack(uint32_t pid, uint32_t bottom, uint32_t top)
+ * --------------------
+ * This function gives a thread of pid a user stack: every page of
+ * [bottom, top) gets a zeroed private frame. It fails instead of mapping
+ * over pages the program already uses.
+ *
+ *  Inputs:     uint32_t pid: the process the thread belongs to
+ *              uint32_t bottom, top: page aligned range in the program page
+ *
+ *  Returns:    0: success
+ *              -1: the range is in use or memory ran out
+ *
+ *  Side effects: fill the program page table of pid
+ *
+ */
+int32_t load_stack(uint32_t pid, uint32_t bottom, uint32_t top) {
+    uint32_t addr;
+
+    for (addr = bottom; addr < top; addr += FOUR_KB_SIZE) {
+        if (get_program_page(pid, addr) != 0)
+            return -1;
+    }
+    if (map_private(pid, NO_INODE, bottom, top, bottom) == -1) {
+        unload_stack(pid, bottom, top);
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * Function:  void unload_stack(uint32_t pid, uint32_t bottom, uint32_t top)
+ * --------------------
+ * This function gives the pages of a thread stack back to the frame pool
+ * or the swap area.
+ *
+ *  Inputs:     uint32_t pid: the process the thread belongs to
+ *              uint32_t bottom, top: the range given to load_stack
+ *
+ *  Returns:    none
+ *
+ *  Side effects: unmap the range from the program page of pid
+ *
+ */
+void unload_stack(uint32_t pid, uint32_t bottom, uint32_t top) {
+    uint32_t addr;
+    uint32_t pte;
+    uint32_t flags;
+    pcb_t * pcb = get_pcb_by_index(pid);
+
+    for (addr = bottom; addr < top; addr += FOUR_KB_SIZE) {
+        // the swap clock may take the page while we look at it
+        cli_and_save(flags);
+        pte = get_program_page(pid, addr);
+        pte_write(pcb->program_table, (addr & TABLE_MASK) >> FOUR_KB_OFFSET, 0);
+        restore_flags(flags);
+        if (pte & PRESENT_MASK) {
+            frame_put(pte & FOUR_LB_PB_MASK);
+            mem_charge(MEM_USER, -1);
+        } else if (pte & SWAPPED_MASK)
+            swap_release(pte);
+    }
+    flush_tlb();
+}
+
+static uint32_t program_end(uint32_t inode) {
+    uint8_t header[ELF_HEADER_SIZE];
+    uint8_t ph[PH_SIZE];
+    uint32_t i;
+    uint32_t phoff, phentsize, phnum;
+    uint32_t vaddr, memsz;
+    int32_t size;
+    uint32_t end;
+
+    if ((size = get_file_size(inode)) <= 0)
+        return 0;
+    end = PROGRAM_OFFSET + size;
+
+    // the bss may reach past the end of the file
+    if (read_data(inode, 0, header, ELF_HEADER_SIZE) == ELF_HEADER_SIZE) {
+        phoff = *(uint32_t*)(&header[ELF_PHOFF]);
+        phentsize = *(uint16_t*)(&header[ELF_PHENTSIZE]);
+        phnum = *(uint16_t*)(&header[ELF_PHNUM]);
+        for (i = 0; phentsize >= PH_SIZE && i < phnum && i < PH_MAX; i++) {
+            if (read_data(inode, phoff + i * phentsize, ph, PH_SIZE) != PH_SIZE)
+                break;
+            if (*(uint32_t*)(&ph[0]) != PT_LOAD)
+                continue;
+            vaddr = *(uint32_t*)(&ph[8]);
+            memsz = *(uint32_t*)(&ph[20]);
+            if (vaddr >= PROGRAM_OFFSET && vaddr + memsz > end)
+                end = vaddr + memsz;
+        }
+    }
+
+    return (end + FOUR_KB_SIZE - 1) & FOUR_LB_PB_MASK;
+}
+
+static int32_t map_private(uint32_t pid, uint32_t inode, uint32_t start, uint32_t end, uint32_t zero_from) {
+    uint32_t addr;
+    uint32_t frame;
+    uint32_t file_size = (inode != NO_INODE) ? get_file_size(inode) : 0;
+
+    for (addr = start; addr < end; addr += FOUR_KB_SIZE) {
+        // bss and stack pages come from the pool the idle loop zeroes
+        if (addr >= zero_from) {
+            frame = frame_alloc_zeroed();
+            while (frame == 0 && text_evict() != NO_TEXT)
+                frame = frame_alloc_zeroed();
+            if (frame == 0 && (frame = swap_frame_alloc_zeroed()) == 0)
+                return -1;
+        } else {
+            // make room by dropping text that nobody runs, then by swapping
+            frame = frame_alloc();
+            while (frame == 0 && text_evict() != NO_TEXT)
+                frame = frame_alloc();
+            if (frame == 0 && (frame = swap_frame_alloc()) == 0)
+                return -1;
+        }
+        // filled through the kernel mapping of the frame before it is
+        // mapped: the program page of the caller stays installed, and the
+        // swap clock cannot take the page while it is still empty
+        if (addr - PROGRAM_OFFSET < file_size)
+            read_data(inode, addr - PROGRAM_OFFSET, (uint8_t*)frame, FOUR_KB_SIZE);
+        map_program_page(pid, addr, frame);
+        mem_charge(MEM_USER, 1);
+    }
+    return 0;
+}
+
+static uint32_t text_shared_pages(uint32_t inode) {
+    uint8_t header[ELF_HEADER_SIZE];
+    uint8_t ph[PH_SIZE];
+    uint32_t i;
+    uint32_t phoff, phentsize, phnum;
+    uint32_t vaddr, filesz, flags;
+    uint32_t text_end = 0;
+    uint32_t write_start = 0xFFFFFFFF;
+    uint32_t end;
+
+    if (read_data(inode, 0, header, ELF_HEADER_SIZE) != ELF_HEADER_SIZE)
+        return 0;
+
+    phoff = *(uint32_t*)(&header[ELF_PHOFF]);
+    phentsize = *(uint16_t*)(&header[ELF_PHENTSIZE]);
+    phnum = *(uint16_t*)(&header[ELF_PHNUM]);
+    if (phentsize < PH_SIZE || phnum > PH_MAX)
+        return 0;
+
+    for (i = 0; i < phnum; i++) {
+        if (read_data(inode, phoff + i * phentsize, ph, PH_SIZE) != PH_SIZE)
+            return 0;
+        if (*(uint32_t*)(&ph[0]) != PT_LOAD)
+            continue;
+
+        vaddr = *(uint32_t*)(&ph[8]);
+        filesz = *(uint32_t*)(&ph[16]);
+        flags = *(uint32_t*)(&ph[24]);
+
+        if (flags & PF_W) {
+            if (vaddr < write_start)
+                write_start = vaddr;
+        } else if (vaddr == PROGRAM_OFFSET) {
+            text_end = vaddr + filesz;
+        }
+    }
+
+    if (text_end == 0)
+        return 0;
+
+    // a page is shared only if nothing writable lives in it
+    end = (text_end + FOUR_KB_SIZE - 1) & FOUR_LB_PB_MASK;
+    if ((write_start & FOUR_LB_PB_MASK) < end)
+        end = write_start & FOUR_LB_PB_MASK;
+    if (end <= PROGRAM_OFFSET)
+        return 0;
+
+    i = (end - PROGRAM_OFFSET) / FOUR_KB_SIZE;
+    return i > TEXT_MAX_PAGES ? 0 : i;
+}
+
+static int32_t text_lookup(uint32_t inode, uint32_t num_pages) {
+    int32_t i;
+    int32_t text_id = NO_TEXT;
+    uint32_t j;
+    int32_t n;
+    uint32_t frame;
+    uint32_t flags;
+
+    cli_and_save(flags);
+    for (i = 0; i < TEXT_CACHE_SIZE; i++) {
+        if (text_cache[i].in_use && text_cache[i].inode == inode
+                && text_cache[i].num_pages == num_pages) {
+            text_cache[i].ref_cnt++;
+            restore_flags(flags);
+            return i;
+        }
+        if (text_cache[i].in_use == 0 && text_id == NO_TEXT)
+            text_id = i;
+    }
+
+    if (text_id == NO_TEXT && (text_id = text_evict()) == NO_TEXT) {
+        restore_flags(flags);
+        return NO_TEXT;
+    }
+
+    // claim the slot, num_pages stays 0 until the text is loaded
+    text_cache[text_id].in_use = 1;
+    text_cache[text_id].inode = inode;
+    text_cache[text_id].num_pages = 0;
+    text_cache[text_id].ref_cnt = 1;
+    restore_flags(flags);
+
+    for (j = 0; j < num_pages; j++) {
+        frame = frame_alloc();
+        // make room by dropping text that nobody runs
+        while (frame == 0 && text_evict() != NO_TEXT)
+            frame = frame_alloc();
+        if (frame == 0) {
+            text_cache[text_id].num_pages = j;
+            text_free(text_id);
+            return NO_TEXT;
+        }
+
+        text_cache[text_id].frames[j] = frame;
+        mem_charge(MEM_TEXT, 1);
+        // only the part the file does not cover needs zeros
+        n = read_data(inode, j * FOUR_KB_SIZE, (uint8_t*)frame, FOUR_KB_SIZE);
+        if (n < 0)
+            n = 0;
+        if (n < FOUR_KB_SIZE)
+            memset((void*)(frame + n), 0, FOUR_KB_SIZE - n);
+    }
+
+    // other processes may use the text from now on
+    text_cache[text_id].num_pages = num_pages;
+    return text_id;
+}
+
+static int32_t text_evict() {
+    int32_t i;
+    uint32_t flags;
+
+    cli_and_save(flags);
+    for (i = 0; i < TEXT_CACHE_SIZE; i++) {
+        // loaded text that no process is running
+        if (text_cache[i].in_use && text_cache[i].ref_cnt == 0 && text_cache[i].num_pages != 0) {
+            text_free(i);
+            restore_flags(flags);
+            return i;
+        }
+    }
+    restore_flags(flags);
+    return NO_TEXT;
+}
+
+static void text_free(int32_t text_id) {
+    uint32_t i;
+    for (i = 0; i < text_cache[text_id].num_pages; i++)
+        frame_put(text_cache[text_id].frames[i]);
+    mem_charge(MEM_TEXT, -(int32_t)text_cache[text_id].num_pages);
+    text_cache[text_id].num_pages = 0;
+    text_cache[text_id].ref_cnt = 0;
+    text_cache[text_id].in_use = 0;
+}
@@ -0,0 +1,52 @@
+#ifndef LOADER_H
+#define LOADER_H
+
+#include "types.h"
+#include "lib.h"
+#include "paging.h"
+#include "frame.h"
+#include "filesystem.h"
+#include "swap.h"
+#include "meminfo.h"
+
+// ELF header and program header fields used by the loader
+#define ELF_PHOFF           28          // offset to the program header table
+#define ELF_PHENTSIZE       42          // size of one program header
+#define ELF_PHNUM           44          // number of program headers
+#define ELF_HEADER_SIZE     52
+#define PH_SIZE             32
+#define PH_MAX              8
+#define PT_LOAD             1
+#define PF_W                0x2
+
+#define TEXT_CACHE_SIZE     8           // executables whose text can stay resident
+#define TEXT_MAX_PAGES      64          // 256KB of text per executable
+#define NO_TEXT             -1
+#define NO_INODE            0xFFFFFFFF  // memory no file backs
+
+// the user stack sits at the top of the program page
+#define USER_STACK_PAGES    8
+#define USER_STACK_BOTTOM   (_128_MB_SIZE + FOUR_MB_SIZE - USER_STACK_PAGES * FOUR_KB_SIZE)
+// the stacks of the threads sit below it, each under an unmapped guard page
+#define THREAD_STACK_PAGES  4
+#define THREAD_STACK_TOP(slot)      (USER_STACK_BOTTOM - FOUR_KB_SIZE - (slot) * (THREAD_STACK_PAGES + 1) * FOUR_KB_SIZE)
+#define THREAD_STACK_BOTTOM(slot)   (THREAD_STACK_TOP(slot) - THREAD_STACK_PAGES * FOUR_KB_SIZE)
+
+typedef struct {
+    uint32_t in_use;
+    uint32_t inode;                     // the executable this text belongs to
+    uint32_t num_pages;
+    uint32_t ref_cnt;                   // processes running this text
+    uint32_t frames[TEXT_MAX_PAGES];
+} text_cache_t;
+
+/* build the program page of pid and load the executable into it */
+extern int32_t load_program(uint32_t pid, uint32_t inode);
+/* free the private pages of pid and drop the text it shares */
+extern void unload_program(uint32_t pid);
+/* back [bottom, top) of the program page of pid with zeroed frames */
+extern int32_t load_stack(uint32_t pid, uint32_t bottom, uint32_t top);
+/* free the pages load_stack mapped */
+extern void unload_stack(uint32_t pid, uint32_t bottom, uint32_t top);
+
+#endif
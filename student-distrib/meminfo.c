@@ -0,0 +1,150 @@
+#include "meminfo.h"
+#include "process.h"
+#include "swap.h"
+#include "sb16.h"
+#include "filesystem.h"
+
+// first byte after the kernel image, defined by the linker
+extern uint8_t _end;
+
+// frames each subsystem holds right now
+static uint32_t charged[MEM_SUBSYS_NUM];
+
+
+/* void mem_charge(uint32_t subsys, int32_t pages)
+ * --------------------------------------------------------------------------------------
+ * Descriptions:    Record that a subsystem took frames from the pool, or gave
+ *                  them back when pages is negative. Every frame_alloc and
+ *                  frame_put outside of frame.c has a matching charge, so the
+ *                  used frames nobody charged point at a leak.
+ * Inputs:          uint32_t subsys :   one of the MEM_* subsystems
+ *                  int32_t pages :     number of frames
+ * Outputs:         None
+ * Side Effects:    None
+ */
+void mem_charge(uint32_t subsys, int32_t pages) {
+    uint32_t flags;
+
+    if (subsys >= MEM_SUBSYS_NUM)
+        return;
+    cli_and_save(flags);
+    charged[subsys] += pages;
+    restore_flags(flags);
+}
+
+/* uint32_t mem_charged(uint32_t subsys)
+ * Inputs: subsys -- one of the MEM_* subsystems
+ * Return Value: number of frames the subsystem holds
+ * Function: read the charge of a subsystem
+ */
+uint32_t mem_charged(uint32_t subsys) {
+    if (subsys >= MEM_SUBSYS_NUM)
+        return 0;
+    return charged[subsys];
+}
+
+/* int32_t mem_process_usage(uint32_t pid, meminfo_proc_t* usage)
+ * --------------------------------------------------------------------------------------
+ * Descriptions:    Walk the program page and the shared memory window of a
+ *                  process and count what backs each page
+ * Inputs:          uint32_t pid :              the process to look at
+ *                  meminfo_proc_t* usage :     filled with the footprint
+ * Outputs:         0 on success, -1 if no process uses pid
+ * Side Effects:    None
+ */
+int32_t mem_process_usage(uint32_t pid, meminfo_proc_t* usage) {
+    uint32_t i;
+    uint32_t pte;
+    pcb_t * pcb;
+
+    if ((pcb = get_pcb_by_index(pid)) == NULL)
+        return -1;
+
+    usage->pid = pcb->pid;
+    usage->parent_pid = pcb->parent_pid;
+    usage->terminal_id = pcb->terminal_id;
+    usage->resident_pages = 0;
+    usage->swapped_pages = 0;
+    usage->text_pages = 0;
+    usage->shm_pages = 0;
+    usage->kernel_pages = KSTACK_FRAMES + 2 * table_size() / FOUR_KB_SIZE;
+    strncpy((int8_t*)usage->name, (int8_t*)pcb->name, PROC_NAME_LEN);
+    usage->name[PROC_NAME_LEN - 1] = '\0';
+
+    // a thread only owns its kernel stack, the pages count for its process
+    if (pcb->leader != NULL) {
+        usage->kernel_pages = KSTACK_FRAMES;
+        return 0;
+    }
+
+    for (i = 0; i < TABLE_SIZE; i++) {
+        pte = pte_read(pcb->program_table, i);
+        if ((pte & PRESENT_MASK) && (pte & SHARED_MASK))
+            usage->text_pages++;
+        else if (pte & PRESENT_MASK)
+            usage->resident_pages++;
+        else if (pte & SWAPPED_MASK)
+            usage->swapped_pages++;
+
+        if (pte_read(pcb->shm_table, i) & PRESENT_MASK)
+            usage->shm_pages++;
+    }
+    return 0;
+}
+
+/*
+ * Function:  int32_t meminfo(meminfo_t* buf)
+ * --------------------
+ * This function reports where memory goes: the frame pool split by the
+ * kernel subsystems that hold it, the regions outside the pool (kernel
+ * image, dma buffer, video memory, file system module) and the footprint
+ * of the first MEMINFO_MAX_PROCS processes.
+ *
+ *  Inputs:     meminfo_t* buf: a writable buffer in the program page
+ *
+ *  Returns:    -1: failed
+ *              n: the number of processes that exist
+ *
+ *  Side effects: none
+ *
+ */
+int32_t meminfo(meminfo_t* buf) {
+    uint32_t i;
+    uint32_t pid;
+    uint32_t used;
+    uint32_t sum = 0;
+
+    if (user_writable((uint32_t)buf, sizeof(meminfo_t)) == -1)
+        return -1;
+
+    buf->total_pages = frame_total_count();
+    buf->free_pages = frame_free_count();
+    buf->zeroed_pages = frame_zeroed_count();
+    for (i = 0; i < MEM_SUBSYS_NUM; i++) {
+        buf->charged_pages[i] = charged[i];
+        sum += charged[i];
+    }
+    used = buf->total_pages - buf->free_pages;
+    buf->unaccounted_pages = used > sum ? used - sum : 0;
+
+    buf->swap_total_pages = swap_total_slots();
+    buf->swap_free_pages = swap_free_slots();
+
+    buf->image_bytes = (uint32_t)&_end - FOUR_MB_SIZE;
+    buf->dma_bytes = sb16_buffer_size();
+    buf->video_bytes = (1 + MAX_TERMINAL_NUM) * FOUR_KB_SIZE;
+    buf->fs_addr = fs_addr;
+    buf->fs_bytes = (1 + num_inodes + num_d_blocks) * BLOCKSIZE;
+
+    buf->num_procs = 0;
+    for (pid = 0; pid < max_task; pid++) {
+        if (buf->num_procs < MEMINFO_MAX_PROCS) {
+            if (mem_process_usage(pid, &buf->procs[buf->num_procs]) == 0)
+                buf->num_procs++;
+        } else if (get_pcb_by_index(pid) != NULL) {
+            buf->num_procs++;
+        }
+    }
+
+    return buf->num_procs;
+}
@@ -0,0 +1,59 @@
+#ifndef MEMINFO_H
+#define MEMINFO_H
+
+#include "types.h"
+#include "lib.h"
+#include "paging.h"
+#include "frame.h"
+
+// kernel users of the frame pool, each one charges the frames it holds
+#define MEM_PROCESS_TABLE   0           // pcb table and pid bitmap
+#define MEM_KSTACK          1           // 8KB kernel stacks with the pcb
+#define MEM_PAGE_TABLE      2           // program and shared memory page tables
+#define MEM_USER            3           // private user pages that are resident
+#define MEM_TEXT            4           // shared text cache
+#define MEM_SHM             5           // shared memory segments
+#define MEM_SUBSYS_NUM      6
+
+#define MEMINFO_MAX_PROCS   16          // processes one meminfo call reports
+
+typedef struct {
+    uint32_t pid;
+    uint32_t parent_pid;
+    uint32_t terminal_id;
+    uint32_t resident_pages;            // private pages in memory
+    uint32_t swapped_pages;             // private pages in swap
+    uint32_t text_pages;                // shared text mapped
+    uint32_t shm_pages;                 // shared memory mapped
+    uint32_t kernel_pages;              // kernel stack and page tables
+    uint8_t name[PROC_NAME_LEN];
+} meminfo_proc_t;
+
+typedef struct {
+    uint32_t total_pages;               // frames the pool manages
+    uint32_t free_pages;
+    uint32_t zeroed_pages;
+    uint32_t charged_pages[MEM_SUBSYS_NUM];
+    uint32_t unaccounted_pages;         // used but charged to nobody, a leak if it grows
+    uint32_t swap_total_pages;
+    uint32_t swap_free_pages;
+    uint32_t image_bytes;               // kernel image, includes the dma buffer
+    uint32_t dma_bytes;
+    uint32_t video_bytes;               // video memory and terminal buffers
+    uint32_t fs_addr;
+    uint32_t fs_bytes;
+    uint32_t num_procs;                 // processes that exist
+    meminfo_proc_t procs[MEMINFO_MAX_PROCS];
+} meminfo_t;
+
+// system call
+int32_t meminfo(meminfo_t* buf);
+
+/* add pages to the frames charged to a subsystem, pages may be negative */
+extern void mem_charge(uint32_t subsys, int32_t pages);
+/* number of frames charged to a subsystem */
+extern uint32_t mem_charged(uint32_t subsys);
+/* fill the footprint of one process, -1 if the pid is not in use */
+extern int32_t mem_process_usage(uint32_t pid, meminfo_proc_t* usage);
+
+#endif
@@ -1,7 +1,16 @@
 #include "paging.h"
 
-/* flush the tlb */
-static void flush_tlb();
+// 1 when the kernel runs with PAE paging, selected at boot
+uint32_t paging_pae = 0;
+// PAE: four page directories of 64-bit entries, one for every GB
+uint64_t pae_directory[PAE_PDPT_SIZE * PAE_ENTRIES] __attribute__((aligned(FOUR_KB_SIZE)));
+// PAE: the page directory pointer table loaded into cr3
+uint64_t pae_pdpt[PAE_PDPT_SIZE] __attribute__((aligned(PAE_PDPT_ALIGN)));
+
+/* point the 4MB region r of virtual memory at a 4MB page or a page table */
+static void set_dir_entry(uint32_t r, uint32_t entry);
+/* read back the entry of the 4MB region r */
+static uint32_t get_dir_entry(uint32_t r);
 
 /* int init_page()
  *
@@ -18,19 +27,20 @@ void init_page()
     uint32_t base_add = 0x00000000;
 
     // initialize all the entry for paging directory and paging table to 0
+    for (i = 0; i < PAE_PDPT_SIZE; i++)
+    {
+        // PAE: the directories are always present, their entries are not
+        pae_pdpt[i] = ((uint32_t)(&pae_directory[i * PAE_ENTRIES]) & FOUR_LB_PB_MASK) | PRESENT_MASK;
+    }
     for (i = 0; i < DIR_SIZE; i++)
     {
-        page_directory[i] = 0;
         // set all the read/ write bit to 1
-        page_directory[i] |= R_W_MASK;
+        set_dir_entry(i, R_W_MASK);
     }
     for (i = 0; i < TABLE_SIZE; i++)
     {
-        page_table[i] = 0;
-        // set all the read/ write bit to 1
-        page_table[i] |= R_W_MASK;
-        // set bit 31 to 12 to its original address
-        page_table[i] |= base_add;
+        // set all the read/ write bit to 1, and bit 31 to 12 to its original address
+        pte_write(page_table, i, R_W_MASK | base_add);
         base_add += FOUR_KB_SIZE;
     }
 
@@ -38,6 +48,28 @@ void init_page()
     initialize_page_table();
     map_video();
 
+    if (paging_pae) {
+        asm volatile(
+
+            // load the physical base address of the page directory pointer table
+            "movl $pae_pdpt, %%eax              ;"
+            "movl %%eax, %%cr3                  ;"
+
+            // enable physical address extension, large pages are 2MB
+            "movl %%cr4, %%eax                  ;"
+            "orl  $0x00000020, %%eax            ;"
+            "movl %%eax, %%cr4                  ;"
+
+            // enable paging, set the bit 31 in cr0 register to 1
+            "movl %%cr0, %%eax                  ;"
+            "orl  $0x80000001, %%eax            ;"
+            "movl %%eax, %%cr0                  ;"
+            :
+            :
+            : "eax");
+        return;
+    }
+
     asm volatile(
 
         // load the physical base address of the page directory
@@ -58,6 +90,94 @@ void init_page()
         : "eax");
 }
 
+/* void select_paging_mode()
+ *
+ * Descriptions: use PAE paging when the boot command line asks for "pae"
+ *              and the processor supports it. Must run before init_page.
+ * Inputs: None
+ * Outputs: None
+ * Side Effects: Changing paging_pae
+ */
+void select_paging_mode()
+{
+    uint32_t features;
+
+    paging_pae = 0;
+    if (!cmdline_has(boot_cmdline, (int8_t*)"pae"))
+        return;
+
+    // cpuid leaf 1 reports PAE in bit 6 of edx
+    asm volatile(
+        "movl $1, %%eax                     ;"
+        "cpuid                              ;"
+        : "=d" (features)
+        :
+        : "eax", "ebx", "ecx");
+
+    if (features & CPUID_PAE)
+        paging_pae = 1;
+}
+
+/* uint32_t* pte_ptr(void* table, uint32_t idx)
+ *
+ * Descriptions: find an entry of a page table that covers 4MB. With PAE
+ *              the table is two 4KB tables of 64-bit entries in a row, and
+ *              the pointer is to the low half, which holds every flag and
+ *              the physical addresses the kernel uses.
+ * Inputs: void* table -- the table
+ *         uint32_t idx -- the 4KB page inside the 4MB, 0 to TABLE_SIZE - 1
+ * Outputs: pointer to the entry
+ * Side Effects: None
+ */
+uint32_t* pte_ptr(void* table, uint32_t idx)
+{
+    if (paging_pae)
+        return (uint32_t*)(&((uint64_t*)table)[idx]);
+    return &((uint32_t*)table)[idx];
+}
+
+/* uint32_t pte_read(void* table, uint32_t idx)
+ *
+ * Descriptions: read an entry of a page table that covers 4MB
+ * Inputs: void* table -- the table
+ *         uint32_t idx -- the 4KB page inside the 4MB
+ * Outputs: the low 32 bits of the entry
+ * Side Effects: None
+ */
+uint32_t pte_read(void* table, uint32_t idx)
+{
+    return *pte_ptr(table, idx);
+}
+
+/* void pte_write(void* table, uint32_t idx, uint32_t pte)
+ *
+ * Descriptions: write an entry of a page table that covers 4MB
+ * Inputs: void* table -- the table
+ *         uint32_t idx -- the 4KB page inside the 4MB
+ *         uint32_t pte -- the entry, the frame must be below 4GB
+ * Outputs: None
+ * Side Effects: None
+ */
+void pte_write(void* table, uint32_t idx, uint32_t pte)
+{
+    if (paging_pae)
+        ((uint64_t*)table)[idx] = pte;
+    else
+        ((uint32_t*)table)[idx] = pte;
+}
+
+/* uint32_t table_size()
+ *
+ * Descriptions: bytes taken by a page table that covers 4MB
+ * Inputs: None
+ * Outputs: FOUR_KB_SIZE, or twice that with PAE
+ * Side Effects: None
+ */
+uint32_t table_size()
+{
+    return paging_pae ? 2 * FOUR_KB_SIZE : FOUR_KB_SIZE;
+}
+
 /* int map_kernel()
  *
  * Descriptions: Build a 4MB page for kernel, set the second
@@ -76,7 +196,7 @@ void map_kernel()
     ker_entrance |= PS_MASK;
 
     ker_entrance |= ((uint32_t)(KERNEL_OFFSET)&FOUR_LB_PB_MASK);
-    page_directory[1] = ker_entrance;
+    set_dir_entry(KERNEL_OFFSET >> FOUR_MB_OFFSET, ker_entrance);
 }
 
 /* int map_video()
@@ -95,28 +215,28 @@ void map_video()
     vid_entrance |= VIDEO_OFFSET;
     vid_entrance |= R_W_MASK;
 
-    page_table[VIDEO_OFFSET >> FOUR_KB_OFFSET] = vid_entrance;
+    pte_write(page_table, VIDEO_OFFSET >> FOUR_KB_OFFSET, vid_entrance);
 
     // map the buffer that stores the screen content of first terminal
     vid_entrance = 0;
     vid_entrance |= PRESENT_MASK;
     vid_entrance |= TERMINAL_BUFFER_1;
     vid_entrance |= R_W_MASK;
-    page_table[TERMINAL_BUFFER_1 >> FOUR_KB_OFFSET] = vid_entrance;
+    pte_write(page_table, TERMINAL_BUFFER_1 >> FOUR_KB_OFFSET, vid_entrance);
 
     // map the buffer that stores the screen content of the second terminal
     vid_entrance = 0;
     vid_entrance |= PRESENT_MASK;
     vid_entrance |= TERMINAL_BUFFER_2;
     vid_entrance |= R_W_MASK;
-    page_table[TERMINAL_BUFFER_2 >> FOUR_KB_OFFSET] = vid_entrance;
+    pte_write(page_table, TERMINAL_BUFFER_2 >> FOUR_KB_OFFSET, vid_entrance);
 
     // map the buffer that stores the screen content of the thrid terminal
     vid_entrance = 0;
     vid_entrance |= PRESENT_MASK;
     vid_entrance |= TERMINAL_BUFFER_3;
     vid_entrance |= R_W_MASK;
-    page_table[TERMINAL_BUFFER_3 >> FOUR_KB_OFFSET] = vid_entrance;
+    pte_write(page_table, TERMINAL_BUFFER_3 >> FOUR_KB_OFFSET, vid_entrance);
 
     flush_tlb();
 }
@@ -142,7 +262,7 @@ void map_user_video(){
     // specify that this is user program
     vid_entrance |= (uint32_t)U_S_MASK;
     // map to page table
-    page_directory[pde_index] = vid_entrance;
+    set_dir_entry(pde_index, vid_entrance);
 
     vid_entrance = 0;
     // specify that this pte is for user program
@@ -154,7 +274,7 @@ void map_user_video(){
     // map the virtual address to physical address 
     vid_entrance |= VIDEO_OFFSET;
 
-    page_table_vidmem[0] = vid_entrance;
+    pte_write(page_table_vidmem, 0, vid_entrance);
 
     flush_tlb();
 
@@ -201,34 +321,257 @@ void initialize_page_table()
     // set bit 31-22 to address of page table
     init_entrance |= ((uint32_t)(page_table)&FOUR_LB_PB_MASK);
 
-    page_directory[0] = init_entrance;
+    set_dir_entry(0, init_entrance);
 }
 
 /* void map_program(uint32_t pid)
  *
- * Descriptions: map the paging for the program
+ * Descriptions: map the paging for the program. The 4MB program page is
+ *              made of 4KB pages, so that read-only text can be shared and
+ *              only the pages the program uses need memory. Both page
+ *              tables of a process are allocated by process_create.
  * Inputs: uint32_t pid -- the process id of the program to be mapped
  * Outputs: None
  * Side Effects: Changing page_directory
  */
 void map_program(uint32_t pid) {
     uint32_t program_entrance = 0;
+    pcb_t * pcb = get_pcb_by_index(pid);
+
+    if (pcb == NULL)
+        return;
 
     // presents the page
     program_entrance |= PRESENT_MASK;
-    // declare that it is 4MB page
-    program_entrance |= PS_MASK;
     // declare that it is a user program
     program_entrance |= U_S_MASK;
     // specify this page is readable and writable
     program_entrance |= R_W_MASK;
 
-    program_entrance |= (uint32_t)((pid * FOUR_MB_SIZE + EIGHT_MB_SIZE));
-    page_directory[PROGRAM_VIRTUAL] = program_entrance;
+    program_entrance |= ((uint32_t)(pcb->program_table) & FOUR_LB_PB_MASK);
+    set_dir_entry(PROGRAM_VIRTUAL, program_entrance);
+
+    // the shared memory window follows the program
+    program_entrance = 0;
+    program_entrance |= PRESENT_MASK;
+    program_entrance |= U_S_MASK;
+    program_entrance |= R_W_MASK;
+    program_entrance |= ((uint32_t)(pcb->shm_table) & FOUR_LB_PB_MASK);
+    set_dir_entry(SHM_VIRTUAL >> FOUR_MB_OFFSET, program_entrance);
+
+    flush_tlb();
+}
+
+/* void clear_program_table(uint32_t pid)
+ *
+ * Descriptions: unmap every 4KB page of the program page of a process
+ * Inputs: uint32_t pid -- the process whose table is cleared
+ * Outputs: None
+ * Side Effects: Changing the program page table of pid
+ */
+void clear_program_table(uint32_t pid) {
+    int i;
+    pcb_t * pcb = get_pcb_by_index(pid);
+
+    for (i = 0; i < TABLE_SIZE; i++)
+        pte_write(pcb->program_table, i, 0);
+
+    flush_tlb();
+}
+
+/* void map_program_page(uint32_t pid, uint32_t vaddr, uint32_t paddr)
+ *
+ * Descriptions: map a frame that only this process uses
+ * Inputs: uint32_t pid -- the process that owns the frame
+ *         uint32_t vaddr -- virtual address inside the program page
+ *         uint32_t paddr -- physical address of the frame
+ * Outputs: None
+ * Side Effects: Changing the program page table of pid
+ */
+void map_program_page(uint32_t pid, uint32_t vaddr, uint32_t paddr) {
+    uint32_t program_entrance = 0;
+    pcb_t * pcb = get_pcb_by_index(pid);
+
+    program_entrance |= PRESENT_MASK;
+    program_entrance |= U_S_MASK;
+    program_entrance |= R_W_MASK;
+    program_entrance |= (paddr & FOUR_LB_PB_MASK);
+    pte_write(pcb->program_table, (vaddr & TABLE_MASK) >> FOUR_KB_OFFSET, program_entrance);
 
     flush_tlb();
 }
 
+/* void map_program_text(uint32_t pid, uint32_t vaddr, uint32_t paddr)
+ *
+ * Descriptions: map a text frame that other processes may share. The
+ *              page is read-only for the user program, and marked so that
+ *              unloading the program does not free it.
+ * Inputs: uint32_t pid -- the process that uses the text
+ *         uint32_t vaddr -- virtual address inside the program page
+ *         uint32_t paddr -- physical address of the shared frame
+ * Outputs: None
+ * Side Effects: Changing the program page table of pid
+ */
+void map_program_text(uint32_t pid, uint32_t vaddr, uint32_t paddr) {
+    uint32_t text_entrance = 0;
+    pcb_t * pcb = get_pcb_by_index(pid);
+
+    text_entrance |= PRESENT_MASK;
+    text_entrance |= U_S_MASK;
+    text_entrance |= SHARED_MASK;
+    text_entrance |= (paddr & FOUR_LB_PB_MASK);
+    pte_write(pcb->program_table, (vaddr & TABLE_MASK) >> FOUR_KB_OFFSET, text_entrance);
+
+    flush_tlb();
+}
+
+/* uint32_t get_program_page(uint32_t pid, uint32_t vaddr)
+ *
+ * Descriptions: read the pte that maps a page of the program page
+ * Inputs: uint32_t pid -- the process to look at
+ *         uint32_t vaddr -- virtual address inside the program page
+ * Outputs: the pte, 0 if the page is not mapped
+ * Side Effects: None
+ */
+uint32_t get_program_page(uint32_t pid, uint32_t vaddr) {
+    pcb_t * pcb = get_pcb_by_index(pid);
+
+    if (pcb == NULL || (vaddr & FOUR_MB_PB_MASK) != _128_MB_SIZE)
+        return 0;
+    return pte_read(pcb->program_table, (vaddr & TABLE_MASK) >> FOUR_KB_OFFSET);
+}
+
+/* uint32_t* get_mapped_program_pte(uint32_t vaddr)
+ *
+ * Descriptions: find the pte of a page through the page directory, so it
+ *              works for whichever program page is installed, even while
+ *              execute runs on the kernel stack of the parent
+ * Inputs: uint32_t vaddr -- virtual address inside the program page
+ * Outputs: pointer to the pte, NULL if no program page is mapped
+ * Side Effects: None
+ */
+uint32_t* get_mapped_program_pte(uint32_t vaddr) {
+    uint32_t pde = get_dir_entry(PROGRAM_VIRTUAL);
+
+    if ((vaddr & FOUR_MB_PB_MASK) != _128_MB_SIZE || !(pde & PRESENT_MASK) || (pde & PS_MASK))
+        return NULL;
+    return pte_ptr((void*)(pde & FOUR_LB_PB_MASK), (vaddr & TABLE_MASK) >> FOUR_KB_OFFSET);
+}
+
+/* void map_kernel_pool(uint32_t start, uint32_t end)
+ *
+ * Descriptions: identity map the physical frame pool with 4MB pages that only
+ *              the kernel can access, so frames can be used through their
+ *              physical address
+ * Inputs: uint32_t start -- first byte of the pool, 4MB aligned
+ *         uint32_t end -- first byte after the pool
+ * Outputs: None
+ * Side Effects: Changing page_directory
+ */
+void map_kernel_pool(uint32_t start, uint32_t end) {
+    uint32_t addr;
+    uint32_t pool_entrance;
+
+    for (addr = start & FOUR_MB_PB_MASK; addr < end && addr < _128_MB_SIZE; addr += FOUR_MB_SIZE) {
+        pool_entrance = 0;
+        // presents the page
+        pool_entrance |= PRESENT_MASK;
+        // declare that it is 4MB page
+        pool_entrance |= PS_MASK;
+        // the kernel writes into the frames
+        pool_entrance |= R_W_MASK;
+        pool_entrance |= addr;
+        set_dir_entry(addr >> FOUR_MB_OFFSET, pool_entrance);
+    }
+
+    flush_tlb();
+}
+
+/* void map_mmio(uint32_t addr)
+ *
+ * Descriptions: identity map the 4MB region that holds the registers of a
+ *              device, like the local APIC, with caching off
+ * Inputs: uint32_t addr -- any address of the region
+ * Outputs: None
+ * Side Effects: Changing page_directory
+ */
+void map_mmio(uint32_t addr) {
+    uint32_t mmio_entrance = 0;
+
+    // presents the page
+    mmio_entrance |= PRESENT_MASK;
+    // declare that it is 4MB page
+    mmio_entrance |= PS_MASK;
+    // registers are written, and must not be cached
+    mmio_entrance |= R_W_MASK | PCD_MASK | PWT_MASK;
+    mmio_entrance |= addr & FOUR_MB_PB_MASK;
+    set_dir_entry(addr >> FOUR_MB_OFFSET, mmio_entrance);
+
+    flush_tlb();
+}
+
+/* void map_shm_page(uint32_t pid, uint32_t vaddr, uint32_t paddr)
+ *
+ * Descriptions: map a 4KB frame into the shared memory window of a process
+ * Inputs: uint32_t pid -- the process that attaches the frame
+ *         uint32_t vaddr -- virtual address inside the window
+ *         uint32_t paddr -- physical address of the frame
+ * Outputs: None
+ * Side Effects: Changing the shared memory page table of pid
+ */
+void map_shm_page(uint32_t pid, uint32_t vaddr, uint32_t paddr) {
+    uint32_t shm_entrance = 0;
+
+    shm_entrance |= PRESENT_MASK;
+    shm_entrance |= U_S_MASK;
+    shm_entrance |= R_W_MASK;
+    shm_entrance |= (paddr & FOUR_LB_PB_MASK);
+    pte_write(get_pcb_by_index(pid)->shm_table, (vaddr & TABLE_MASK) >> FOUR_KB_OFFSET, shm_entrance);
+
+    flush_tlb();
+}
+
+/* void unmap_shm_page(uint32_t pid, uint32_t vaddr)
+ *
+ * Descriptions: remove a 4KB page from the shared memory window of a process
+ * Inputs: uint32_t pid -- the process that detaches the page
+ *         uint32_t vaddr -- virtual address inside the window
+ * Outputs: None
+ * Side Effects: Changing the shared memory page table of pid
+ */
+void unmap_shm_page(uint32_t pid, uint32_t vaddr) {
+    pte_write(get_pcb_by_index(pid)->shm_table, (vaddr & TABLE_MASK) >> FOUR_KB_OFFSET, 0);
+    flush_tlb();
+}
+
+/* int32_t shm_page_present(uint32_t pid, uint32_t vaddr)
+ *
+ * Descriptions: check whether a page in the shared memory window is mapped
+ * Inputs: uint32_t pid -- the process to check
+ *         uint32_t vaddr -- virtual address inside the window
+ * Outputs: 1 if the page is mapped, 0 otherwise
+ * Side Effects: None
+ */
+int32_t shm_page_present(uint32_t pid, uint32_t vaddr) {
+    return (pte_read(get_pcb_by_index(pid)->shm_table, (vaddr & TABLE_MASK) >> FOUR_KB_OFFSET) & PRESENT_MASK) != 0;
+}
+
+/* void clear_shm_table(uint32_t pid)
+ *
+ * Descriptions: unmap the whole shared memory window of a process
+ * Inputs: uint32_t pid -- the process whose window is cleared
+ * Outputs: None
+ * Side Effects: Changing the shared memory page table of pid
+ */
+void clear_shm_table(uint32_t pid) {
+    int i;
+    pcb_t * pcb = get_pcb_by_index(pid);
+
+    for (i = 0; i < TABLE_SIZE; i++)
+        pte_write(pcb->shm_table, i, 0);
+    flush_tlb();
+}
+
 /* void map_terminal_video(uint8_t terminal_id)
  * --------------------------------------------------------------------------------------
  * Descriptions: This function is a helper funtion for scheduling.
@@ -263,7 +606,7 @@ void map_terminal_video(uint8_t terminal_id){
     // specify that this is user program
     vid_entrance |= (uint32_t)U_S_MASK;
     // map to page table
-    page_directory[pde_index] = vid_entrance;
+    set_dir_entry(pde_index, vid_entrance);
 
     vid_entrance = 0;
     // specify that this pte is for user program
@@ -275,7 +618,7 @@ void map_terminal_video(uint8_t terminal_id){
     // map the virtual address to physical address 
     vid_entrance |= (VIDEO_OFFSET + (terminal_id + 1) * FOUR_KB_SIZE);
 
-    page_table_vidmem[0] = vid_entrance;
+    pte_write(page_table_vidmem, 0, vid_entrance);
 
     flush_tlb();
 
@@ -289,7 +632,7 @@ void map_terminal_video(uint8_t terminal_id){
  * Outputs: None
  * Side Effects: flush the tlb
  */
-static void flush_tlb() {
+void flush_tlb() {
     asm volatile(
         "movl %%cr3, %%eax;"
         "movl %%eax, %%cr3;"
@@ -298,3 +641,68 @@ static void flush_tlb() {
         : "eax"
     );
 }
+
+/* void set_dir_entry(uint32_t r, uint32_t entry)
+ *
+ * Descriptions: install a directory entry for the 4MB region r. Without PAE
+ *              this is entry r of page_directory. With PAE the region is
+ *              two 2MB entries: a 4MB page becomes two 2MB pages, and a
+ *              4MB page table becomes its two 4KB halves.
+ * Inputs: uint32_t r -- the region, virtual address >> 22
+ *         uint32_t entry -- a 32-bit style directory entry
+ * Outputs: None
+ * Side Effects: Changing page_directory or pae_directory
+ */
+static void set_dir_entry(uint32_t r, uint32_t entry) {
+    uint32_t half = (entry & PS_MASK) ? TWO_MB_SIZE : FOUR_KB_SIZE;
+
+    if (!paging_pae) {
+        page_directory[r] = entry;
+        return;
+    }
+
+    pae_directory[2 * r] = entry;
+    if (entry & PRESENT_MASK)
+        pae_directory[2 * r + 1] = entry + half;
+    else
+        pae_directory[2 * r + 1] = entry;
+}
+
+/* uint32_t get_dir_entry(uint32_t r)
+ *
+ * Descriptions: read the directory entry of the 4MB region r
+ * Inputs: uint32_t r -- the region, virtual address >> 22
+ * Outputs: the entry, as set_dir_entry received it
+ * Side Effects: None
+ */
+static uint32_t get_dir_entry(uint32_t r) {
+    if (paging_pae)
+        return (uint32_t)pae_directory[2 * r];
+    return page_directory[r];
+}
+
+/* int32_t user_writable(uint32_t start, uint32_t size)
+ *
+ * Descriptions: check that the calling program can write every byte of a
+ *              buffer it passed to a system call, a swapped out page comes
+ *              back when the kernel writes it
+ * Inputs: uint32_t start -- first byte of the buffer
+ *         uint32_t size -- its length
+ * Outputs: 0 if the kernel may write it, -1 otherwise
+ * Side Effects: None
+ */
+int32_t user_writable(uint32_t start, uint32_t size) {
+    uint32_t addr;
+    uint32_t pte;
+
+    if (start < _128_MB_SIZE || start + size > _128_MB_SIZE + FOUR_MB_SIZE || start + size < start)
+        return -1;
+
+    // private pages are writable, and only private pages go to swap
+    for (addr = start & FOUR_LB_PB_MASK; addr < start + size; addr += FOUR_KB_SIZE) {
+        pte = get_program_page(get_curr_pcb()->pid, addr);
+        if ((pte & (PRESENT_MASK | R_W_MASK)) != (PRESENT_MASK | R_W_MASK) && !(pte & SWAPPED_MASK))
+            return -1;
+    }
+    return 0;
+}
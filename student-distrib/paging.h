@@ -6,6 +6,13 @@
 #define DIR_SIZE 1024
 #define TABLE_SIZE 1024
 
+// PAE: 64-bit entries, 512 per table, large pages are 2MB
+#define PAE_ENTRIES         512
+#define PAE_PDPT_SIZE       4
+#define PAE_PDPT_ALIGN      32
+#define TWO_MB_SIZE         0x00200000
+#define CPUID_PAE           0x00000040
+
 #define VIDEO_OFFSET        0x000B8000
 #define KERNEL_OFFSET       0x00400000
 
@@ -21,6 +28,14 @@
 #define AVAIL_MASK          0x00000E00
 
 #define AVAIL_OFFSET        0xA
+// available bit of a program pte whose frame belongs to the text cache
+#define SHARED_MASK         0x00000200
+// available bit of a non-present program pte whose page is in swap, the
+// swap slot is kept in bits 31-12
+#define SWAPPED_MASK        0x00000400
+// available bit of a swapped pte whose page is still being written to or
+// read from the swap disk
+#define SWAP_BUSY_MASK      0x00000800
 
 #define FOUR_MB_OFFSET      22
 #define FOUR_MB_PB_MASK     0xFFC00000
@@ -34,15 +49,41 @@
 
 #define USER_VIDEO          (_128_MB_SIZE + (EIGHT_MB_SIZE * 10))
 
+// window right above the program page where shared memory is attached
+#define SHM_VIRTUAL         (_128_MB_SIZE + FOUR_MB_SIZE)
+#define SHM_VIRTUAL_END     (SHM_VIRTUAL + FOUR_MB_SIZE)
+
+/*
+ * Every page table the kernel builds covers 4MB, whatever the mode. Without
+ * PAE it is 1024 32-bit entries and one 4MB directory entry points at it.
+ * With PAE it is 1024 64-bit entries, two 4KB tables in a row that two 2MB
+ * directory entries point at. Code outside paging.c goes through pte_read,
+ * pte_write and pte_ptr so it works in both modes.
+ */
+// 1 when PAE paging is used
+extern uint32_t paging_pae;
+// PAE page directories and their pointer table
+extern uint64_t pae_directory[PAE_PDPT_SIZE * PAE_ENTRIES];
+extern uint64_t pae_pdpt[PAE_PDPT_SIZE];
 // buffer for page directory
 uint32_t page_directory[DIR_SIZE] __attribute__((aligned(FOUR_KB_SIZE)));
-// only the first 4KB memory needs page table
-uint32_t page_table[TABLE_SIZE] __attribute__((aligned(FOUR_KB_SIZE)));
+// only the first 4KB memory needs page table, large enough for PAE entries
+uint32_t page_table[2 * TABLE_SIZE] __attribute__((aligned(FOUR_KB_SIZE)));
 // The page table for user video mem
-uint32_t page_table_vidmem[TABLE_SIZE] __attribute__((aligned(FOUR_KB_SIZE)));
+uint32_t page_table_vidmem[2 * TABLE_SIZE] __attribute__((aligned(FOUR_KB_SIZE)));
 
 /* Initializing paging for OS */
 extern void init_page();
+/* pick PAE or 32-bit paging from the boot command line, before init_page */
+extern void select_paging_mode();
+/* pointer to the low 32 bits of an entry of a 4MB page table */
+extern uint32_t* pte_ptr(void* table, uint32_t idx);
+/* read an entry of a 4MB page table */
+extern uint32_t pte_read(void* table, uint32_t idx);
+/* write an entry of a 4MB page table */
+extern void pte_write(void* table, uint32_t idx, uint32_t pte);
+/* bytes taken by a 4MB page table in the current mode */
+extern uint32_t table_size();
 /* Build a 4MB page for kernel, set the second entrance of page_directory to the address of kernel */
 extern void map_kernel();
 /* set the specific entrance for page_table to let video memory maps to its page */
@@ -51,11 +92,37 @@ extern void initialize_page_table();
 extern void map_video();
 /* setup the paging for specific user program */
 extern void map_program(uint32_t pid);
+/* unmap every page of the program page of pid */
+extern void clear_program_table(uint32_t pid);
+/* map a private frame read-write into the program page of pid */
+extern void map_program_page(uint32_t pid, uint32_t vaddr, uint32_t paddr);
+/* map a shared frame read-only into the program page of pid */
+extern void map_program_text(uint32_t pid, uint32_t vaddr, uint32_t paddr);
+/* read the pte of a page in the program page of pid */
+extern uint32_t get_program_page(uint32_t pid, uint32_t vaddr);
+/* find the pte that maps vaddr in the program page that is mapped now */
+extern uint32_t* get_mapped_program_pte(uint32_t vaddr);
+/* flush the tlb */
+extern void flush_tlb();
 /* map the virtual addr of user to video mem */
 extern void map_user_video();
 /* helper funtion for scheduling, especially for fish */
 extern void map_user_video_to_buffer(uint8_t terminal_id);
 /* helper funtion for scheduling, especially for fish */
 extern void map_terminal_video(uint8_t terminal_id);
+/* identity map [start, end) with kernel 4MB pages for the frame pool */
+extern void map_kernel_pool(uint32_t start, uint32_t end);
+/* identity map the 4MB region of a device's registers, uncached and kernel only */
+extern void map_mmio(uint32_t addr);
+/* map one 4KB frame into the shared memory window of a process */
+extern void map_shm_page(uint32_t pid, uint32_t vaddr, uint32_t paddr);
+/* remove one 4KB page from the shared memory window of a process */
+extern void unmap_shm_page(uint32_t pid, uint32_t vaddr);
+/* check whether a page in the shared memory window is already used */
+extern int32_t shm_page_present(uint32_t pid, uint32_t vaddr);
+/* empty the shared memory window of a process */
+extern void clear_shm_table(uint32_t pid);
+/* 0 if the calling program may pass [start, start + size) to be written, -1 otherwise */
+extern int32_t user_writable(uint32_t start, uint32_t size);
 
 #endif
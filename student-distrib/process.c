@@ -0,0 +1,341 @@
+#include "process.h"
+#include "swap.h"
+#include "meminfo.h"
+
+uint32_t max_task = 0;
+
+// pcb of every pid, NULL when the pid is free
+static pcb_t** pcb_table = NULL;
+// one bit per pid, 1 means the pid is in use
+static uint32_t* pid_bitmap = NULL;
+// kernel stack of a halted process, freed once nobody runs on it
+static uint32_t dead_kstack = 0;
+
+/* allocate the 8KB kernel stack a pcb sits at the bottom of */
+static uint32_t kstack_alloc();
+/* give a kernel stack from kstack_alloc back */
+static void kstack_free(uint32_t kstack);
+/* allocate a zeroed page table covering 4MB, which takes two frames with PAE */
+static uint32_t table_alloc();
+/* free a page table from table_alloc */
+static void table_free(uint32_t table);
+
+/* void init_process()
+ * --------------------------------------------------------------------------------------
+ * Descriptions:    Size the process table from the frame pool, so that every
+ *                  process can get at least a kernel stack, its page tables
+ *                  and a small program. The table and the pid bitmap share
+ *                  one frame.
+ * Inputs:          None
+ * Outputs:         None
+ * Side Effects:    Allocates one frame
+ */
+void init_process() {
+    uint32_t i;
+    uint32_t table;
+
+    max_task = frame_total_count() / PROCESS_MIN_FRAMES;
+    if (max_task > PID_LIMIT)
+        max_task = PID_LIMIT;
+
+    if (max_task == 0 || (table = frame_alloc()) == 0) {
+        max_task = 0;
+        return;
+    }
+
+    pcb_table = (pcb_t**)table;
+    pid_bitmap = (uint32_t*)(table + max_task * sizeof(pcb_t*));
+    for (i = 0; i < max_task; i++)
+        pcb_table[i] = NULL;
+    for (i = 0; i < (max_task + PID_BITS - 1) / PID_BITS; i++)
+        pid_bitmap[i] = 0;
+    mem_charge(MEM_PROCESS_TABLE, 1);
+}
+
+/* int32_t pid_alloc()
+ * --------------------------------------------------------------------------------------
+ * Descriptions:    Reserve the lowest pid that is not in use
+ * Inputs:          None
+ * Outputs:         the pid, -1 if the process table is full
+ * Side Effects:    Changing pid_bitmap
+ */
+int32_t pid_alloc() {
+    int32_t pid;
+    uint32_t flags;
+
+    cli_and_save(flags);
+    if ((pid = pid_peek()) != -1)
+        pid_bitmap[pid / PID_BITS] |= (1 << (pid % PID_BITS));
+    restore_flags(flags);
+    return pid;
+}
+
+/* int32_t pid_peek()
+ * --------------------------------------------------------------------------------------
+ * Descriptions:    Find the lowest pid that is not in use, skipping full words
+ * Inputs:          None
+ * Outputs:         the pid, -1 if the process table is full
+ * Side Effects:    None
+ */
+int32_t pid_peek() {
+    uint32_t i;
+    uint32_t bit;
+
+    for (i = 0; i < (max_task + PID_BITS - 1) / PID_BITS; i++) {
+        if (pid_bitmap[i] == 0xFFFFFFFF)
+            continue;
+        for (bit = 0; bit < PID_BITS; bit++) {
+            if (i * PID_BITS + bit >= max_task)
+                return -1;
+            if ((pid_bitmap[i] & (1 << bit)) == 0)
+                return i * PID_BITS + bit;
+        }
+    }
+    return -1;
+}
+
+/* void pid_free(uint32_t pid)
+ * --------------------------------------------------------------------------------------
+ * Descriptions:    Mark a pid as free
+ * Inputs:          uint32_t pid :  the pid to give back
+ * Outputs:         None
+ * Side Effects:    Changing pid_bitmap
+ */
+void pid_free(uint32_t pid) {
+    uint32_t flags;
+
+    if (pid >= max_task)
+        return;
+    cli_and_save(flags);
+    pid_bitmap[pid / PID_BITS] &= ~(1 << (pid % PID_BITS));
+    restore_flags(flags);
+}
+
+/* pcb_t* process_create(uint32_t pid)
+ * --------------------------------------------------------------------------------------
+ * Descriptions:    Allocate an 8KB kernel stack with the pcb at its bottom,
+ *                  plus the page tables of the program page and of the shared
+ *                  memory window.
+ * Inputs:          uint32_t pid :  a pid returned by pid_alloc
+ * Outputs:         the new pcb, NULL if memory ran out
+ * Side Effects:    Changing pcb_table
+ */
+pcb_t* process_create(uint32_t pid) {
+    uint32_t kstack;
+    uint32_t program_table;
+    uint32_t shm_table;
+    pcb_t * pcb;
+
+    if (pid >= max_task)
+        return NULL;
+
+    if ((kstack = kstack_alloc()) == 0)
+        return NULL;
+    if ((program_table = table_alloc()) == 0) {
+        kstack_free(kstack);
+        return NULL;
+    }
+    if ((shm_table = table_alloc()) == 0) {
+        table_free(program_table);
+        kstack_free(kstack);
+        return NULL;
+    }
+
+    pcb = (pcb_t*)kstack;
+    memset((void*)pcb, 0, sizeof(pcb_t));
+    pcb->pid = pid;
+    pcb->program_table = (uint32_t*)program_table;
+    pcb->shm_table = (uint32_t*)shm_table;
+    pcb_table[pid] = pcb;
+
+    return pcb;
+}
+
+/* pcb_t* thread_alloc(uint32_t pid, pcb_t* proc)
+ * --------------------------------------------------------------------------------------
+ * Descriptions:    Allocate the kernel stack and pcb of a thread of proc. The
+ *                  thread uses the page tables of proc instead of its own.
+ * Inputs:          uint32_t pid :  a pid returned by pid_alloc
+ *                  pcb_t* proc :   the process the thread belongs to
+ * Outputs:         the new pcb, NULL if memory ran out
+ * Side Effects:    Changing pcb_table
+ */
+pcb_t* thread_alloc(uint32_t pid, pcb_t* proc) {
+    uint32_t kstack;
+    pcb_t * pcb;
+
+    if (pid >= max_task || (kstack = kstack_alloc()) == 0)
+        return NULL;
+
+    pcb = (pcb_t*)kstack;
+    memset((void*)pcb, 0, sizeof(pcb_t));
+    pcb->pid = pid;
+    pcb->leader = proc;
+    pcb->program_table = proc->program_table;
+    pcb->shm_table = proc->shm_table;
+    pcb_table[pid] = pcb;
+
+    return pcb;
+}
+
+/* pcb_t* kthread_alloc()
+ * --------------------------------------------------------------------------------------
+ * Descriptions:    Allocate the kernel stack and pcb of a kernel task. It has
+ *                  no pid and no page tables, and stays out of pcb_table so
+ *                  nothing that walks the processes finds it.
+ * Inputs:          None
+ * Outputs:         the new pcb, NULL if memory ran out
+ * Side Effects:    None
+ */
+pcb_t* kthread_alloc() {
+    uint32_t kstack;
+    pcb_t * pcb;
+
+    if ((kstack = kstack_alloc()) == 0)
+        return NULL;
+
+    pcb = (pcb_t*)kstack;
+    memset((void*)pcb, 0, sizeof(pcb_t));
+    pcb->kthread = 1;
+    return pcb;
+}
+
+/* void kthread_free(pcb_t* pcb)
+ * --------------------------------------------------------------------------------------
+ * Descriptions:    Free the kernel stack of a kernel task that is done. The
+ *                  task calls this itself, so like the stack of a halted
+ *                  process it is only freed after the next context switch.
+ * Inputs:          pcb_t* pcb :    a pcb returned by kthread_alloc
+ * Outputs:         None
+ * Side Effects:    None
+ */
+void kthread_free(pcb_t* pcb) {
+    uint32_t flags;
+
+    cli_and_save(flags);
+    process_reap();
+    if ((uint32_t)pcb == (uint32_t)get_curr_pcb()) {
+        dead_kstack = (uint32_t)pcb;
+    } else {
+        kstack_free((uint32_t)pcb);
+    }
+    restore_flags(flags);
+}
+
+/* void process_destroy(uint32_t pid)
+ * --------------------------------------------------------------------------------------
+ * Descriptions:    Free the page tables and the kernel stack of a process, or
+ *                  only the kernel stack of a thread. halt still runs on the
+ *                  kernel stack of the process it destroys, so that stack is
+ *                  kept until another process is created.
+ * Inputs:          uint32_t pid :  the process to destroy
+ * Outputs:         None
+ * Side Effects:    Changing pcb_table
+ */
+void process_destroy(uint32_t pid) {
+    pcb_t * pcb;
+    uint32_t flags;
+
+    if (pid >= max_task || (pcb = pcb_table[pid]) == NULL)
+        return;
+
+    cli_and_save(flags);
+    pcb_table[pid] = NULL;
+    // the tables of a thread belong to its process
+    if (pcb->leader == NULL) {
+        table_free((uint32_t)pcb->program_table);
+        table_free((uint32_t)pcb->shm_table);
+    }
+
+    process_reap();
+    if ((uint32_t)pcb == (uint32_t)get_curr_pcb()) {
+        dead_kstack = (uint32_t)pcb;
+    } else {
+        kstack_free((uint32_t)pcb);
+    }
+    restore_flags(flags);
+}
+
+/* uint32_t get_kernel_stack(uint32_t pid)
+ * Inputs: pid -- the process id
+ * Return Value: the address tss.esp0 has to hold while pid runs
+ * Function: find the top of the kernel stack of a process
+ */
+uint32_t get_kernel_stack(uint32_t pid) {
+    return (uint32_t)get_pcb_by_index(pid) + EIGHT_KB_SIZE - ESP_OFFSET;
+}
+
+/*
+ * pcb_t* get_pcb_by_index(uint32_t index)
+ * Inputs: index -- the process number
+ * Return Value: pcb pointer, NULL if no process uses that number
+ * Function: get the pcb pointer corresponding to the process number
+ */
+pcb_t* get_pcb_by_index(uint32_t index) {
+    if (index >= max_task)
+        return NULL;
+    return pcb_table[index];
+}
+
+/* void process_reap()
+ * Inputs: none
+ * Return Value: none
+ * Function: free the kernel stack left by the last halt once the cpu runs
+ *           on another stack, called after every context switch
+ */
+void process_reap() {
+    uint32_t flags;
+
+    cli_and_save(flags);
+    if (dead_kstack != 0 && dead_kstack != (uint32_t)get_curr_pcb()) {
+        kstack_free(dead_kstack);
+        dead_kstack = 0;
+    }
+    restore_flags(flags);
+}
+
+static uint32_t kstack_alloc() {
+    uint32_t i;
+    uint32_t kstack;
+
+    process_reap();
+
+    // user pages can go to swap to make room for the kernel stack
+    kstack = frame_alloc_block(KSTACK_FRAMES);
+    for (i = 0; kstack == 0 && i < SWAP_BLOCK_TRIES && swap_out() == 0; i++)
+        kstack = frame_alloc_block(KSTACK_FRAMES);
+    if (kstack != 0)
+        mem_charge(MEM_KSTACK, KSTACK_FRAMES);
+    return kstack;
+}
+
+static void kstack_free(uint32_t kstack) {
+    frame_put(kstack);
+    frame_put(kstack + FOUR_KB_SIZE);
+    mem_charge(MEM_KSTACK, -KSTACK_FRAMES);
+}
+
+static uint32_t table_alloc() {
+    uint32_t i;
+    uint32_t table;
+
+    if (table_size() == FOUR_KB_SIZE) {
+        table = swap_frame_alloc_zeroed();
+    } else {
+        table = frame_alloc_block(table_size() / FOUR_KB_SIZE);
+        for (i = 0; table == 0 && i < SWAP_BLOCK_TRIES && swap_out() == 0; i++)
+            table = frame_alloc_block(table_size() / FOUR_KB_SIZE);
+        if (table != 0)
+            memset((void*)table, 0, table_size());
+    }
+    if (table != 0)
+        mem_charge(MEM_PAGE_TABLE, table_size() / FOUR_KB_SIZE);
+    return table;
+}
+
+static void table_free(uint32_t table) {
+    uint32_t i;
+    for (i = 0; i < table_size(); i += FOUR_KB_SIZE)
+        frame_put(table + i);
+    mem_charge(MEM_PAGE_TABLE, -(int32_t)(table_size() / FOUR_KB_SIZE));
+}
@@ -0,0 +1,40 @@
+#ifndef PROCESS_H
+#define PROCESS_H
+
+#include "types.h"
+#include "lib.h"
+#include "frame.h"
+#include "paging.h"
+
+#define PID_LIMIT           512         // largest process table the kernel builds
+#define PROCESS_MIN_FRAMES  16          // kernel stack, page tables and a small program
+#define KSTACK_FRAMES       (EIGHT_KB_SIZE / FOUR_KB_SIZE)
+#define PID_BITS            32
+
+// number of processes that can exist, decided at boot from the pool size
+extern uint32_t max_task;
+
+/* build the process table and the pid bitmap */
+extern void init_process();
+/* reserve the lowest free pid, -1 if the table is full */
+extern int32_t pid_alloc();
+/* return the lowest free pid without reserving it, -1 if the table is full */
+extern int32_t pid_peek();
+/* give a pid back */
+extern void pid_free(uint32_t pid);
+/* allocate the kernel stack, pcb and page tables of a process */
+extern pcb_t* process_create(uint32_t pid);
+/* allocate the kernel stack and pcb of a thread that shares the page tables of proc */
+extern pcb_t* thread_alloc(uint32_t pid, pcb_t* proc);
+/* allocate the kernel stack and pcb of a kernel task, which has no pid */
+extern pcb_t* kthread_alloc();
+/* free the kernel stack of a kernel task, once nobody runs on it */
+extern void kthread_free(pcb_t* pcb);
+/* free everything process_create or thread_alloc allocated */
+extern void process_destroy(uint32_t pid);
+/* free the kernel stack of a halted process once nobody runs on it */
+extern void process_reap();
+/* top of the kernel stack of a process, used for tss.esp0 */
+extern uint32_t get_kernel_stack(uint32_t pid);
+
+#endif
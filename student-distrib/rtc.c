@@ -1,6 +1,7 @@
 #include "rtc.h"
 #include "idt.h"
 #include "lib.h"
+#include "scheduling.h"
 
 //index-port/data-port (0x70/0x71) of the RTC
 #define RTC_PORT 0x70
@@ -20,6 +21,10 @@
 volatile int itr_occur_table[MAX_TERMINAL_NUM] = {0,0,0};
 volatile int counter_table[MAX_TERMINAL_NUM] = {0,0,0};
 volatile int constant_arr[MAX_TERMINAL_NUM] = {1024,1024,1024};
+// readers of each terminal waiting for the next virtual tick
+static wait_queue_t rtc_wait[MAX_TERMINAL_NUM];
+// open rtc files, the interrupt stays masked while there are none
+static uint32_t rtc_users = 0;
 
 /*
  * Function:  rtc_init
@@ -30,7 +35,9 @@ volatile int constant_arr[MAX_TERMINAL_NUM] = {1024,1024,1024};
  *
  *  Returns: none
  *
- *  Side effects: turn on PIE at control register B
+ *  Side effects: turn on PIE at control register B, the irq is unmasked
+ *                by the first rtc_open so an idle cpu is not woken 1024
+ *                times a second for nobody
  *
  */
 void rtc_init()
@@ -45,7 +52,6 @@ void rtc_init()
   unsigned char B = inb(CMOS_PORT);
   outb(RTC_REG_B, RTC_PORT);
   outb(SIXTH_BIT | B, CMOS_PORT); //turn on PIE
-  enable_irq(RTC_IRQ);
 }
 
 /*
@@ -102,20 +108,20 @@ void rtc_handler()
   send_eoi(RTC_IRQ);
   // itr_occur = 1;
   int i = 0;
-  cli();
+  // the gate keeps interrupts off for this short loop
   for (i = 0; i < MAX_TERMINAL_NUM; i++) {
     /* change interrupt table */
     counter_table[i] += 1;
     if(counter_table[i] >= constant_arr[i]){
       counter_table[i] = 0;
       itr_occur_table[i] = 1;
+      wake_up(&rtc_wait[i]);
     }
   }
   //printf("%d %d\n", itr_occur_table[0], constant_arr[0]);
   outb(RTC_REG_C, RTC_PORT);
   // test_interrupts();
   inb(CMOS_PORT);
-  sti();
 }
 
 /*
@@ -133,11 +139,21 @@ void rtc_handler()
  */
 int rtc_read(int32_t fd, void *buf, int32_t nbytes)
 {
-  // while (!itr_occur);
-  while(!itr_occur_table[running_terminal]){
+  uint32_t flags;
+  pcb_t* pcb = get_curr_pcb();
+  uint8_t tid = pcb->terminal_id;
+
+  // sleep until rtc_handler wakes us, instead of spinning for the slice
+  cli_and_save(flags);
+  while(!itr_occur_table[tid]){
+    if(signal_pending(pcb) || sleep_on(&rtc_wait[tid]) == -1){
+      // a signal, it is delivered on the way back to the program
+      restore_flags(flags);
+      return -1;
+    }
   }
-  // itr_occur = 0;
-  itr_occur_table[running_terminal] = 0;
+  itr_occur_table[tid] = 0;
+  restore_flags(flags);
   return 0;
 }
 
@@ -179,7 +195,17 @@ int rtc_write(int32_t fd, const void *buf, int32_t nbytes)
    */
 int rtc_open(const uint8_t *filename)
 {
+  uint32_t flags;
+
   rtc_set_freq(2);
+  cli_and_save(flags);
+  if (rtc_users++ == 0) {
+    // drop an interrupt that came while masked, or the rtc never raises another
+    outb(RTC_REG_C, RTC_PORT);
+    inb(CMOS_PORT);
+    enable_irq(RTC_IRQ);
+  }
+  restore_flags(flags);
   return 0;
 }
 
@@ -198,5 +224,11 @@ int rtc_open(const uint8_t *filename)
     */
 int rtc_close(int32_t fd)
 {
+  uint32_t flags;
+
+  cli_and_save(flags);
+  if (rtc_users > 0 && --rtc_users == 0)
+    disable_irq(RTC_IRQ);
+  restore_flags(flags);
   return 0;
 }
@@ -1,13 +1,13 @@
 #include "sb16.h"
+#include "scheduling.h"
 
 #define BLOCK_SIZE     (32*1024)
 #define BUFFER_SIZE    (2 * BLOCK_SIZE)
+#define AUDIO_SILENCE  0x80             // the middle of an unsigned 8 bit sample
 
 //Allocate a buffer that does not cross a 64k physical page boundary
 static int8_t DMA_Buffer[BUFFER_SIZE] __attribute__((aligned(32768))) = {};
-static int8_t *block1 = DMA_Buffer;
-static int8_t *block2 = &(DMA_Buffer[BLOCK_SIZE]);
-static int8_t *cur_block = DMA_Buffer;
+static int8_t *blocks[2] = {DMA_Buffer, &(DMA_Buffer[BLOCK_SIZE])};
 static int8_t audio_filename[33];
 static uint32_t current_offset;
 static int8_t is_playing = 0;
@@ -19,6 +19,36 @@ static int8_t page_ports[8] = {0x87, 0x83, 0x81, 0x82, 0x00, 0x8B, 0x89, 0x8A};
 // 
 int32_t _fd;
 
+/*
+ * The DSP plays one half of DMA_Buffer while the other holds the next
+ * part of the file. At the end of a half, sb16_handler starts the other
+ * one right away and wakes the refill task, a real time kernel task that
+ * reads the file into the half that just finished. Reading 32KB takes
+ * far less than playing it, so the refill runs a whole half ahead; if it
+ * still falls behind, the DSP waits for it and the underrun is counted.
+ */
+// the half the DSP plays, or waits for
+static volatile uint8_t play_block = 0;
+// the half holds data that was not played yet, and how much came from the file
+static volatile uint8_t block_ready[2];
+static uint32_t block_bytes[2];
+// the DSP finished a half before the other one was refilled
+static volatile uint8_t stalled = 0;
+// halves the refill task has to read
+static volatile uint8_t refill_mask = 0;
+// changed by play_music and stop, a refill of an older playback is dropped
+static volatile uint32_t audio_generation = 0;
+static uint32_t underrun_count = 0;
+static wait_queue_t refill_wait = {NULL};
+static pcb_t* refill_task = NULL;
+
+/* the refill task, reads the file ahead of the DSP */
+static void audio_refill(uint32_t data);
+/* read the file at offset into a half, padded with silence, return the bytes read */
+static uint32_t fill_block(uint32_t half, uint32_t offset);
+/* play the half play_block, or stop at the end of the file */
+static void play_block_start();
+
 void DSP_outb(uint8_t data, uint8_t port_offset){
     outb(data, SB16_IOBase + port_offset);
 }
@@ -227,12 +257,19 @@ int8_t play_music(int8_t* filename){
 
     int32_t fd = open((uint8_t*)filename);
     _fd = fd;
-    uint32_t bytes_read = read_data(audio_file_inode,current_offset, (uint8_t*)DMA_Buffer, BLOCK_SIZE*2);
+    audio_generation++;
+    block_bytes[0] = fill_block(0, current_offset);
+    current_offset += block_bytes[0];
+    block_bytes[1] = fill_block(1, current_offset);
+    current_offset += block_bytes[1];
+    block_ready[0] = block_ready[1] = 1;
+    play_block = 0;
+    stalled = 0;
+    refill_mask = 0;
     Transfer_Sound_DMA(1, 0x48 | 0x10, (uint32_t)(&DMA_Buffer[0]), sizeof(DMA_Buffer));
     Set_Sample_Rate(8000);
     start_play(BLOCK_SIZE);
     is_playing = 1;
-    current_offset += bytes_read;
 
     return 0;
 }
@@ -259,36 +296,122 @@ void stop(){
     is_playing = 0;
     audio_file_inode = 0;
     current_offset = 0;
-    cur_block = block1;
+    play_block = 0;
+    stalled = 0;
+    refill_mask = 0;
+    audio_generation++;
     for(i = 0; i < 33; i ++){
         audio_filename[i] = 0;
     }
 }
 
+/* void sb16_init()
+ * Inputs: none
+ * Return Value: none
+ * Function: start the refill task, after sched_init and init_process
+ */
+void sb16_init(){
+    refill_task = kthread_create((int8_t*)"audio", audio_refill, 0, SCHED_FIFO);
+}
+
+/* void sb16_handler()
+ * Inputs: none
+ * Return Value: none
+ * Function: at the end of a half, start the other one and hand the one
+ *           that finished to the refill task
+ */
 void sb16_handler(){
-    //printf("interrupt works\n");
-    DSP_inb(0xE);
-    send_eoi(5);
-    cli();
-    //printf("Offset: %d\n", current_offset);
-    uint32_t bytes_read = read_data(audio_file_inode, current_offset, (uint8_t*)cur_block, BLOCK_SIZE);
-    current_offset += bytes_read;
-    //printf("Bytes: %d\n", bytes_read);
-    //printf("Offset: %d\n", current_offset);
-    sti();
-
-    if(bytes_read == BLOCK_SIZE){
-        uint16_t blksize = (uint16_t) bytes_read;
-        if(cur_block == block1){
-            cur_block = block2;
+    DSP_inb(DSP_Read_Buffer_Status);
+    send_eoi(SB16_IRQ);
+    if(is_playing == 0){
+        return;
+    }
+
+    block_ready[play_block] = 0;
+    refill_mask |= 1 << play_block;
+    play_block ^= 1;
+    if(block_ready[play_block]){
+        play_block_start();
+    }else{
+        // the refill fell behind, the DSP waits for it
+        underrun_count++;
+        stalled = 1;
+    }
+    wake_up(&refill_wait);
+}
+
+/* uint32_t sb16_underruns()
+ * Inputs: none
+ * Return Value: number of times the DSP had to wait for the refill
+ * Function: tell whether playback was glitch free since boot
+ */
+uint32_t sb16_underruns(){
+    return underrun_count;
+}
+
+/* uint32_t sb16_buffer_size()
+ * Inputs: none
+ * Return Value: size of DMA_Buffer in bytes
+ * Function: report the memory the driver keeps for dma, used by meminfo
+ */
+uint32_t sb16_buffer_size(){
+    return sizeof(DMA_Buffer);
+}
+
+static void audio_refill(uint32_t data){
+    uint32_t flags;
+    uint32_t half;
+    uint32_t offset;
+    uint32_t generation;
+    uint32_t bytes;
+
+    while(1){
+        cli_and_save(flags);
+        while(refill_mask == 0){
+            sleep_on(&refill_wait);
+        }
+        // a stalled DSP waits for its own half, that part of the file comes first
+        if(stalled || !(refill_mask & (1 << (play_block ^ 1)))){
+            half = play_block;
         }else{
-            cur_block = block1;
+            half = play_block ^ 1;
         }
-        start_play(blksize);
-    }else if(bytes_read == 0){
-        stop();
+        refill_mask &= ~(1 << half);
+        offset = current_offset;
+        generation = audio_generation;
+        restore_flags(flags);
+
+        // at most one half per pass, with interrupts enabled
+        bytes = fill_block(half, offset);
+
+        cli_and_save(flags);
+        if(generation == audio_generation && is_playing){
+            current_offset = offset + bytes;
+            block_bytes[half] = bytes;
+            block_ready[half] = 1;
+            if(stalled && half == play_block){
+                stalled = 0;
+                play_block_start();
+            }
+        }
+        restore_flags(flags);
     }
-    //printf("interrupt works");
-    return;
 }
 
+static uint32_t fill_block(uint32_t half, uint32_t offset){
+    int32_t bytes = read_data(audio_file_inode, offset, (uint8_t*)blocks[half], BLOCK_SIZE);
+
+    if(bytes < 0){
+        bytes = 0;
+    }
+    memset(blocks[half] + bytes, AUDIO_SILENCE, BLOCK_SIZE - bytes);
+    return bytes;
+}
+
+static void play_block_start(){
+    if(block_bytes[play_block] == 0){
+        stop();
+    }else{
+        start_play(BLOCK_SIZE);
+    }
+}
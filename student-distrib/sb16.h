@@ -56,9 +56,12 @@ int8_t Write_DSP(uint8_t data);
 uint8_t Read_From_DSP();
 int8_t Transfer_Sound_DMA(uint8_t channel, uint8_t mode, uint32_t addr, uint32_t size);
 int8_t Set_Sample_Rate(uint16_t frequency);
+void sb16_init();
 void sb16_handler();
+uint32_t sb16_underruns();
 int8_t play_music(int8_t* filename);
 void start_play(uint32_t block_size);
 void stop();
+uint32_t sb16_buffer_size();
 
 #endif
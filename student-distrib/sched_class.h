@@ -0,0 +1,52 @@
+#ifndef SCHED_CLASS_H
+#define SCHED_CLASS_H
+
+#include "types.h"
+
+/*
+ * A scheduling class is the policy half of the scheduler: which runnable
+ * task gets the cpu and for how long. scheduling.c keeps the mechanism
+ * (context switch, wait queues, the idle loop) and calls the class with
+ * interrupts disabled. The class is chosen once at boot with "sched=rr",
+ * "sched=prio" or "sched=fair" on the command line; without one the
+ * goodness class runs. Tasks with the SCHED_FIFO policy belong to the real
+ * time class instead, which runs before the class chosen at boot.
+ */
+typedef struct sched_class {
+    const int8_t* name;
+    /* a new task is about to be woken for the first time */
+    void (*task_new)(pcb_t* pcb);
+    /* the task became runnable */
+    void (*enqueue)(pcb_t* pcb);
+    /* the task is no longer runnable, or its nice value is about to change */
+    void (*dequeue)(pcb_t* pcb);
+    /* the runnable task to run next, NULL if there is none; curr is the
+     * task on the cpu, NULL for idle, and still queued if runnable */
+    pcb_t* (*pick_next)(pcb_t* curr);
+    /* a timer tick hit curr */
+    void (*tick)(pcb_t* curr);
+    /* curr gives up the rest of its slice */
+    void (*yield)(pcb_t* curr);
+    /* whether the woken task should take the cpu from curr right away */
+    int32_t (*preempt)(pcb_t* woken, pcb_t* curr);
+} sched_class_t;
+
+// plain round robin, every runnable task one tick in turn
+extern sched_class_t sched_rr_class;
+// static priority, the lowest nice runs, round robin among equals
+extern sched_class_t sched_prio_class;
+// fair share, the least virtual runtime runs, weighted by nice
+extern sched_class_t sched_fair_class;
+// tick credits with boosts for the shown terminal and the keyboard
+extern sched_class_t sched_goodness_class;
+// first in first out real time, above every other class
+extern sched_class_t sched_rt_class;
+
+/* link a task at the tail of a circular run list */
+extern void run_list_add(pcb_t** head, pcb_t* pcb);
+/* unlink a task from a circular run list */
+extern void run_list_remove(pcb_t** head, pcb_t* pcb);
+/* where a scan of a run list starts, the task after curr so equal tasks take turns */
+extern pcb_t* run_list_start(pcb_t* head, pcb_t* curr);
+
+#endif
@@ -0,0 +1,104 @@
+#include "scheduling.h"
+
+#define FAIR_NICE_0_WEIGHT  1024
+#define FAIR_TICK_RUNTIME   1024            // virtual runtime of a tick at nice 0
+#define FAIR_WAKEUP_GRAN    FAIR_TICK_RUNTIME
+#define FAIR_SLEEPER_CREDIT (2 * FAIR_TICK_RUNTIME)
+
+/*
+ * Fair share: every task has a virtual runtime that grows with each tick
+ * it runs, slower for a lower nice, and the runnable task with the least
+ * runs. Over time each task gets cpu in proportion to its weight, about
+ * 1.25 times more per nice level. A task that slept comes back at most
+ * FAIR_SLEEPER_CREDIT behind the least runtime in the queue, so sleeping
+ * buys a quick wakeup but not a monopoly.
+ */
+static pcb_t* fair_head = NULL;
+// never goes backwards, new and woken tasks are placed relative to it
+static uint64_t min_vruntime = 0;
+
+// weight of each nice value from NICE_MIN to NICE_MAX
+static const uint32_t fair_weights[NICE_MAX - NICE_MIN + 1] = {
+    9548, 7620, 6100, 4904, 3906, 3121, 2501, 1991, 1586, 1277,
+    1024, 820, 655, 526, 423, 335, 272, 215, 172, 137, 110
+};
+
+/* move min_vruntime up to the least vruntime of the runnable tasks */
+static void update_min_vruntime();
+
+static void fair_task_new(pcb_t* pcb) {
+    pcb->vruntime = min_vruntime;
+}
+
+static void fair_enqueue(pcb_t* pcb) {
+    // a sleeper does not come back with all the runtime it missed
+    if (min_vruntime > FAIR_SLEEPER_CREDIT && pcb->vruntime < min_vruntime - FAIR_SLEEPER_CREDIT)
+        pcb->vruntime = min_vruntime - FAIR_SLEEPER_CREDIT;
+    run_list_add(&fair_head, pcb);
+}
+
+static void fair_dequeue(pcb_t* pcb) {
+    run_list_remove(&fair_head, pcb);
+}
+
+static pcb_t* fair_pick_next(pcb_t* curr) {
+    pcb_t * start;
+    pcb_t * pcb;
+    pcb_t * best;
+
+    if (fair_head == NULL)
+        return NULL;
+
+    start = run_list_start(fair_head, curr);
+    best = start;
+    for (pcb = start->run_next; pcb != start; pcb = pcb->run_next) {
+        if (pcb->vruntime < best->vruntime)
+            best = pcb;
+    }
+    return best;
+}
+
+static void fair_tick(pcb_t* curr) {
+    curr->vruntime += FAIR_TICK_RUNTIME * FAIR_NICE_0_WEIGHT / fair_weights[curr->nice - NICE_MIN];
+    update_min_vruntime();
+}
+
+static void fair_yield(pcb_t* curr) {
+    pcb_t * pcb;
+
+    // go behind every other runnable task
+    for (pcb = curr->run_next; pcb != NULL && pcb != curr; pcb = pcb->run_next) {
+        if (pcb->vruntime >= curr->vruntime)
+            curr->vruntime = pcb->vruntime + 1;
+    }
+}
+
+static int32_t fair_preempt(pcb_t* woken, pcb_t* curr) {
+    return woken->vruntime + FAIR_WAKEUP_GRAN < curr->vruntime;
+}
+
+sched_class_t sched_fair_class = {
+    (const int8_t*)"fair",
+    fair_task_new,
+    fair_enqueue,
+    fair_dequeue,
+    fair_pick_next,
+    fair_tick,
+    fair_yield,
+    fair_preempt
+};
+
+static void update_min_vruntime() {
+    pcb_t * pcb = fair_head;
+    uint64_t least;
+
+    if (pcb == NULL)
+        return;
+    least = pcb->vruntime;
+    for (pcb = pcb->run_next; pcb != fair_head; pcb = pcb->run_next) {
+        if (pcb->vruntime < least)
+            least = pcb->vruntime;
+    }
+    if (least > min_vruntime)
+        min_vruntime = least;
+}
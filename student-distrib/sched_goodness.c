@@ -0,0 +1,125 @@
+#include "scheduling.h"
+
+/*
+ * Every task holds a counter of timer ticks, refilled for all tasks once
+ * no runnable one has ticks left, and the runnable task with the best
+ * goodness gets the cpu. A task with a better nice gets a longer slice
+ * and is preferred while it has ticks, but once it used them the others
+ * run, so nobody starves. Tasks of the shown terminal get twice the slice
+ * and go first, and a task woken by the keyboard preempts whatever runs.
+ * A blocked task keeps half its unused ticks at a refill, so a shell that
+ * mostly waits for input always has ticks to run with.
+ */
+#define NICE_SLICE_STEP 5               // nice levels per tick of slice
+#define FG_BOOST        20              // goodness of a task of the shown terminal
+#define WAKE_BOOST      40              // goodness of a task the keyboard woke
+
+static pcb_t* goodness_head = NULL;
+
+/* how much a runnable task deserves the cpu, 0 once its slice is used */
+static int32_t goodness(pcb_t* pcb);
+/* ticks a task gets at every refill */
+static uint32_t slice_ticks(pcb_t* pcb);
+/* give every task a new slice, blocked ones keep half of what they saved */
+static void refill_slices();
+
+static void goodness_task_new(pcb_t* pcb) {
+    pcb->counter = slice_ticks(pcb);
+    pcb->boost = 0;
+}
+
+static void goodness_enqueue(pcb_t* pcb) {
+    run_list_add(&goodness_head, pcb);
+}
+
+static void goodness_dequeue(pcb_t* pcb) {
+    run_list_remove(&goodness_head, pcb);
+}
+
+static pcb_t* goodness_pick_next(pcb_t* curr) {
+    pcb_t * start;
+    pcb_t * pcb;
+    pcb_t * best = NULL;
+    int32_t best_weight = 0;
+    int32_t weight;
+
+    if (goodness_head == NULL)
+        return NULL;
+
+    start = run_list_start(goodness_head, curr);
+    while (1) {
+        pcb = start;
+        do {
+            weight = goodness(pcb);
+            if (best == NULL || weight > best_weight) {
+                best = pcb;
+                best_weight = weight;
+            }
+            pcb = pcb->run_next;
+        } while (pcb != start);
+
+        if (best_weight > 0)
+            return best;
+        // every runnable task used its slice
+        refill_slices();
+        best = NULL;
+    }
+}
+
+static void goodness_tick(pcb_t* curr) {
+    // the keyboard boost lasts until the task used a tick
+    curr->boost = 0;
+    if (curr->counter > 0)
+        curr->counter--;
+}
+
+static void goodness_yield(pcb_t* curr) {
+    curr->boost = 0;
+    curr->counter = 0;
+}
+
+static int32_t goodness_preempt(pcb_t* woken, pcb_t* curr) {
+    return goodness(woken) > goodness(curr);
+}
+
+sched_class_t sched_goodness_class = {
+    (const int8_t*)"goodness",
+    goodness_task_new,
+    goodness_enqueue,
+    goodness_dequeue,
+    goodness_pick_next,
+    goodness_tick,
+    goodness_yield,
+    goodness_preempt
+};
+
+static int32_t goodness(pcb_t* pcb) {
+    int32_t weight;
+
+    if (pcb->counter == 0)
+        return 0;
+    weight = pcb->counter + (NICE_MAX - pcb->nice);
+    if (pcb->terminal_id == current_terminal)
+        weight += FG_BOOST;
+    if (pcb->boost)
+        weight += WAKE_BOOST;
+    return weight;
+}
+
+static uint32_t slice_ticks(pcb_t* pcb) {
+    uint32_t ticks = 1 + (NICE_MAX - pcb->nice) / NICE_SLICE_STEP;
+
+    if (pcb->terminal_id == current_terminal)
+        ticks *= 2;
+    return ticks;
+}
+
+static void refill_slices() {
+    uint32_t pid;
+    pcb_t * pcb;
+
+    for (pid = 0; pid < max_task; pid++) {
+        if ((pcb = get_pcb_by_index(pid)) != NULL && pcb->state != TASK_DEAD)
+            pcb->counter = pcb->counter / 2 + slice_ticks(pcb);
+    }
+}
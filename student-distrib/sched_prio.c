@@ -0,0 +1,54 @@
+#include "scheduling.h"
+
+#define PRIO_LEVELS     (NICE_MAX - NICE_MIN + 1)
+
+/*
+ * Static priority: a run list per nice value. The first task of the list
+ * with the lowest nice runs, and a tick moves it behind the others of its
+ * list. A task only runs when no task with a lower nice is runnable, so a
+ * busy loop at a low nice starves everything above it.
+ */
+static pcb_t* prio_heads[PRIO_LEVELS];
+
+static void prio_task_new(pcb_t* pcb) {
+}
+
+static void prio_enqueue(pcb_t* pcb) {
+    run_list_add(&prio_heads[pcb->nice - NICE_MIN], pcb);
+}
+
+static void prio_dequeue(pcb_t* pcb) {
+    run_list_remove(&prio_heads[pcb->nice - NICE_MIN], pcb);
+}
+
+static pcb_t* prio_pick_next(pcb_t* curr) {
+    uint32_t i;
+
+    for (i = 0; i < PRIO_LEVELS; i++) {
+        if (prio_heads[i] != NULL)
+            return prio_heads[i];
+    }
+    return NULL;
+}
+
+static void prio_tick(pcb_t* curr) {
+    pcb_t ** head = &prio_heads[curr->nice - NICE_MIN];
+
+    if (curr == *head)
+        *head = curr->run_next;
+}
+
+static int32_t prio_preempt(pcb_t* woken, pcb_t* curr) {
+    return woken->nice < curr->nice;
+}
+
+sched_class_t sched_prio_class = {
+    (const int8_t*)"prio",
+    prio_task_new,
+    prio_enqueue,
+    prio_dequeue,
+    prio_pick_next,
+    prio_tick,
+    prio_tick,
+    prio_preempt
+};
@@ -0,0 +1,44 @@
+#include "scheduling.h"
+
+/*
+ * Round robin: one circular list, the head runs and every tick moves it
+ * behind the others. Nice values and boosts are ignored, a woken task
+ * waits for its turn.
+ */
+static pcb_t* rr_head = NULL;
+
+static void rr_task_new(pcb_t* pcb) {
+}
+
+static void rr_enqueue(pcb_t* pcb) {
+    run_list_add(&rr_head, pcb);
+}
+
+static void rr_dequeue(pcb_t* pcb) {
+    run_list_remove(&rr_head, pcb);
+}
+
+static pcb_t* rr_pick_next(pcb_t* curr) {
+    return rr_head;
+}
+
+static void rr_tick(pcb_t* curr) {
+    // the slice of the current task is over
+    if (curr == rr_head)
+        rr_head = rr_head->run_next;
+}
+
+static int32_t rr_preempt(pcb_t* woken, pcb_t* curr) {
+    return 0;
+}
+
+sched_class_t sched_rr_class = {
+    (const int8_t*)"rr",
+    rr_task_new,
+    rr_enqueue,
+    rr_dequeue,
+    rr_pick_next,
+    rr_tick,
+    rr_tick,
+    rr_preempt
+};
@@ -0,0 +1,49 @@
+#include "scheduling.h"
+
+/*
+ * Real time, first in first out: a runnable task of this class always
+ * runs before the tasks of the class picked at boot, and keeps the cpu
+ * until it blocks or yields, ticks do not take it away. Meant for kernel
+ * tasks that do a bounded amount of work per wakeup, like the audio
+ * refill; a task that never blocks starves everything else.
+ */
+static pcb_t* rt_head = NULL;
+
+static void rt_task_new(pcb_t* pcb) {
+}
+
+static void rt_enqueue(pcb_t* pcb) {
+    run_list_add(&rt_head, pcb);
+}
+
+static void rt_dequeue(pcb_t* pcb) {
+    run_list_remove(&rt_head, pcb);
+}
+
+static pcb_t* rt_pick_next(pcb_t* curr) {
+    return rt_head;
+}
+
+static void rt_tick(pcb_t* curr) {
+}
+
+static void rt_yield(pcb_t* curr) {
+    // behind the other real time tasks, if there are any
+    if (curr == rt_head)
+        rt_head = rt_head->run_next;
+}
+
+static int32_t rt_preempt(pcb_t* woken, pcb_t* curr) {
+    return 0;
+}
+
+sched_class_t sched_rt_class = {
+    (const int8_t*)"rt",
+    rt_task_new,
+    rt_enqueue,
+    rt_dequeue,
+    rt_pick_next,
+    rt_tick,
+    rt_yield,
+    rt_preempt
+};
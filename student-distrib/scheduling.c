@@ -1,113 +1,916 @@
 #include "scheduling.h"
-static uint8_t pending_interrupt = 0x3F;
+#include "syscall.h"
+#include "fpu.h"
+#include "cpu_group.h"
+#include "cpustat.h"
+#include "trace.h"
 
-/* void init_pit(uint32_t frequency)
+// the policy, picked at boot
+static sched_class_t* sched_class = &sched_goodness_class;
+static uint32_t run_count = 0;
+// the task on the cpu, NULL while the boot stack runs the idle loop
+static pcb_t* current_task = NULL;
+// saved esp of the idle loop while a task runs
+static uint32_t idle_esp = 0;
+// a woken task should take the cpu from the current one
+static uint32_t need_resched = 0;
+// preempt_count of the idle loop, a task has its own in its pcb
+static uint32_t idle_preempt_count = 0;
+// time stamp of the last switch, what ran since is charged at the next one
+static uint64_t switch_tsc = 0;
+// cycles of the idle loop, and switches since boot
+static uint64_t idle_tsc = 0;
+static uint32_t switch_count = 0;
+// the switch in progress, schedule_tail records what it cost
+static uint64_t switch_begin = 0;
+static uint32_t switch_mm = 0;
+
+/* timer callback of sleep, wakes the sleeping task */
+static void sleep_expire(uint32_t data);
+/* take a task out of the wait queue it sleeps on */
+static void wait_remove(pcb_t* pcb);
+/* install the program page, kernel stack and video mapping of the next task */
+static void switch_address_space(pcb_t* next);
+/* where a kernel task starts, the first switch to it returns here */
+static void kthread_entry(void (*func)(uint32_t), uint32_t data);
+/* charge the cycles since the last switch to prev, or to the idle loop */
+static void account_switch(pcb_t* prev);
+/* the preempt_disable nesting of the code on the cpu */
+static uint32_t* preempt_count();
+/* the scheduling class a task belongs to */
+static sched_class_t* task_class(pcb_t* pcb);
+/* whether a woken task should take the cpu from curr right away */
+static int32_t task_preempts(pcb_t* woken, pcb_t* curr);
+
+/* void sched_init()
  * --------------------------------------------------------------------------------------
- * Descriptions:    This function will initialize pit
- * Inputs:          uint32_t frequency :    The frequency you want
+ * Descriptions:    Pick the scheduling class named on the boot command line,
+ *                  "sched=rr", "sched=prio" or "sched=fair", the goodness
+ *                  class otherwise. Must run before the first task is woken.
+ * Inputs:          None
  * Outputs:         None
  * Side Effects:    None
  */
-void init_pit(uint32_t frequency) {
-    uint32_t divisor = PIT_CONST/frequency;
-    outb(PIT_MODE_3, PIT_REG);
-    outb(PIT_MASK & divisor, CHANNEL_0);
-    outb(divisor >> 8, CHANNEL_0);
-    enable_irq(PIT_IRQ);
+void sched_init() {
+    if (cmdline_has(boot_cmdline, (int8_t*)"sched=rr"))
+        sched_class = &sched_rr_class;
+    else if (cmdline_has(boot_cmdline, (int8_t*)"sched=prio"))
+        sched_class = &sched_prio_class;
+    else if (cmdline_has(boot_cmdline, (int8_t*)"sched=fair"))
+        sched_class = &sched_fair_class;
+    else
+        sched_class = &sched_goodness_class;
+}
+
+/* const int8_t* sched_class_name()
+ * Inputs: none
+ * Return Value: name of the scheduling class in use
+ * Function: tell which policy runs
+ */
+const int8_t* sched_class_name() {
+    return sched_class->name;
 }
 
 /* void pit_handler()
  * --------------------------------------------------------------------------------------
  * Descriptions:    When do the scheduling, it will
- *                      1. check if there are other terminals that are running
- *                      2. get the pid of next task from the process array
- *                      3. map virtual address 128 MB to coresponding physical address
- *                      4. map the video mem address of last task to its buffer
- *                      5. adjust tss, save old esp/ebp and restore new esp/ebp
+ *                      1. charge the tick to the current task
+ *                      2. switch to the task the scheduling class picks
+ *                  The pending signal of the task that got the cpu is
+ *                  delivered by the linkage if it returns to user mode.
+ *                  Every runnable process gets a slice, including background
+ *                  jobs and several processes of the same terminal. Code that
+ *                  disabled preemption, or an interrupt handler the tick came
+ *                  into, keeps the cpu: the switch waits for preempt_enable
+ *                  or irq_exit.
  * Inputs:          None
  * Outputs:         None
  * Side Effects:    Preform context switch, may slow down the system
  */
 void pit_handler() {
-
-    // Variables that needed
-    uint8_t i;                      // counter
-    uint8_t next_terminal;          // id of next terminal
-    uint8_t next_process;           // pid of next process
-    pcb_t * old_pcb;                // pointer to the old pcb
-    pcb_t * new_pcb;                // pointer to the new pcb
     send_eoi(PIT_IRQ);
+    timer_tick();
 
     // enter critical section
     cli();
-    //printf("current terminal: %d || running terminal: %d\n", current_terminal, running_terminal);
-    // check if other terminal is running, otherwise return
-    if(process_terminal_cnt[1] != 0 || process_terminal_cnt[2] != 0){
-
-        // look for next task
-        next_terminal = running_terminal;
-
-        for(i = 0; i < MAX_TERMINAL_NUM; i ++){
-            next_terminal = (running_terminal + 1 + i) % 3;
-            if(is_running(next_terminal) == 1){
-                break;
-            }
+
+    // sleepers whose time has come are runnable before the pick
+    timer_run();
+
+    trace_tick(current_task);
+    if (current_task != NULL)
+        task_class(current_task)->tick(current_task);
+    // a terminal that used its quota waits for the next period, its tasks
+    // that are still queued come off now
+    if (cpu_group_charge(current_task))
+        sched_throttle(current_task->terminal_id);
+    if (*preempt_count() != 0) {
+        need_resched = 1;
+        sti();
+        return;
+    }
+    schedule();
+
+    sti();
+    return;
+}
+
+/* void schedule()
+ * --------------------------------------------------------------------------------------
+ * Descriptions:    Switch to the task the scheduling class picks. With no
+ *                  runnable task, the cpu goes back to the idle loop on the
+ *                  boot stack. Returns when the calling task is picked again.
+ * Inputs:          None
+ * Outputs:         None
+ * Side Effects:    Changing tss, program page and video mapping
+ */
+void schedule() {
+    pcb_t * prev;
+    pcb_t * next;
+    uint32_t flags;
+
+    cli_and_save(flags);
+    prev = current_task;
+    // a runnable real time task goes first
+    next = sched_rt_class.pick_next(prev);
+    if (next == NULL)
+        next = sched_class->pick_next(prev != NULL && prev->policy == SCHED_NORMAL ? prev : NULL);
+    need_resched = 0;
+    if (next == prev) {
+        restore_flags(flags);
+        return;
+    }
+
+    account_switch(prev);
+    trace_switch(prev, next);
+
+    // the idle loop may have left the tick stopped or armed once
+    if (prev == NULL)
+        timer_resume();
+    switch_begin = timer_tsc();
+    switch_address_space(next);
+    switch_mm = (uint32_t)(timer_tsc() - switch_begin);
+    fpu_switch(next);
+    current_task = next;
+    context_switch(prev != NULL ? &prev->kernel_esp : &idle_esp,
+                   next != NULL ? next->kernel_esp : idle_esp);
+
+    // running again, possibly much later
+    schedule_tail();
+    restore_flags(flags);
+}
+
+/* void schedule_tail()
+ * Inputs: none
+ * Return Value: none
+ * Function: finish a context switch on the stack of the task switched to:
+ *           record what the switch cost, and free the kernel stack of a
+ *           halted task, which is not in use any more
+ */
+void schedule_tail() {
+    if (switch_begin != 0) {
+        switch_record((uint32_t)(timer_tsc() - switch_begin), switch_mm);
+        switch_begin = 0;
+    }
+    process_reap();
+}
+
+/* void sched_idle()
+ * --------------------------------------------------------------------------------------
+ * Descriptions:    The loop the boot stack runs when no task is runnable. It
+ *                  zeroes free frames, stops the timer tick and halts until
+ *                  an interrupt. A task woken by that interrupt gets the cpu
+ *                  right away instead of at the next timer tick, and the
+ *                  tick starts again before it runs. A sleeping task wakes
+ *                  when the timer armed for its deadline fires.
+ * Inputs:          None
+ * Outputs:         never returns
+ * Side Effects:    None
+ */
+void sched_idle() {
+    uint32_t zeroed;
+
+    while (1) {
+        // zero free frames while there is nothing else to do
+        do {
+            zeroed = frame_zeroed_count();
+            frame_zero_idle();
+        } while (run_count == 0 && frame_zeroed_count() > zeroed);
+
+        // sti only takes effect after hlt, so no wakeup slips in between
+        cli();
+        if (run_count == 0) {
+            // nobody needs a slice, the tick only has to come for the next timer
+            timer_idle(timer_next_deadline());
+            asm volatile ("sti; hlt");
+            cli();
+        }
+        schedule();
+        sti();
+    }
+}
+
+/* void sched_wake(pcb_t* pcb)
+ * --------------------------------------------------------------------------------------
+ * Descriptions:    Make a new or blocked task runnable. If it deserves the
+ *                  cpu more than the current task, the next tick or
+ *                  sched_preempt switches to it.
+ * Inputs:          pcb_t* pcb :    the task to wake
+ * Outputs:         None
+ * Side Effects:    Changing the run queue
+ */
+void sched_wake(pcb_t* pcb) {
+    uint32_t flags;
+
+    cli_and_save(flags);
+    if (pcb->state == TASK_NEW || pcb->state == TASK_BLOCKED) {
+        pcb->state = TASK_RUNNABLE;
+        trace_wake(pcb);
+        // runnable, but off the queue until its cpu group gets a new period
+        if (cpu_group_throttled(pcb)) {
+            pcb->throttled = 1;
+        } else {
+            task_class(pcb)->enqueue(pcb);
+            run_count++;
+            if (current_task == NULL || task_preempts(pcb, current_task))
+                need_resched = 1;
         }
-        next_process = process_terminal[next_terminal][process_terminal_cnt[next_terminal] - 1];
-        if(next_process > 5){
-            sti();
-            return;
+    }
+    restore_flags(flags);
+}
+
+/* void sched_block()
+ * --------------------------------------------------------------------------------------
+ * Descriptions:    Block the current task until sched_wake is called on it.
+ *                  The caller records what it waits for before blocking, with
+ *                  interrupts disabled, so the wakeup cannot be missed.
+ * Inputs:          None
+ * Outputs:         None
+ * Side Effects:    Changing the run queue
+ */
+void sched_block() {
+    uint32_t flags;
+
+    cli_and_save(flags);
+    if (current_task != NULL && current_task->state == TASK_RUNNABLE) {
+        current_task->state = TASK_BLOCKED;
+        if (current_task->throttled) {
+            current_task->throttled = 0;
+        } else {
+            task_class(current_task)->dequeue(current_task);
+            run_count--;
         }
-        //printf("%d\n", next_process);
-        // map the new task to its corresponding physical address
-        map_program(next_process);
-
-        // get new and old pcb
-        old_pcb = get_curr_pcb();
-        running_terminal = next_terminal;
-        new_pcb = get_pcb_by_index(next_process);
-        pending_interrupt = new_pcb->pending_signal;
-
-        // adjust tss
-        tss.ss0 = KERNEL_DS;
-        tss.esp0 = EIGHT_MB_SIZE - EIGHT_KB_SIZE * (next_process) - ESP_OFFSET;
-
-        // map the old process's videomem to its buffer
-        map_user_video_to_buffer(next_terminal);
-    
-        //printf("%x\n", (uint32_t)(saved_addr));
-        // save old process's esp and ebp, restore new process's esp and ebp
-        asm volatile(
-            "movl %%esp, %%eax;"
-            "movl %%ebp, %%ebx;"
-            : "=a" (old_pcb->schedule_esp), "=b" (old_pcb->schedule_ebp)
-        );
-
-        asm volatile(
-            "movl %%eax, %%esp;"
-            "movl %%ebx, %%ebp;"
-            : /* no outputs */
-            : "a" (new_pcb->schedule_esp), "b" (new_pcb->schedule_ebp)
-        );
-
-        if(pending_interrupt != 0x3F){
-            send_signal(pending_interrupt);
+    }
+    schedule();
+    restore_flags(flags);
+}
+
+/* void sched_exit()
+ * --------------------------------------------------------------------------------------
+ * Descriptions:    Remove the halting task from the run queue. It keeps the
+ *                  cpu until it calls schedule, which never returns to it.
+ * Inputs:          None
+ * Outputs:         None
+ * Side Effects:    Changing the run queue
+ */
+void sched_exit() {
+    uint32_t flags;
+
+    cli_and_save(flags);
+    if (current_task != NULL) {
+        if (current_task->throttled) {
+            current_task->throttled = 0;
+        } else if (current_task->state == TASK_RUNNABLE) {
+            task_class(current_task)->dequeue(current_task);
+            run_count--;
         }
+        current_task->state = TASK_DEAD;
+        fpu_exit(current_task);
+    }
+    restore_flags(flags);
+}
+
+/* void sched_throttle(uint32_t terminal)
+ * --------------------------------------------------------------------------------------
+ * Descriptions:    Take every runnable normal task of a terminal off the run
+ *                  queue once its cpu group used its quota. They stay
+ *                  TASK_RUNNABLE, marked throttled, so a block or an exit in
+ *                  the meantime needs no dequeue. If the current task is one
+ *                  of them, the cpu goes to another task at the next chance.
+ * Inputs:          uint32_t terminal : the terminal of the group
+ * Outputs:         None
+ * Side Effects:    Changing the run queue
+ */
+void sched_throttle(uint32_t terminal) {
+    pcb_t * pcb;
+    uint32_t i;
+    uint32_t flags;
+
+    cli_and_save(flags);
+    for (i = 0; i < max_task; i++) {
+        pcb = get_pcb_by_index(i);
+        if (pcb == NULL || pcb->terminal_id != terminal || pcb->state != TASK_RUNNABLE
+                || pcb->throttled || pcb->kthread || pcb->policy != SCHED_NORMAL)
+            continue;
+        task_class(pcb)->dequeue(pcb);
+        pcb->throttled = 1;
+        run_count--;
+        if (pcb == current_task)
+            need_resched = 1;
+    }
+    restore_flags(flags);
+}
+
+/* void sched_unthrottle(uint32_t terminal)
+ * --------------------------------------------------------------------------------------
+ * Descriptions:    Put the throttled tasks of a terminal back on the run
+ *                  queue, at the start of a new period or when its quota
+ *                  went up.
+ * Inputs:          uint32_t terminal : the terminal of the group
+ * Outputs:         None
+ * Side Effects:    Changing the run queue
+ */
+void sched_unthrottle(uint32_t terminal) {
+    pcb_t * pcb;
+    uint32_t i;
+    uint32_t flags;
+
+    cli_and_save(flags);
+    for (i = 0; i < max_task; i++) {
+        pcb = get_pcb_by_index(i);
+        if (pcb == NULL || pcb->terminal_id != terminal || !pcb->throttled)
+            continue;
+        pcb->throttled = 0;
+        task_class(pcb)->enqueue(pcb);
+        run_count++;
+        if (current_task == NULL || task_preempts(pcb, current_task))
+            need_resched = 1;
+    }
+    restore_flags(flags);
+}
+
+/* void sched_preempt()
+ * Inputs: none
+ * Return Value: none
+ * Function: switch right away if a better task woke, instead of at the next
+ *           tick, unless preemption is disabled
+ */
+void sched_preempt() {
+    uint32_t flags;
+
+    cli_and_save(flags);
+    // the idle loop schedules by itself once hlt returns
+    if (need_resched && *preempt_count() == 0 && current_task != NULL)
+        schedule();
+    restore_flags(flags);
+}
+
+/* void preempt_disable()
+ * Inputs: none
+ * Return Value: none
+ * Function: keep the current task on the cpu, interrupts still come in.
+ *           Calls nest. The task must not block before preempt_enable.
+ */
+void preempt_disable() {
+    uint32_t flags;
+
+    cli_and_save(flags);
+    (*preempt_count())++;
+    restore_flags(flags);
+}
+
+/* void preempt_enable()
+ * Inputs: none
+ * Return Value: none
+ * Function: undo preempt_disable, and switch if a tick or a wakeup asked
+ *           for it in the meantime
+ */
+void preempt_enable() {
+    preempt_enable_no_resched();
+    sched_preempt();
+}
+
+/* void preempt_enable_no_resched()
+ * Inputs: none
+ * Return Value: none
+ * Function: undo preempt_disable without switching, for a caller that
+ *           calls schedule itself
+ */
+void preempt_enable_no_resched() {
+    uint32_t flags;
+
+    cli_and_save(flags);
+    if (*preempt_count() > 0)
+        (*preempt_count())--;
+    restore_flags(flags);
+}
+
+/* uint32_t preemptible()
+ * Inputs: none
+ * Return Value: 1 if the current task may be switched away from, 0 otherwise
+ * Function: tell whether preemption is disabled
+ */
+uint32_t preemptible() {
+    return *preempt_count() == 0;
+}
+
+/* void irq_enter()
+ * Inputs: none
+ * Return Value: none
+ * Function: called by the interrupt linkage before a device handler. The
+ *           handler may enable interrupts, a tick that comes in then does
+ *           not switch tasks under it.
+ */
+void irq_enter() {
+    (*preempt_count())++;
+}
+
+/* void irq_exit()
+ * Inputs: none
+ * Return Value: none
+ * Function: called by the interrupt linkage after a device handler. The
+ *           reschedule check on the way out: a task the handler woke, the
+ *           work task included, or a tick that came in, gets the cpu
+ *           before the iret
+ */
+void irq_exit() {
+    (*preempt_count())--;
+    sched_preempt();
+}
+
+/* pcb_t* sched_current()
+ * Inputs: none
+ * Return Value: pcb of the task on the cpu, NULL for the idle loop
+ * Function: unlike get_curr_pcb, this is safe to call on the boot stack
+ */
+pcb_t* sched_current() {
+    return current_task;
+}
+
+/* uint64_t sched_runtime(pcb_t* pcb)
+ * Inputs: pcb -- a task
+ * Return Value: time stamp counter cycles the task spent on the cpu, 0
+ *               without a TSC
+ * Function: runtime for cpustat, counting the slice the task is in now
+ */
+uint64_t sched_runtime(pcb_t* pcb) {
+    uint64_t runtime;
+    uint32_t flags;
+
+    cli_and_save(flags);
+    runtime = pcb->runtime_tsc;
+    if (pcb == current_task && switch_tsc != 0)
+        runtime += timer_tsc() - switch_tsc;
+    restore_flags(flags);
+    return runtime;
+}
+
+/* uint64_t sched_idle_time()
+ * Inputs: none
+ * Return Value: time stamp counter cycles the idle loop had the cpu
+ * Function: the part of the uptime no task used
+ */
+uint64_t sched_idle_time() {
+    uint64_t idle;
+    uint32_t flags;
+
+    cli_and_save(flags);
+    idle = idle_tsc;
+    if (current_task == NULL && switch_tsc != 0)
+        idle += timer_tsc() - switch_tsc;
+    restore_flags(flags);
+    return idle;
+}
+
+/* uint32_t sched_switch_count()
+ * Inputs: none
+ * Return Value: context switches since boot, to and from the idle loop included
+ * Function: report how busy the scheduler is
+ */
+uint32_t sched_switch_count() {
+    return switch_count;
+}
+
+/* void syscall_account()
+ * Inputs: none
+ * Return Value: none
+ * Function: called by syscall_assembly for every system call with a valid
+ *           number, before it runs
+ */
+void syscall_account() {
+    if (current_task != NULL)
+        current_task->syscall_count++;
+}
+
+/* uint32_t sched_runnable_count()
+ * Inputs: none
+ * Return Value: number of tasks in the run queue
+ * Function: report how many tasks compete for the cpu
+ */
+uint32_t sched_runnable_count() {
+    return run_count;
+}
+
+/* void sched_prepare(pcb_t* pcb, uint32_t entry, uint32_t user_esp)
+ * --------------------------------------------------------------------------------------
+ * Descriptions:    Lay out the top of the kernel stack of a new task the way
+ *                  context_switch leaves a stopped one: callee-saved registers
+ *                  and a return address, here task_entry, followed by the
+ *                  iret frame into user mode
+ * Inputs:          pcb_t* pcb :        the new task
+ *                  uint32_t entry :    user eip of the first instruction
+ *                  uint32_t user_esp : user stack pointer
+ * Outputs:         None
+ * Side Effects:    Writes the kernel stack of the task
+ */
+void sched_prepare(pcb_t* pcb, uint32_t entry, uint32_t user_esp) {
+    uint32_t* sp = (uint32_t*)get_kernel_stack(pcb->pid);
+    uint32_t i;
+
+    // iret frame
+    *--sp = USER_DS;
+    *--sp = user_esp;
+    *--sp = EFLAGS_BASE | EFLAGS_IF;
+    *--sp = USER_CS;
+    *--sp = entry;
+
+    // context_switch frame: ebp, ebx, esi, edi
+    *--sp = (uint32_t)task_entry;
+    for (i = 0; i < 4; i++)
+        *--sp = 0;
+
+    pcb->kernel_esp = (uint32_t)sp;
+    task_class(pcb)->task_new(pcb);
+}
+
+/* pcb_t* kthread_create(const int8_t* name, void (*func)(uint32_t), uint32_t data, uint32_t policy)
+ * --------------------------------------------------------------------------------------
+ * Descriptions:    Start a task that runs func(data) in the kernel, on its
+ *                  own kernel stack, with interrupts enabled. It never goes
+ *                  to user mode and keeps the page directory of whatever
+ *                  ran before it, so it may only touch kernel memory. It
+ *                  blocks on wait queues like any task and is runnable
+ *                  when this returns. A kernel task has no pid and cannot
+ *                  be signaled; if func returns the task is gone for good
+ *                  and its stack goes back to the pool.
+ * Inputs:          const int8_t* name :    shown instead of a program name
+ *                  void (*func)(uint32_t): what the task runs
+ *                  uint32_t data :         argument of func
+ *                  uint32_t policy :       SCHED_NORMAL or SCHED_FIFO
+ * Outputs:         the pcb of the task, NULL if memory ran out
+ * Side Effects:    Changing the run queue
+ */
+pcb_t* kthread_create(const int8_t* name, void (*func)(uint32_t), uint32_t data, uint32_t policy) {
+    pcb_t * pcb;
+    uint32_t * sp;
+    uint32_t i;
+
+    if ((pcb = kthread_alloc()) == NULL)
+        return NULL;
+    pcb->pid = NO_PID;
+    pcb->parent_pid = NO_PID;
+    pcb->wait_pid = NO_PID;
+    pcb->pending_signal = NO_SIGNAL;
+    pcb->policy = policy;
+    strncpy((int8_t*)pcb->name, name, PROC_NAME_LEN - 1);
+
+    // the arguments of kthread_entry behind a return address it never uses
+    sp = (uint32_t*)((uint32_t)pcb + EIGHT_KB_SIZE - ESP_OFFSET);
+    *--sp = data;
+    *--sp = (uint32_t)func;
+    *--sp = 0;
+
+    // context_switch frame: ebp, ebx, esi, edi
+    *--sp = (uint32_t)kthread_entry;
+    for (i = 0; i < 4; i++)
+        *--sp = 0;
+
+    pcb->kernel_esp = (uint32_t)sp;
+    task_class(pcb)->task_new(pcb);
+    sched_wake(pcb);
+    return pcb;
+}
+
+/* int32_t sleep_on(wait_queue_t* wq)
+ * --------------------------------------------------------------------------------------
+ * Descriptions:    Block the current task on wq until wake_up is called on it.
+ *                  The caller tests its condition with interrupts disabled and
+ *                  sleeps in a loop, because a signal also wakes the task and
+ *                  several sleepers may race for one event.
+ * Inputs:          wait_queue_t* wq :  the queue to sleep on
+ * Outputs:         0 after a wakeup, -1 if a signal is pending
+ * Side Effects:    Gives the cpu away
+ */
+int32_t sleep_on(wait_queue_t* wq) {
+    pcb_t * pcb;
+    pcb_t ** link;
+    uint32_t flags;
+
+    cli_and_save(flags);
+    if ((pcb = current_task) == NULL) {
+        restore_flags(flags);
+        return -1;
+    }
+
+    // wake up in the order the tasks went to sleep
+    for (link = &wq->head; *link != NULL; link = &(*link)->wait_next);
+    *link = pcb;
+    pcb->wait_next = NULL;
+    pcb->wait_queue = wq;
+
+    sched_block();
+
+    // a signal wakes the task without taking it off the queue
+    wait_remove(pcb);
+    restore_flags(flags);
+    return signal_pending(pcb) ? -1 : 0;
+}
+
+/* void wake_up(wait_queue_t* wq)
+ * --------------------------------------------------------------------------------------
+ * Descriptions:    Put every task sleeping on wq back in the run queue. Safe
+ *                  to call from interrupt handlers.
+ * Inputs:          wait_queue_t* wq :  the queue to empty
+ * Outputs:         None
+ * Side Effects:    Changing the run queue
+ */
+void wake_up(wait_queue_t* wq) {
+    pcb_t * pcb;
+    uint32_t flags;
+
+    cli_and_save(flags);
+    while ((pcb = wq->head) != NULL) {
+        wq->head = pcb->wait_next;
+        pcb->wait_next = NULL;
+        pcb->wait_queue = NULL;
+        sched_wake(pcb);
+    }
+    restore_flags(flags);
+}
+
+/* void wake_up_interactive(wait_queue_t* wq)
+ * --------------------------------------------------------------------------------------
+ * Descriptions:    wake_up for the keyboard: the woken tasks get the cpu before
+ *                  anything else, and keep it for one tick at most
+ * Inputs:          wait_queue_t* wq :  the queue to empty
+ * Outputs:         None
+ * Side Effects:    Changing the run queue
+ */
+void wake_up_interactive(wait_queue_t* wq) {
+    pcb_t * pcb;
+    uint32_t flags;
 
-    }else{
-        if(process_terminal_cnt[0] == 0){
-            sti();
+    cli_and_save(flags);
+    for (pcb = wq->head; pcb != NULL; pcb = pcb->wait_next)
+        pcb->boost = 1;
+    wake_up(wq);
+    restore_flags(flags);
+}
+
+/*
+ * Function:  int32_t nice(int32_t increment)
+ * --------------------
+ * This function changes the priority of the calling process. A positive
+ * increment makes it nicer to the others; the scheduling class decides
+ * what that means, round robin ignores it. Children start with the nice
+ * of their parent.
+ *
+ *  Inputs:     int32_t increment: added to the nice value
+ *
+ *  Returns:    -1: the result is outside NICE_MIN to NICE_MAX
+ *              0: success
+ *
+ *  Side effects: none
+ *
+ */
+int32_t nice(int32_t increment) {
+    pcb_t * pcb = current_task;
+    uint32_t flags;
+
+    if (pcb == NULL || increment < NICE_MIN - NICE_MAX || increment > NICE_MAX - NICE_MIN)
+        return -1;
+    if (pcb->nice + increment < NICE_MIN || pcb->nice + increment > NICE_MAX)
+        return -1;
+
+    // a class may keep runnable tasks by nice value
+    cli_and_save(flags);
+    if (pcb->throttled) {
+        pcb->nice += increment;
+    } else {
+        task_class(pcb)->dequeue(pcb);
+        pcb->nice += increment;
+        task_class(pcb)->enqueue(pcb);
+    }
+    restore_flags(flags);
+    return 0;
+}
+
+/* void run_list_add(pcb_t** head, pcb_t* pcb)
+ * Inputs: head -- the list, NULL when empty
+ *         pcb -- the task to link in front of the head, which is the tail of the circle
+ * Return Value: none
+ * Function: queue helper for the scheduling classes
+ */
+void run_list_add(pcb_t** head, pcb_t* pcb) {
+    if (*head == NULL) {
+        pcb->run_next = pcb;
+        pcb->run_prev = pcb;
+        *head = pcb;
+    } else {
+        pcb->run_next = *head;
+        pcb->run_prev = (*head)->run_prev;
+        (*head)->run_prev->run_next = pcb;
+        (*head)->run_prev = pcb;
+    }
+}
+
+/* void run_list_remove(pcb_t** head, pcb_t* pcb)
+ * Inputs: head -- the list
+ *         pcb -- a task in the list
+ * Return Value: none
+ * Function: queue helper for the scheduling classes, the task after a
+ *           removed head becomes the head
+ */
+void run_list_remove(pcb_t** head, pcb_t* pcb) {
+    if (pcb->run_next == pcb) {
+        *head = NULL;
+    } else {
+        pcb->run_prev->run_next = pcb->run_next;
+        pcb->run_next->run_prev = pcb->run_prev;
+        if (*head == pcb)
+            *head = pcb->run_next;
+    }
+    pcb->run_next = NULL;
+    pcb->run_prev = NULL;
+}
+
+/* pcb_t* run_list_start(pcb_t* head, pcb_t* curr)
+ * Inputs: head -- a non-empty list
+ *         curr -- the task on the cpu, NULL for idle
+ * Return Value: the task after curr if curr is runnable, the head otherwise
+ * Function: where a class starts a scan, so tasks that tie take turns
+ */
+pcb_t* run_list_start(pcb_t* head, pcb_t* curr) {
+    if (curr != NULL && curr->state == TASK_RUNNABLE && curr->run_next != NULL)
+        return curr->run_next;
+    return head;
+}
+
+/*
+ * Function:  int32_t yield()
+ * --------------------
+ * This function gives up the rest of the slice of the calling process.
+ * It stays runnable and gets the cpu back once the scheduling class picks
+ * it again, at once if nothing else is runnable.
+ *
+ *  Inputs:     none
+ *
+ *  Returns:    0: success
+ *
+ *  Side effects: gives the cpu away
+ *
+ */
+int32_t yield() {
+    uint32_t flags;
+
+    cli_and_save(flags);
+    if (current_task != NULL) {
+        if (!current_task->throttled)
+            task_class(current_task)->yield(current_task);
+        schedule();
+    }
+    restore_flags(flags);
+    return 0;
+}
+
+/*
+ * Function:  int32_t sleep(uint32_t ms)
+ * --------------------
+ * This function blocks the calling process for ms milliseconds on the
+ * timer list. It uses no cpu while it waits, unlike a loop of rtc reads.
+ * The process wakes at the first tick after the deadline, or right at
+ * it when the cpu had nothing else to do.
+ *
+ *  Inputs:     uint32_t ms: time to sleep, 0 only yields
+ *
+ *  Returns:    -1: a signal cut the sleep short
+ *              0: success
+ *
+ *  Side effects: gives the cpu away
+ *
+ */
+int32_t sleep(uint32_t ms) {
+    ktimer_t timer;
+    pcb_t * pcb = current_task;
+    int32_t ret = 0;
+    uint32_t flags;
+
+    if (ms == 0)
+        return yield();
+    if (pcb == NULL)
+        return -1;
 
-            return;
+    cli_and_save(flags);
+    timer_add(&timer, timer_now_ms() + ms, sleep_expire, (uint32_t)pcb);
+    while (timer.pending) {
+        if (signal_pending(pcb)) {
+            ret = -1;
+            break;
         }
-        new_pcb = get_curr_pcb();
-        if(new_pcb->pending_signal != 0x3F){
-            send_signal(new_pcb->pending_signal);
-            new_pcb->pending_signal = 0x3F;
+        sched_block();
+        if (signal_pending(pcb)) {
+            ret = -1;
+            break;
         }
+    }
+    timer_del(&timer);
+    restore_flags(flags);
+    return ret;
+}
+
+static void sleep_expire(uint32_t data) {
+    sched_wake((pcb_t*)data);
+}
 
+static void wait_remove(pcb_t* pcb) {
+    pcb_t ** link;
+    wait_queue_t * wq = (wait_queue_t*)pcb->wait_queue;
+
+    if (wq == NULL)
+        return;
+    for (link = &wq->head; *link != NULL; link = &(*link)->wait_next) {
+        if (*link == pcb) {
+            *link = pcb->wait_next;
+            break;
+        }
     }
+    pcb->wait_next = NULL;
+    pcb->wait_queue = NULL;
+}
+
+static void switch_address_space(pcb_t* next) {
+    // the idle loop and kernel tasks only touch kernel memory
+    if (next == NULL || next->kthread)
+        return;
+
+    map_program(next->pid);
+    tss.ss0 = KERNEL_DS;
+    tss.esp0 = get_kernel_stack(next->pid);
+    running_terminal = next->terminal_id;
+    // a task of a hidden terminal writes to that terminal's buffer
+    map_user_video_to_buffer(next->terminal_id);
+}
+
+static void kthread_entry(void (*func)(uint32_t), uint32_t data) {
+    schedule_tail();
     sti();
+    func(data);
 
-    return;
+    cli();
+    // the stack we run on is freed after the switch, by process_reap
+    kthread_free(current_task);
+    sched_exit();
+    schedule();
+}
+
+static void account_switch(pcb_t* prev) {
+    uint64_t now = timer_tsc();
+
+    // a task that is still runnable was switched away from, as by a tick
+    // or a yield, one that blocked or halted gave the cpu up
+    if (prev != NULL) {
+        if (prev->state == TASK_RUNNABLE)
+            prev->nivcsw++;
+        else
+            prev->nvcsw++;
+    }
+    switch_count++;
+
+    if (switch_tsc != 0) {
+        if (prev != NULL)
+            prev->runtime_tsc += now - switch_tsc;
+        else
+            idle_tsc += now - switch_tsc;
+    }
+    switch_tsc = now;
+
+    // and its cpu group the part of the slice since the last tick
+    cpu_group_switch(prev);
+}
+
+// the count belongs to the task, one that blocks or halts with preemption
+// disabled does not leave it disabled for the task switched to
+static uint32_t* preempt_count() {
+    return current_task != NULL ? &current_task->preempt_count : &idle_preempt_count;
+}
+
+static sched_class_t* task_class(pcb_t* pcb) {
+    return pcb->policy == SCHED_FIFO ? &sched_rt_class : sched_class;
+}
+
+static int32_t task_preempts(pcb_t* woken, pcb_t* curr) {
+    // real time beats the rest, and the rest never beats real time
+    if (woken->policy != curr->policy)
+        return woken->policy == SCHED_FIFO;
+    return task_class(woken)->preempt(woken, curr);
 }
@@ -6,16 +6,104 @@
 #include "terminal.h"
 #include "paging.h"
 #include "lib.h"
+#include "process.h"
+#include "x86_desc.h"
+#include "timer.h"
+#include "sched_class.h"
 
-#define PIT_IRQ     0
-#define PIT_CONST   1193182
-#define PIT_REG     0x43
-#define PIT_MODE_3  0x36
-#define CHANNEL_0   0x40
-#define PIT_MASK
+// task states, a new pcb is TASK_NEW until it is first woken
+#define TASK_NEW        0
+#define TASK_RUNNABLE   1               // in the run queue, maybe on the cpu
+#define TASK_BLOCKED    2               // waiting, only a wakeup puts it back
+#define TASK_DEAD       3               // halted, its kernel stack is about to go
 
+#define NO_PID          0xFFFFFFFF
+#define NO_SIGNAL       0x3F
+#define EFLAGS_IF       0x200
+#define EFLAGS_BASE     0x2             // bit 1 of eflags is always set
 
-extern void init_pit();
+// scheduling policies, SCHED_FIFO tasks run in the real time class
+#define SCHED_NORMAL    0
+#define SCHED_FIFO      1
+
+// nice values, a lower one asks for more cpu
+#define NICE_MIN        (-10)
+#define NICE_MAX        10
+
+// tasks blocked until an interrupt or another task calls wake_up
+typedef struct {
+    pcb_t* head;
+} wait_queue_t;
+
+/* pick the scheduling class from the boot command line */
+extern void sched_init();
+/* name of the scheduling class in use */
+extern const int8_t* sched_class_name();
 extern void pit_handler();
 
+/* give the cpu to the task the scheduling class picks, or to idle */
+extern void schedule();
+/* the idle loop of the boot stack */
+extern void sched_idle();
+/* make a new or blocked task runnable */
+extern void sched_wake(pcb_t* pcb);
+/* take the current task off the run queue and run something else */
+extern void sched_block();
+/* take the current task off the run queue for good, the caller then calls schedule */
+extern void sched_exit();
+/* take the runnable tasks of a terminal off the run queue, its cpu group is out of quota */
+extern void sched_throttle(uint32_t terminal);
+/* put the throttled tasks of a terminal back on the run queue */
+extern void sched_unthrottle(uint32_t terminal);
+/* the task on the cpu, NULL while idle runs */
+extern pcb_t* sched_current();
+/* switch now if a task better than the current one woke and preemption is enabled */
+extern void sched_preempt();
+/* keep the current task on the cpu until preempt_enable, calls nest */
+extern void preempt_disable();
+/* allow preemption again and switch if it was asked for meanwhile */
+extern void preempt_enable();
+/* allow preemption again, the caller schedules itself */
+extern void preempt_enable_no_resched();
+/* 1 unless preemption is disabled */
+extern uint32_t preemptible();
+/* around the device interrupt handlers, irq_exit reschedules on the way out */
+extern void irq_enter();
+extern void irq_exit();
+/* cycles pcb ran, the current slice included */
+extern uint64_t sched_runtime(pcb_t* pcb);
+/* cycles the cpu spent in the idle loop */
+extern uint64_t sched_idle_time();
+/* number of context switches since boot */
+extern uint32_t sched_switch_count();
+/* count a system call of the current task, called by the syscall linkage */
+extern void syscall_account();
+/* number of tasks in the run queue */
+extern uint32_t sched_runnable_count();
+/* build the first kernel stack frame of a task so that it enters user mode at entry */
+extern void sched_prepare(pcb_t* pcb, uint32_t entry, uint32_t user_esp);
+/* work left after a context switch, run by the task that was switched to */
+extern void schedule_tail();
+/* start a kernel task that runs func(data) with the given policy, NULL if memory ran out */
+extern pcb_t* kthread_create(const int8_t* name, void (*func)(uint32_t), uint32_t data, uint32_t policy);
+
+/* block the current task on a wait queue, -1 if it woke up with a signal pending */
+extern int32_t sleep_on(wait_queue_t* wq);
+/* make every task of a wait queue runnable */
+extern void wake_up(wait_queue_t* wq);
+/* wake_up for input the user is waiting on, the tasks run before anything else */
+extern void wake_up_interactive(wait_queue_t* wq);
+
+/* system call: add increment to the nice value of the caller */
+extern int32_t nice(int32_t increment);
+/* system call: give up the rest of the slice */
+extern int32_t yield();
+/* system call: block for ms milliseconds */
+extern int32_t sleep(uint32_t ms);
+
+/* save callee-saved registers and esp into *old_esp, then resume the stack new_esp */
+extern void context_switch(uint32_t* old_esp, uint32_t new_esp);
+/* where a new task starts: finish the switch and iret to user mode */
+extern void task_entry();
+
 #endif
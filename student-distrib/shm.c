@@ -0,0 +1,382 @@
+#include "shm.h"
+#include "scheduling.h"
+
+static shm_segment_t shm_segments[SHM_MAX_SEGMENTS];
+// tasks blocked in shm_wait, hashed by the physical address of their word
+static wait_queue_t shm_waiters[SHM_WAIT_BUCKETS];
+
+/* the segment of key, or -1 with the first free slot in *free_id */
+static int32_t shm_lookup(uint32_t key, int32_t* free_id);
+/* free the frames of a segment and give its slot back, with interrupts disabled */
+static void shm_destroy(int32_t shmid);
+/* unmap one attachment of a process and drop the segment reference, with interrupts disabled */
+static void shm_detach(pcb_t* pcb, uint32_t slot);
+/* the wait queue of a word in the shared memory window of pcb and its physical address, NULL if it is not mapped */
+static wait_queue_t* shm_wait_queue(pcb_t* pcb, uint32_t vaddr, uint32_t** word);
+
+/*
+ * Function:  int32_t shmget(uint32_t key, uint32_t size)
+ * --------------------
+ * This function returns the segment that belongs to key. If no program
+ * created that segment yet, a new one of size bytes is allocated and
+ * filled with zeros.
+ *
+ *  Inputs:     uint32_t key: the name both programs agree on
+ *              uint32_t size: size of the segment in bytes
+ *
+ *  Returns:    -1: failed
+ *              id: the segment id to be passed to shmat
+ *
+ *  Side effects: allocates physical frames
+ *
+ */
+int32_t shmget(uint32_t key, uint32_t size) {
+    int32_t shmid;
+    int32_t free_id;
+    uint32_t j;
+    uint32_t num_pages;
+    uint32_t frames[SHM_MAX_PAGES];
+    uint32_t flags;
+    shm_segment_t* seg;
+
+    num_pages = (size + FOUR_KB_SIZE - 1) / FOUR_KB_SIZE;
+    if (num_pages == 0 || num_pages > SHM_MAX_PAGES)
+        return -1;
+
+    cli_and_save(flags);
+    shmid = shm_lookup(key, &free_id);
+    restore_flags(flags);
+    if (shmid != -1)
+        return shm_segments[shmid].num_pages < num_pages ? -1 : shmid;
+    if (free_id == -1)
+        return -1;
+
+    // fill the frames before the segment can be seen by anyone
+    for (j = 0; j < num_pages; j++) {
+        if ((frames[j] = frame_alloc_zeroed()) == 0) {
+            while (j-- > 0)
+                frame_put(frames[j]);
+            return -1;
+        }
+    }
+
+    // another process may have created the key or taken the slot meanwhile
+    cli_and_save(flags);
+    if ((shmid = shm_lookup(key, &free_id)) == -1 && free_id != -1) {
+        seg = &shm_segments[free_id];
+        for (j = 0; j < num_pages; j++)
+            seg->frames[j] = frames[j];
+        seg->key = key;
+        seg->num_pages = num_pages;
+        seg->attach_cnt = 0;
+        // the boot stack has no pcb, a segment made there has no owner
+        seg->owner_pid = sched_current() != NULL ? get_curr_proc()->pid : SHM_NO_OWNER;
+        seg->in_use = 1;
+        mem_charge(MEM_SHM, num_pages);
+        restore_flags(flags);
+        return free_id;
+    }
+    restore_flags(flags);
+
+    for (j = 0; j < num_pages; j++)
+        frame_put(frames[j]);
+    if (shmid != -1 && shm_segments[shmid].num_pages >= num_pages)
+        return shmid;
+    return -1;
+}
+
+/*
+ * Function:  int32_t shmat(int32_t shmid, void* addr)
+ * --------------------
+ * This function maps every page of a segment into the shared memory
+ * window of the calling process, starting at addr.
+ *
+ *  Inputs:     int32_t shmid: segment id returned by shmget
+ *              void* addr: 4KB aligned address inside the window
+ *
+ *  Returns:    -1: failed
+ *              addr: the segment is mapped there
+ *
+ *  Side effects: change the page table of the process
+ *
+ */
+int32_t shmat(int32_t shmid, void* addr) {
+    return shm_attach(get_curr_proc(), shmid, (uint32_t)addr);
+}
+
+/* int32_t shm_attach(pcb_t* pcb, int32_t shmid, uint32_t vaddr)
+ * Inputs: pcb -- the process that maps the segment
+ *         shmid -- segment id returned by shmget
+ *         vaddr -- 4KB aligned address inside the window
+ * Return Value: -1 on failure, vaddr on success
+ * Function: the work of shmat for any process
+ */
+int32_t shm_attach(pcb_t* pcb, int32_t shmid, uint32_t vaddr) {
+    uint32_t i;
+    uint32_t slot;
+    uint32_t flags;
+    shm_segment_t* seg;
+
+    if (shmid < 0 || shmid >= SHM_MAX_SEGMENTS)
+        return -1;
+    seg = &shm_segments[shmid];
+
+    // the last detach of another process may free the segment, and a
+    // thread of this one may take the slot or the window under us
+    cli_and_save(flags);
+
+    // the whole segment has to fit in the window
+    if (seg->in_use == 0 || (vaddr & (FOUR_KB_SIZE - 1)) != 0 || vaddr < SHM_VIRTUAL
+            || vaddr >= SHM_VIRTUAL_END || seg->num_pages * FOUR_KB_SIZE > SHM_VIRTUAL_END - vaddr) {
+        restore_flags(flags);
+        return -1;
+    }
+
+    for (slot = 0; slot < SHM_MAX_ATTACH; slot++) {
+        if (pcb->shm[slot].shmid == -1)
+            break;
+    }
+    if (slot == SHM_MAX_ATTACH) {
+        restore_flags(flags);
+        return -1;
+    }
+
+    // do not overlap a segment that is already attached
+    for (i = 0; i < seg->num_pages; i++) {
+        if (shm_page_present(pcb->pid, vaddr + i * FOUR_KB_SIZE)) {
+            restore_flags(flags);
+            return -1;
+        }
+    }
+
+    for (i = 0; i < seg->num_pages; i++)
+        map_shm_page(pcb->pid, vaddr + i * FOUR_KB_SIZE, seg->frames[i]);
+
+    pcb->shm[slot].shmid = shmid;
+    pcb->shm[slot].vaddr = vaddr;
+    seg->attach_cnt++;
+    seg->owner_pid = SHM_NO_OWNER;
+    restore_flags(flags);
+
+    return (int32_t)vaddr;
+}
+
+/*
+ * Function:  int32_t shm_wait(uint32_t* addr, uint32_t val)
+ * --------------------
+ * This function blocks the calling process as long as the word at addr,
+ * in a shared memory segment, holds val. Two processes that map the
+ * segment at different addresses still meet on the same word. The test
+ * and the sleep are atomic against shm_wake, so no wakeup is missed, but
+ * the process may also wake for another word: the caller checks its
+ * condition again in a loop.
+ *
+ *  Inputs:     uint32_t* addr: 4 byte aligned, in the shared memory window
+ *              uint32_t val: the value to wait on
+ *
+ *  Returns:    -1: addr is not in an attached segment, or a signal came
+ *              0: woken, or the word did not hold val
+ *
+ *  Side effects: may give the cpu away
+ *
+ */
+int32_t shm_wait(uint32_t* addr, uint32_t val) {
+    return shm_wait_addr(get_curr_proc(), (uint32_t)addr, val);
+}
+
+/* int32_t shm_wait_addr(pcb_t* pcb, uint32_t vaddr, uint32_t val)
+ * Inputs: pcb -- the process whose window holds the word
+ *         vaddr -- address of the word in that window
+ *         val -- the value to wait on
+ * Return Value: -1 if the word is not mapped or a signal came, 0 otherwise
+ * Function: the work of shm_wait for any process, the word is read
+ *           through its frame
+ */
+int32_t shm_wait_addr(pcb_t* pcb, uint32_t vaddr, uint32_t val) {
+    wait_queue_t * wq;
+    uint32_t * word;
+    int32_t ret = -1;
+    uint32_t flags;
+
+    // a thread of the process may detach the page under us
+    cli_and_save(flags);
+    if ((wq = shm_wait_queue(pcb, vaddr, &word)) != NULL) {
+        ret = 0;
+        if (*word == val)
+            ret = signal_pending(get_curr_pcb()) ? -1 : sleep_on(wq);
+    }
+    restore_flags(flags);
+    return ret;
+}
+
+/*
+ * Function:  int32_t shm_wake(uint32_t* addr)
+ * --------------------
+ * This function wakes the processes blocked in shm_wait on the word at
+ * addr, whatever address they mapped it at. The caller changes the word
+ * first.
+ *
+ *  Inputs:     uint32_t* addr: 4 byte aligned, in the shared memory window
+ *
+ *  Returns:    -1: addr is not in an attached segment
+ *              0: success
+ *
+ *  Side effects: may make other processes runnable
+ *
+ */
+int32_t shm_wake(uint32_t* addr) {
+    return shm_wake_addr(get_curr_proc(), (uint32_t)addr);
+}
+
+/* int32_t shm_wake_addr(pcb_t* pcb, uint32_t vaddr)
+ * Inputs: pcb -- the process whose window holds the word
+ *         vaddr -- address of the word in that window
+ * Return Value: -1 if the word is not mapped, 0 on success
+ * Function: the work of shm_wake for any process
+ */
+int32_t shm_wake_addr(pcb_t* pcb, uint32_t vaddr) {
+    wait_queue_t * wq;
+    uint32_t * word;
+
+    if ((wq = shm_wait_queue(pcb, vaddr, &word)) == NULL)
+        return -1;
+    wake_up(wq);
+    // a woken process that deserves the cpu more gets it now, not at the next tick
+    sched_preempt();
+    return 0;
+}
+
+/*
+ * Function:  int32_t shmdt(void* addr)
+ * --------------------
+ * This function unmaps the segment attached at addr. The segment is
+ * freed once the last process detaches it.
+ *
+ *  Inputs:     void* addr: the address returned by shmat
+ *
+ *  Returns:    -1: failed
+ *              0: success
+ *
+ *  Side effects: change the page table of the process
+ *
+ */
+int32_t shmdt(void* addr) {
+    return shm_detach_addr(get_curr_proc(), (uint32_t)addr);
+}
+
+/* int32_t shm_detach_addr(pcb_t* pcb, uint32_t vaddr)
+ * Inputs: pcb -- the process that unmaps the segment
+ *         vaddr -- the address returned by shm_attach
+ * Return Value: -1 on failure, 0 on success
+ * Function: the work of shmdt for any process
+ */
+int32_t shm_detach_addr(pcb_t* pcb, uint32_t vaddr) {
+    uint32_t slot;
+    uint32_t flags;
+
+    // a thread of the process may detach the same slot
+    cli_and_save(flags);
+    for (slot = 0; slot < SHM_MAX_ATTACH; slot++) {
+        if (pcb->shm[slot].shmid != -1 && pcb->shm[slot].vaddr == vaddr) {
+            shm_detach(pcb, slot);
+            restore_flags(flags);
+            return 0;
+        }
+    }
+    restore_flags(flags);
+    return -1;
+}
+
+/* void shm_init_pcb(pcb_t* pcb)
+ * Inputs: pcb -- the new process
+ * Return Value: none
+ * Function: mark every attach slot unused and empty the window
+ */
+void shm_init_pcb(pcb_t* pcb) {
+    uint32_t slot;
+    for (slot = 0; slot < SHM_MAX_ATTACH; slot++)
+        pcb->shm[slot].shmid = -1;
+    clear_shm_table(pcb->pid);
+}
+
+/* void shm_release(pcb_t* pcb)
+ * Inputs: pcb -- the halting process
+ * Return Value: none
+ * Function: detach all segments of the process and free the segments it
+ *           created that nobody attached
+ */
+void shm_release(pcb_t* pcb) {
+    uint32_t slot;
+    int32_t i;
+    uint32_t flags;
+
+    cli_and_save(flags);
+    for (slot = 0; slot < SHM_MAX_ATTACH; slot++) {
+        if (pcb->shm[slot].shmid != -1)
+            shm_detach(pcb, slot);
+    }
+
+    // another process may attach the segment until it is gone
+    for (i = 0; i < SHM_MAX_SEGMENTS; i++) {
+        if (shm_segments[i].in_use && shm_segments[i].owner_pid == pcb->pid)
+            shm_destroy(i);
+    }
+    restore_flags(flags);
+}
+
+static int32_t shm_lookup(uint32_t key, int32_t* free_id) {
+    int32_t i;
+
+    *free_id = -1;
+    for (i = 0; i < SHM_MAX_SEGMENTS; i++) {
+        if (shm_segments[i].in_use == 0) {
+            if (*free_id == -1)
+                *free_id = i;
+        } else if (shm_segments[i].key == key) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void shm_detach(pcb_t* pcb, uint32_t slot) {
+    uint32_t i;
+    int32_t shmid = pcb->shm[slot].shmid;
+    shm_segment_t* seg = &shm_segments[shmid];
+
+    for (i = 0; i < seg->num_pages; i++)
+        unmap_shm_page(pcb->pid, pcb->shm[slot].vaddr + i * FOUR_KB_SIZE);
+
+    pcb->shm[slot].shmid = -1;
+    if (--seg->attach_cnt == 0)
+        shm_destroy(shmid);
+}
+
+static void shm_destroy(int32_t shmid) {
+    uint32_t i;
+    shm_segment_t* seg = &shm_segments[shmid];
+
+    for (i = 0; i < seg->num_pages; i++)
+        frame_put(seg->frames[i]);
+    mem_charge(MEM_SHM, -(int32_t)seg->num_pages);
+
+    seg->num_pages = 0;
+    seg->attach_cnt = 0;
+    seg->owner_pid = SHM_NO_OWNER;
+    seg->in_use = 0;
+}
+
+static wait_queue_t* shm_wait_queue(pcb_t* pcb, uint32_t vaddr, uint32_t** word) {
+    uint32_t pte;
+    uint32_t paddr;
+
+    if ((vaddr & (sizeof(uint32_t) - 1)) != 0 || vaddr < SHM_VIRTUAL || vaddr >= SHM_VIRTUAL_END)
+        return NULL;
+    pte = pte_read(pcb->shm_table, (vaddr & TABLE_MASK) >> FOUR_KB_OFFSET);
+    if (!(pte & PRESENT_MASK))
+        return NULL;
+    // the physical word, so every mapping of it hashes the same
+    paddr = (pte & FOUR_LB_PB_MASK) | (vaddr & (FOUR_KB_SIZE - 1));
+    *word = (uint32_t*)paddr;
+    return &shm_waiters[(paddr / sizeof(uint32_t)) % SHM_WAIT_BUCKETS];
+}
@@ -0,0 +1,42 @@
+#ifndef SHM_H
+#define SHM_H
+
+#include "types.h"
+#include "lib.h"
+#include "paging.h"
+#include "frame.h"
+#include "meminfo.h"
+
+#define SHM_MAX_SEGMENTS    16          // segments that can exist at the same time
+#define SHM_MAX_PAGES       64          // 256KB per segment
+#define SHM_NO_OWNER        0xFFFFFFFF
+#define SHM_WAIT_BUCKETS    16          // wait queues of shm_wait, by physical address
+
+typedef struct {
+    uint32_t in_use;
+    uint32_t key;                       // key chosen by the programs
+    uint32_t num_pages;
+    uint32_t attach_cnt;                // number of live mappings
+    uint32_t owner_pid;                 // creator, until someone attaches
+    uint32_t frames[SHM_MAX_PAGES];     // physical address of every page
+} shm_segment_t;
+
+// system calls
+int32_t shmget(uint32_t key, uint32_t size);
+int32_t shmat(int32_t shmid, void* addr);
+int32_t shmdt(void* addr);
+int32_t shm_wait(uint32_t* addr, uint32_t val);
+int32_t shm_wake(uint32_t* addr);
+
+/* shmat and shmdt on behalf of pcb */
+extern int32_t shm_attach(pcb_t* pcb, int32_t shmid, uint32_t vaddr);
+extern int32_t shm_detach_addr(pcb_t* pcb, uint32_t vaddr);
+/* shm_wait and shm_wake on behalf of pcb */
+extern int32_t shm_wait_addr(pcb_t* pcb, uint32_t vaddr, uint32_t val);
+extern int32_t shm_wake_addr(pcb_t* pcb, uint32_t vaddr);
+/* empty the attach table of a new process */
+extern void shm_init_pcb(pcb_t* pcb);
+/* detach everything a halting process still holds */
+extern void shm_release(pcb_t* pcb);
+
+#endif
@@ -0,0 +1,463 @@
+#include "smp.h"
+#include "lib.h"
+#include "paging.h"
+#include "frame.h"
+#include "process.h"
+#include "meminfo.h"
+#include "timer.h"
+#include "spinlock.h"
+#include "x86_desc.h"
+
+// MP floating pointer structure, MultiProcessor Specification 1.4 table 4-1
+typedef struct __attribute__((packed)) {
+    int8_t signature[4];                // "_MP_"
+    uint32_t config;                    // physical address of the configuration table
+    uint8_t length;                     // in 16 byte units
+    uint8_t spec_rev;
+    uint8_t checksum;
+    uint8_t features[5];
+} mp_float_t;
+
+// MP configuration table header, table 4-2
+typedef struct __attribute__((packed)) {
+    int8_t signature[4];                // "PCMP"
+    uint16_t length;
+    uint8_t spec_rev;
+    uint8_t checksum;
+    int8_t oem_id[8];
+    int8_t product_id[12];
+    uint32_t oem_table;
+    uint16_t oem_table_size;
+    uint16_t entry_count;
+    uint32_t lapic_addr;
+    uint16_t ext_length;
+    uint8_t ext_checksum;
+    uint8_t reserved;
+} mp_config_t;
+
+// processor entry, table 4-3
+typedef struct __attribute__((packed)) {
+    uint8_t type;
+    uint8_t apic_id;
+    uint8_t apic_version;
+    uint8_t flags;
+    uint32_t signature;
+    uint32_t features;
+    uint32_t reserved[2];
+} mp_cpu_t;
+
+// bus entry, table 4-5
+typedef struct __attribute__((packed)) {
+    uint8_t type;
+    uint8_t bus_id;
+    int8_t bus_type[MP_BUS_TYPE_LEN];  // "ISA   ", "PCI   ", ...
+} mp_bus_t;
+
+// I/O APIC entry, table 4-6
+typedef struct __attribute__((packed)) {
+    uint8_t type;
+    uint8_t apic_id;
+    uint8_t apic_version;
+    uint8_t flags;
+    uint32_t addr;
+} mp_ioapic_t;
+
+// I/O interrupt assignment entry, table 4-7
+typedef struct __attribute__((packed)) {
+    uint8_t type;
+    uint8_t int_type;
+    uint16_t flags;                     // polarity and trigger mode
+    uint8_t src_bus;
+    uint8_t src_irq;
+    uint8_t dst_apic;
+    uint8_t dst_pin;
+} mp_ioint_t;
+
+// ACPI root system description pointer, ACPI 1.0 part
+typedef struct __attribute__((packed)) {
+    int8_t signature[8];                // "RSD PTR "
+    uint8_t checksum;                   // of these 20 bytes
+    int8_t oem_id[6];
+    uint8_t revision;
+    uint32_t rsdt;                      // physical address of the RSDT
+} acpi_rsdp_t;
+
+// header of every ACPI system description table
+typedef struct __attribute__((packed)) {
+    int8_t signature[4];
+    uint32_t length;                    // the whole table, header included
+    uint8_t revision;
+    uint8_t checksum;
+    int8_t oem_id[6];
+    int8_t oem_table_id[8];
+    uint32_t oem_revision;
+    uint32_t creator_id;
+    uint32_t creator_revision;
+} acpi_header_t;
+
+// MADT, the "APIC" table, followed by its entries
+typedef struct __attribute__((packed)) {
+    acpi_header_t header;
+    uint32_t lapic_addr;
+    uint32_t flags;
+} acpi_madt_t;
+
+// processor local APIC entry of the MADT
+typedef struct __attribute__((packed)) {
+    uint8_t type;
+    uint8_t length;
+    uint8_t acpi_id;
+    uint8_t apic_id;
+    uint32_t flags;
+} madt_lapic_t;
+
+// I/O APIC entry of the MADT
+typedef struct __attribute__((packed)) {
+    uint8_t type;
+    uint8_t length;
+    uint8_t apic_id;
+    uint8_t reserved;
+    uint32_t addr;
+    uint32_t gsi_base;                  // first global interrupt of its pins
+} madt_ioapic_t;
+
+// interrupt source override entry of the MADT, an ISA line on another pin
+typedef struct __attribute__((packed)) {
+    uint8_t type;
+    uint8_t length;
+    uint8_t bus;                        // 0, ISA
+    uint8_t src_irq;
+    uint32_t gsi;
+    uint16_t flags;                     // same encoding as the MP table
+} madt_override_t;
+
+cpu_t cpus[SMP_MAX_CPUS];
+uint32_t cpu_count = 0;
+
+// guards the online flags the application processors set
+static spinlock_t smp_lock = SPINLOCK_INIT;
+
+/* read the MP configuration table, -1 if the BIOS left none */
+static int32_t mp_parse();
+/* read the ACPI MADT, -1 if there is none */
+static int32_t madt_parse();
+/* add an enabled processor to cpus */
+static void cpu_add(uint8_t apic_id);
+/* look for the MP floating pointer in [start, start + len) */
+static mp_float_t* mp_scan(uint32_t start, uint32_t len);
+/* look for the ACPI RSDP in [start, start + len) */
+static acpi_rsdp_t* rsdp_scan(uint32_t start, uint32_t len);
+/* 1 if the bytes of [addr, addr + len) add up to 0 */
+static int32_t mp_checksum_ok(uint8_t* addr, uint32_t len);
+/* send an interrupt command to the local APIC with id apic_id */
+static void lapic_ipi(uint8_t apic_id, uint32_t command);
+/* start one application processor, 0 once it is online */
+static int32_t start_ap(uint32_t cpu);
+
+/* void smp_detect()
+ * --------------------------------------------------------------------------------------
+ * Descriptions:    Find the processors, the I/O APIC and the pins of the ISA
+ *                  lines in the MP table of the BIOS, or in the ACPI MADT if
+ *                  there is no MP table. With "smp" on the boot command
+ *                  line, copy the trampoline below 1MB; without it no
+ *                  processor is started. Physical memory is read directly,
+ *                  so this must run before init_page.
+ * Inputs:          None
+ * Outputs:         None
+ * Side Effects:    Writes the page at AP_TRAMPOLINE
+ */
+void smp_detect() {
+    cpu_count = 0;
+
+    if (mp_parse() == -1 && madt_parse() == -1)
+        return;
+
+    if (!cmdline_has(boot_cmdline, (int8_t*)"smp")) {
+        cpu_count = 0;
+        return;
+    }
+
+    // the trampoline, and the gdt register it loads
+    memcpy((void*)AP_TRAMPOLINE, ap_trampoline, ap_trampoline_end - ap_trampoline);
+    asm volatile("sgdt (%0)"
+                 :
+                 : "r" (AP_TRAMPOLINE + (ap_gdt_desc - ap_trampoline))
+                 : "memory");
+}
+
+/* void smp_init()
+ * --------------------------------------------------------------------------------------
+ * Descriptions:    Start every application processor smp_detect found, one at
+ *                  a time: INIT, then up to two STARTUP IPIs, then wait for
+ *                  it to come online. Needs the TSC for the delays.
+ * Inputs:          None
+ * Outputs:         None
+ * Side Effects:    Maps the local APIC, allocates a kernel stack per processor
+ */
+void smp_init() {
+    uint32_t i;
+    uint32_t bsp;
+    uint32_t online;
+
+    if (cpu_count == 0)
+        return;
+
+    lapic_map();
+
+    // the application processors use the paging of the boot cpu
+    asm volatile("movl %%cr3, %0" : "=r" (ap_boot_cr3));
+    asm volatile("movl %%cr4, %0" : "=r" (ap_boot_cr4));
+
+    bsp = smp_cpu_id();
+    cpus[bsp].online = 1;
+    for (i = 0; i < cpu_count; i++) {
+        if (i != bsp)
+            start_ap(i);
+    }
+
+    online = smp_online_count();
+    printf("SMP: %d of %d cpus online, tasks run on the boot cpu only\n", online, cpu_count);
+}
+
+/* uint32_t smp_online_count()
+ * Inputs: none
+ * Return Value: number of processors running, at least 1
+ * Function: count the processors that came online
+ */
+uint32_t smp_online_count() {
+    uint32_t i;
+    uint32_t count = 0;
+
+    for (i = 0; i < cpu_count; i++) {
+        if (cpus[i].online)
+            count++;
+    }
+    return count > 0 ? count : 1;
+}
+
+/* uint32_t smp_cpu_id()
+ * Inputs: none
+ * Return Value: index into cpus of the caller, 0 without SMP
+ * Function: tell the processors apart by their local APIC id
+ */
+uint32_t smp_cpu_id() {
+    uint32_t i;
+    uint8_t apic_id;
+
+    if (!lapic_mapped())
+        return 0;
+    apic_id = lapic_read(LAPIC_ID) >> LAPIC_ID_SHIFT;
+    for (i = 0; i < cpu_count; i++) {
+        if (cpus[i].apic_id == apic_id)
+            return i;
+    }
+    return 0;
+}
+
+/* void ap_main()
+ * --------------------------------------------------------------------------------------
+ * Descriptions:    The first C code of an application processor, on its own
+ *                  kernel stack with paging on. It loads the idt, reports
+ *                  that it is online and parks: no interrupt is routed to it
+ *                  and it takes no tasks.
+ * Inputs:          None
+ * Outputs:         never returns
+ * Side Effects:    None
+ */
+void ap_main() {
+    uint32_t flags;
+
+    lidt(idt_desc_ptr);
+
+    spin_lock_irqsave(&smp_lock, flags);
+    cpus[smp_cpu_id()].online = 1;
+    spin_unlock_irqrestore(&smp_lock, flags);
+
+    while (1)
+        asm volatile("cli; hlt");
+}
+
+static int32_t start_ap(uint32_t cpu) {
+    uint32_t stack;
+    uint32_t waited;
+    uint32_t sipi;
+
+    if ((stack = frame_alloc_block(KSTACK_FRAMES)) == 0)
+        return -1;
+    mem_charge(MEM_KSTACK, KSTACK_FRAMES);
+    cpus[cpu].stack = stack;
+    ap_boot_stack = stack + EIGHT_KB_SIZE;
+
+    lapic_ipi(cpus[cpu].apic_id, ICR_INIT);
+    timer_udelay(AP_INIT_DELAY_US);
+    for (sipi = 0; sipi < 2 && !cpus[cpu].online; sipi++) {
+        lapic_ipi(cpus[cpu].apic_id, ICR_STARTUP | (AP_TRAMPOLINE >> FOUR_KB_OFFSET));
+        timer_udelay(AP_SIPI_DELAY_US);
+    }
+    for (waited = 0; waited < AP_ONLINE_WAIT_US && !cpus[cpu].online; waited += AP_SIPI_DELAY_US)
+        timer_udelay(AP_SIPI_DELAY_US);
+    if (cpus[cpu].online)
+        return 0;
+
+    // hold a late processor in reset before its stack goes back to the pool
+    lapic_ipi(cpus[cpu].apic_id, ICR_INIT);
+    cpus[cpu].stack = 0;
+    frame_put(stack);
+    frame_put(stack + FOUR_KB_SIZE);
+    mem_charge(MEM_KSTACK, -KSTACK_FRAMES);
+    return -1;
+}
+
+static int32_t mp_parse() {
+    mp_float_t * mpf;
+    mp_config_t * conf;
+    mp_cpu_t * cpu;
+    mp_ioint_t * ioint;
+    uint8_t * entry;
+    uint8_t isa_bus = MP_NO_BUS;
+    uint32_t i;
+
+    // the BDA holds the segment of the EBDA
+    mpf = mp_scan((uint32_t)(*(uint16_t*)BDA_EBDA_SEG) << 4, 1024);
+    if (mpf == NULL)
+        mpf = mp_scan(BASE_MEM_LAST_KB, 1024);
+    if (mpf == NULL)
+        mpf = mp_scan(BIOS_ROM_START, BIOS_ROM_END - BIOS_ROM_START);
+    // a default configuration without a table is not supported
+    if (mpf == NULL || mpf->config == 0)
+        return -1;
+
+    conf = (mp_config_t*)mpf->config;
+    if (strncmp(conf->signature, (int8_t*)"PCMP", 4) != 0 || !mp_checksum_ok((uint8_t*)conf, conf->length))
+        return -1;
+    lapic_base = conf->lapic_addr != 0 ? conf->lapic_addr : LAPIC_DEFAULT_BASE;
+
+    entry = (uint8_t*)(conf + 1);
+    for (i = 0; i < conf->entry_count; i++) {
+        switch (*entry) {
+            case MP_ENTRY_CPU:
+                cpu = (mp_cpu_t*)entry;
+                if (cpu->flags & MP_CPU_ENABLED)
+                    cpu_add(cpu->apic_id);
+                entry += MP_CPU_SIZE;
+                break;
+            case MP_ENTRY_BUS:
+                if (strncmp(((mp_bus_t*)entry)->bus_type, (int8_t*)"ISA", 3) == 0)
+                    isa_bus = ((mp_bus_t*)entry)->bus_id;
+                entry += MP_OTHER_SIZE;
+                break;
+            case MP_ENTRY_IOAPIC:
+                if (ioapic_base == 0)
+                    ioapic_base = ((mp_ioapic_t*)entry)->addr;
+                entry += MP_OTHER_SIZE;
+                break;
+            case MP_ENTRY_IOINT:
+                // the bus entries come first, so the ISA bus is known by now
+                ioint = (mp_ioint_t*)entry;
+                if (ioint->int_type == MP_IOINT_INT && ioint->src_bus == isa_bus)
+                    ioapic_set_isa_irq(ioint->src_irq, ioint->dst_pin, ioint->flags);
+                entry += MP_OTHER_SIZE;
+                break;
+            default:
+                entry += MP_OTHER_SIZE;
+                break;
+        }
+    }
+    return 0;
+}
+
+static int32_t madt_parse() {
+    acpi_rsdp_t * rsdp;
+    acpi_header_t * rsdt;
+    acpi_header_t * table;
+    acpi_madt_t * madt = NULL;
+    madt_override_t * over;
+    uint8_t * entry;
+    uint8_t * end;
+    uint32_t gsi_base = 0;
+    uint32_t i;
+
+    rsdp = rsdp_scan((uint32_t)(*(uint16_t*)BDA_EBDA_SEG) << 4, 1024);
+    if (rsdp == NULL)
+        rsdp = rsdp_scan(ACPI_ROM_START, BIOS_ROM_END - ACPI_ROM_START);
+    if (rsdp == NULL || rsdp->rsdt == 0)
+        return -1;
+
+    rsdt = (acpi_header_t*)rsdp->rsdt;
+    if (strncmp(rsdt->signature, (int8_t*)"RSDT", 4) != 0 || rsdt->length < sizeof(acpi_header_t)
+            || !mp_checksum_ok((uint8_t*)rsdt, rsdt->length))
+        return -1;
+    for (i = 0; i < (rsdt->length - sizeof(acpi_header_t)) / sizeof(uint32_t); i++) {
+        table = (acpi_header_t*)((uint32_t*)(rsdt + 1))[i];
+        if (strncmp(table->signature, (int8_t*)"APIC", 4) == 0 && mp_checksum_ok((uint8_t*)table, table->length)) {
+            madt = (acpi_madt_t*)table;
+            break;
+        }
+    }
+    if (madt == NULL)
+        return -1;
+    lapic_base = madt->lapic_addr != 0 ? madt->lapic_addr : LAPIC_DEFAULT_BASE;
+
+    // the I/O APIC first, an override names its global interrupt number
+    end = (uint8_t*)madt + madt->header.length;
+    for (entry = (uint8_t*)(madt + 1); entry + 2 <= end && entry[1] >= 2; entry += entry[1]) {
+        if (entry[0] == MADT_ENTRY_LAPIC && (((madt_lapic_t*)entry)->flags & MADT_LAPIC_ENABLED))
+            cpu_add(((madt_lapic_t*)entry)->apic_id);
+        if (entry[0] == MADT_ENTRY_IOAPIC && ioapic_base == 0) {
+            ioapic_base = ((madt_ioapic_t*)entry)->addr;
+            gsi_base = ((madt_ioapic_t*)entry)->gsi_base;
+        }
+    }
+    for (entry = (uint8_t*)(madt + 1); entry + 2 <= end && entry[1] >= 2; entry += entry[1]) {
+        over = (madt_override_t*)entry;
+        if (entry[0] == MADT_ENTRY_OVERRIDE && over->bus == 0 && over->gsi >= gsi_base)
+            ioapic_set_isa_irq(over->src_irq, over->gsi - gsi_base, over->flags);
+    }
+    return 0;
+}
+
+static void cpu_add(uint8_t apic_id) {
+    if (cpu_count == SMP_MAX_CPUS)
+        return;
+    cpus[cpu_count].apic_id = apic_id;
+    cpus[cpu_count].online = 0;
+    cpus[cpu_count].stack = 0;
+    cpu_count++;
+}
+
+static mp_float_t* mp_scan(uint32_t start, uint32_t len) {
+    uint32_t addr;
+
+    for (addr = start; addr + sizeof(mp_float_t) <= start + len; addr += MP_SCAN_ALIGN) {
+        if (strncmp((int8_t*)addr, (int8_t*)"_MP_", 4) == 0
+                && mp_checksum_ok((uint8_t*)addr, ((mp_float_t*)addr)->length * MP_SCAN_ALIGN))
+            return (mp_float_t*)addr;
+    }
+    return NULL;
+}
+
+static acpi_rsdp_t* rsdp_scan(uint32_t start, uint32_t len) {
+    uint32_t addr;
+
+    for (addr = start; addr + sizeof(acpi_rsdp_t) <= start + len; addr += MP_SCAN_ALIGN) {
+        if (strncmp((int8_t*)addr, (int8_t*)"RSD PTR ", 8) == 0
+                && mp_checksum_ok((uint8_t*)addr, sizeof(acpi_rsdp_t)))
+            return (acpi_rsdp_t*)addr;
+    }
+    return NULL;
+}
+
+static int32_t mp_checksum_ok(uint8_t* addr, uint32_t len) {
+    uint8_t sum = 0;
+    uint32_t i;
+
+    for (i = 0; i < len; i++)
+        sum += addr[i];
+    return sum == 0;
+}
+
+static void lapic_ipi(uint8_t apic_id, uint32_t command) {
+    lapic_write(LAPIC_ICR_HIGH, (uint32_t)apic_id << LAPIC_ID_SHIFT);
+    lapic_write(LAPIC_ICR_LOW, command);
+    while (lapic_read(LAPIC_ICR_LOW) & ICR_PENDING);
+}
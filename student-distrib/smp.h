@@ -0,0 +1,100 @@
+#ifndef SMP_H
+#define SMP_H
+
+#include "types.h"
+#include "apic.h"
+
+/*
+ * Application processor bring-up, turned on with "smp" on the boot command
+ * line. smp_detect reads the MP configuration table the BIOS leaves in low
+ * memory, or the ACPI MADT when there is none, before paging hides them,
+ * and always keeps the APIC addresses and ISA interrupt routing they list
+ * for init_apic. With "smp" it also copies
+ * the real mode trampoline of smp_boot.S to AP_TRAMPOLINE. smp_init then
+ * starts every application processor with INIT and STARTUP IPIs through
+ * the local APIC. Each one switches to protected mode with the page
+ * directory of the boot cpu, runs ap_main on its own kernel stack and
+ * parks in hlt.
+ *
+ * This is bring-up only, not an SMP scheduler. Still to do before a task
+ * can run on an application processor: a TSS and a GDT entry per cpu,
+ * current_task and the preemption state per cpu, spinlocks next to the
+ * cli of the scheduler, the frame pool, the swap clock and the terminals,
+ * then per-cpu run queues with work stealing. Until then only the boot
+ * cpu runs tasks and the others stay parked.
+ */
+#define SMP_MAX_CPUS        8
+#define AP_TRAMPOLINE       0x8000          // below 1MB, 4KB aligned, the SIPI vector is addr >> 12
+
+// where the BIOS may put the MP floating pointer
+#define BDA_EBDA_SEG        0x40E
+#define BASE_MEM_LAST_KB    0x9FC00
+#define BIOS_ROM_START      0xF0000
+#define BIOS_ROM_END        0x100000
+#define MP_SCAN_ALIGN       16
+
+// MP configuration table entries
+#define MP_ENTRY_CPU        0
+#define MP_ENTRY_BUS        1
+#define MP_ENTRY_IOAPIC     2
+#define MP_ENTRY_IOINT      3
+#define MP_CPU_SIZE         20
+#define MP_OTHER_SIZE       8
+#define MP_CPU_ENABLED      0x01
+#define MP_BUS_TYPE_LEN     6
+#define MP_IOINT_INT        0               // a plain vectored interrupt, not NMI or SMI
+#define MP_NO_BUS           0xFF
+
+// where the BIOS may put the ACPI RSDP, besides the EBDA
+#define ACPI_ROM_START      0xE0000
+
+// ACPI MADT entries
+#define MADT_ENTRY_LAPIC    0
+#define MADT_ENTRY_IOAPIC   1
+#define MADT_ENTRY_OVERRIDE 2
+#define MADT_LAPIC_ENABLED  0x01
+
+// interrupt commands, written to LAPIC_ICR_LOW
+#define ICR_INIT            0x00004500      // INIT, level assert
+#define ICR_STARTUP         0x00004600      // STARTUP, vector in the low byte
+#define ICR_PENDING         0x00001000
+
+#define AP_INIT_DELAY_US    10000
+#define AP_SIPI_DELAY_US    200
+#define AP_ONLINE_WAIT_US   100000
+
+#ifndef ASM
+
+// one processor found in the MP table
+typedef struct {
+    uint8_t apic_id;
+    volatile uint8_t online;
+    uint32_t stack;                         // kernel stack of an application processor
+} cpu_t;
+
+extern cpu_t cpus[SMP_MAX_CPUS];
+extern uint32_t cpu_count;
+
+/* read the MP table, and copy the trampoline for "smp", must run before init_page */
+extern void smp_detect();
+/* start the application processors, after init_pit */
+extern void smp_init();
+/* number of cpus that run, the boot cpu included */
+extern uint32_t smp_online_count();
+/* the index into cpus of the cpu that calls it */
+extern uint32_t smp_cpu_id();
+/* what an application processor runs once paging is on */
+extern void ap_main();
+
+// the trampoline, copied to AP_TRAMPOLINE
+extern uint8_t ap_trampoline[];
+extern uint8_t ap_trampoline_end[];
+extern uint8_t ap_gdt_desc[];
+// state smp_init hands to the application processor it starts
+extern uint32_t ap_boot_cr3;
+extern uint32_t ap_boot_cr4;
+extern uint32_t ap_boot_stack;
+
+#endif /* ASM */
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef SPINLOCK_H
+#define SPINLOCK_H
+
+#include "types.h"
+#include "lib.h"
+
+/*
+ * A spinlock keeps other cpus out, cli only keeps interrupts of this cpu
+ * out, so code that another cpu may run at the same time takes both with
+ * spin_lock_irqsave. On one cpu the lock is always free and costs one
+ * locked exchange.
+ */
+typedef struct {
+    volatile uint32_t locked;
+} spinlock_t;
+
+#define SPINLOCK_INIT   { 0 }
+
+/* spin until the lock is ours */
+static inline void spin_lock(spinlock_t* lock) {
+    uint32_t old;
+
+    while (1) {
+        old = 1;
+        asm volatile("xchgl %0, %1"
+                     : "+r" (old), "+m" (lock->locked)
+                     :
+                     : "memory");
+        if (old == 0)
+            return;
+        // wait for the lock to look free before another locked exchange
+        while (lock->locked)
+            asm volatile("pause");
+    }
+}
+
+/* give the lock back */
+static inline void spin_unlock(spinlock_t* lock) {
+    asm volatile("" : : : "memory");
+    lock->locked = 0;
+}
+
+/* disable interrupts, saving the flags, then take the lock */
+#define spin_lock_irqsave(lock, flags)      \
+do {                                        \
+    cli_and_save(flags);                    \
+    spin_lock(lock);                        \
+} while (0)
+
+/* give the lock back, then restore the flags */
+#define spin_unlock_irqrestore(lock, flags) \
+do {                                        \
+    spin_unlock(lock);                      \
+    restore_flags(flags);                   \
+} while (0)
+
+#endif
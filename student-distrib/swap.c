@@ -0,0 +1,376 @@
+#include "swap.h"
+#include "process.h"
+#include "meminfo.h"
+#include "scheduling.h"
+
+// one bit per swap slot, 1 means the slot holds a page
+static uint8_t slot_map[SWAP_MAX_SLOTS / 8];
+static uint32_t slot_num = 0;
+static uint32_t slot_free_num = 0;
+static uint32_t slot_hint = 0;
+
+// clock hand: the next pte to look at
+static uint32_t clock_pid = 0;
+static uint32_t clock_idx = 0;
+
+static uint32_t swap_in_cnt = 0;
+static uint32_t swap_out_cnt = 0;
+
+// the disk does one transfer at a time; tasks waiting for it, or for a
+// page in transit, sleep here
+static uint32_t disk_busy = 0;
+static wait_queue_t swap_wait;
+
+/* reserve a free swap slot, SWAP_MAX_SLOTS if swap is full */
+static uint32_t slot_alloc();
+/* give a swap slot back */
+static void slot_free(uint32_t slot);
+/* move a page between a frame and a slot, once the disk is free */
+static int32_t slot_io(uint32_t slot, uint32_t frame, uint32_t write);
+/* swap_in on the program page table of pcb, or the mapped one if pcb is NULL */
+static int32_t swap_in_table(pcb_t* pcb, uint32_t vaddr);
+
+/* void init_swap()
+ * --------------------------------------------------------------------------------------
+ * Descriptions:    Use the whole slave IDE disk as swap, in 4KB slots. Without a
+ *                  swap disk swap_out always fails and memory works as before.
+ * Inputs:          None
+ * Outputs:         None
+ * Side Effects:    None
+ */
+void init_swap() {
+    uint32_t i;
+
+    slot_num = ide_init() / SWAP_SLOT_SECTORS;
+    if (slot_num > SWAP_MAX_SLOTS)
+        slot_num = SWAP_MAX_SLOTS;
+
+    for (i = 0; i < SWAP_MAX_SLOTS / 8; i++)
+        slot_map[i] = 0;
+    slot_free_num = slot_num;
+    slot_hint = 0;
+}
+
+/* uint32_t swap_frame_alloc()
+ * --------------------------------------------------------------------------------------
+ * Descriptions:    Allocate a frame for user memory. When the pool is empty, cold
+ *                  user pages are written to swap until a frame is free.
+ * Inputs:          None
+ * Outputs:         the physical address of the frame, 0 if memory and swap are full
+ * Side Effects:    May unmap pages of any process
+ */
+uint32_t swap_frame_alloc() {
+    uint32_t frame;
+
+    while ((frame = frame_alloc()) == 0) {
+        if (swap_out() == -1)
+            return 0;
+    }
+    return frame;
+}
+
+/* uint32_t swap_frame_alloc_zeroed()
+ * --------------------------------------------------------------------------------------
+ * Descriptions:    Allocate a zeroed frame for user memory, preferring the frames
+ *                  the idle loop cleared, and swap cold pages out if needed
+ * Inputs:          None
+ * Outputs:         the physical address of the frame, 0 if memory and swap are full
+ * Side Effects:    May unmap pages of any process
+ */
+uint32_t swap_frame_alloc_zeroed() {
+    uint32_t frame;
+
+    while ((frame = frame_alloc_zeroed()) == 0) {
+        if (swap_out() == -1)
+            return 0;
+    }
+    return frame;
+}
+
+/* int32_t swap_out()
+ * --------------------------------------------------------------------------------------
+ * Descriptions:    Run the clock over the private user pages of every process.
+ *                  A page that was accessed since the hand last passed gets its
+ *                  accessed bit cleared and a second chance; the first page
+ *                  without it is written to swap and its frame is freed. Idle
+ *                  programs, like the shells of background terminals, stop
+ *                  touching their pages and are the first to lose them. The
+ *                  page is unmapped and marked busy before the write, which
+ *                  runs with interrupts as the caller had them.
+ * Inputs:          None
+ * Outputs:         0 if a page was evicted, -1 otherwise
+ * Side Effects:    Changing the program page table of the victim, may sleep
+ */
+int32_t swap_out() {
+    uint32_t n;
+    uint32_t slot;
+    uint32_t old;
+    uint32_t busy;
+    uint32_t* pte;
+    uint32_t table;
+    pcb_t * pcb;
+    int32_t ret;
+    uint32_t flags;
+
+    if (slot_free_num == 0 || max_task == 0)
+        return -1;
+
+    cli_and_save(flags);
+    // two turns of the hand: the first may only clear accessed bits
+    for (n = 0; n < 2 * max_task * TABLE_SIZE; n++) {
+        if (++clock_idx >= TABLE_SIZE) {
+            clock_idx = 0;
+            clock_pid = (clock_pid + 1) % max_task;
+            // the accessed bits cleared so far only come back after a flush
+            flush_tlb();
+        }
+
+        if ((pcb = get_pcb_by_index(clock_pid)) == NULL) {
+            n += TABLE_SIZE - 1 - clock_idx;
+            clock_idx = TABLE_SIZE - 1;
+            continue;
+        }
+
+        pte = pte_ptr(pcb->program_table, clock_idx);
+        if (!(*pte & PRESENT_MASK) || (*pte & SHARED_MASK))
+            continue;
+        if (*pte & A_MASK) {
+            *pte &= ~A_MASK;
+            continue;
+        }
+
+        // the victim may halt during the write, its page table stays
+        // allocated until we let go of it
+        table = (uint32_t)pte & FOUR_LB_PB_MASK;
+        if (frame_get(table) == -1)
+            continue;
+        if ((slot = slot_alloc()) == SWAP_MAX_SLOTS) {
+            frame_put(table);
+            break;
+        }
+
+        // the program must not change the page behind the copy, and a fault
+        // on it waits in swap_in; the frame stays ours until the write is done
+        old = *pte;
+        busy = (slot << FOUR_KB_OFFSET) | SWAPPED_MASK | SWAP_BUSY_MASK;
+        *pte = busy;
+        flush_tlb();
+        restore_flags(flags);
+
+        ret = slot_io(slot, old & FOUR_LB_PB_MASK, 1);
+
+        cli_and_save(flags);
+        if (*pte == busy && ret == -1) {
+            // the frame still holds the page, map it again
+            *pte = old;
+            slot_free(slot);
+        } else {
+            if (*pte == busy) {
+                *pte = busy & ~SWAP_BUSY_MASK;
+                swap_out_cnt++;
+            } else {
+                // the program halted during the write and left the slot to us
+                slot_free(slot);
+            }
+            frame_put(old & FOUR_LB_PB_MASK);
+            mem_charge(MEM_USER, -1);
+            ret = 0;
+        }
+        frame_put(table);
+        wake_up(&swap_wait);
+        restore_flags(flags);
+        return ret;
+    }
+
+    restore_flags(flags);
+    return -1;
+}
+
+/* int32_t swap_in(uint32_t vaddr)
+ * --------------------------------------------------------------------------------------
+ * Descriptions:    Called on a page fault. If the page is in swap, read it into a
+ *                  new frame and map it again. A page still in transit is waited
+ *                  for, and the fault happens again once it settled.
+ * Inputs:          uint32_t vaddr :    the faulting address
+ * Outputs:         0 if the fault can be retried, -1 if the fault is not a swapped page
+ * Side Effects:    Changing the mapped program page table, may sleep
+ */
+int32_t swap_in(uint32_t vaddr) {
+    return swap_in_table(NULL, vaddr);
+}
+
+/* int32_t swap_in_pcb(pcb_t* pcb, uint32_t vaddr)
+ * Inputs: pcb -- the process the page belongs to
+ *         vaddr -- address of the page in its program page
+ * Return Value: 0 if the page is back or was in transit, -1 if it is not in swap
+ * Function: the work of swap_in for a process that is not mapped
+ */
+int32_t swap_in_pcb(pcb_t* pcb, uint32_t vaddr) {
+    return swap_in_table(pcb, vaddr);
+}
+
+/* void swap_release(uint32_t pte)
+ * --------------------------------------------------------------------------------------
+ * Descriptions:    Free the slot of a page that will never be swapped in, used
+ *                  when a process halts
+ * Inputs:          uint32_t pte :  a pte that has SWAPPED_MASK set
+ * Outputs:         None
+ * Side Effects:    None
+ */
+void swap_release(uint32_t pte) {
+    // the transfer of a page in transit frees the slot itself
+    if ((pte & PRESENT_MASK) || !(pte & SWAPPED_MASK) || (pte & SWAP_BUSY_MASK))
+        return;
+    slot_free(pte >> FOUR_KB_OFFSET);
+}
+
+/* uint32_t swap_in_count()
+ * Inputs: none
+ * Return Value: number of swap-ins
+ * Function: report how many pages came back from swap
+ */
+uint32_t swap_in_count() {
+    return swap_in_cnt;
+}
+
+/* uint32_t swap_out_count()
+ * Inputs: none
+ * Return Value: number of swap-outs
+ * Function: report how many pages went to swap
+ */
+uint32_t swap_out_count() {
+    return swap_out_cnt;
+}
+
+/* uint32_t swap_total_slots()
+ * Inputs: none
+ * Return Value: number of 4KB slots in the swap area
+ * Function: report how large the swap area is
+ */
+uint32_t swap_total_slots() {
+    return slot_num;
+}
+
+/* uint32_t swap_free_slots()
+ * Inputs: none
+ * Return Value: number of free 4KB slots
+ * Function: report how much of the swap area is left
+ */
+uint32_t swap_free_slots() {
+    return slot_free_num;
+}
+
+static uint32_t slot_alloc() {
+    uint32_t i;
+    uint32_t slot;
+
+    for (i = 0; i < slot_num; i++) {
+        slot = (slot_hint + i) % slot_num;
+        if (!(slot_map[slot / 8] & (1 << (slot % 8)))) {
+            slot_map[slot / 8] |= (1 << (slot % 8));
+            slot_free_num--;
+            slot_hint = slot + 1;
+            return slot;
+        }
+    }
+    return SWAP_MAX_SLOTS;
+}
+
+static void slot_free(uint32_t slot) {
+    uint32_t flags;
+
+    if (slot >= slot_num)
+        return;
+    cli_and_save(flags);
+    if (slot_map[slot / 8] & (1 << (slot % 8))) {
+        slot_map[slot / 8] &= ~(1 << (slot % 8));
+        slot_free_num++;
+    }
+    restore_flags(flags);
+}
+
+static int32_t slot_io(uint32_t slot, uint32_t frame, uint32_t write) {
+    int32_t ret;
+    uint32_t flags;
+
+    cli_and_save(flags);
+    // a page fault cannot be given up, so a signal does not cut this short
+    while (disk_busy)
+        sleep_on(&swap_wait);
+    disk_busy = 1;
+    restore_flags(flags);
+
+    if (write)
+        ret = ide_write(slot * SWAP_SLOT_SECTORS, SWAP_SLOT_SECTORS, (void*)frame);
+    else
+        ret = ide_read(slot * SWAP_SLOT_SECTORS, SWAP_SLOT_SECTORS, (void*)frame);
+
+    cli_and_save(flags);
+    disk_busy = 0;
+    wake_up(&swap_wait);
+    restore_flags(flags);
+    return ret;
+}
+
+static int32_t swap_in_table(pcb_t* pcb, uint32_t vaddr) {
+    uint32_t* pte;
+    uint32_t slot;
+    uint32_t frame;
+    uint32_t busy;
+    uint32_t table;
+    int32_t ret = 0;
+    uint32_t flags;
+
+    cli_and_save(flags);
+    if (pcb == NULL)
+        pte = get_mapped_program_pte(vaddr);
+    else if ((vaddr & FOUR_MB_PB_MASK) == _128_MB_SIZE)
+        pte = pte_ptr(pcb->program_table, (vaddr & TABLE_MASK) >> FOUR_KB_OFFSET);
+    else
+        pte = NULL;
+    if (pte == NULL || (*pte & PRESENT_MASK) || !(*pte & SWAPPED_MASK)) {
+        restore_flags(flags);
+        return -1;
+    }
+    if (*pte & SWAP_BUSY_MASK) {
+        sleep_on(&swap_wait);
+        restore_flags(flags);
+        return 0;
+    }
+    // a thread faults on the table of its process, which may be halting
+    table = (uint32_t)pte & FOUR_LB_PB_MASK;
+    if (frame_get(table) == -1) {
+        restore_flags(flags);
+        return -1;
+    }
+    busy = *pte | SWAP_BUSY_MASK;
+    *pte = busy;
+    restore_flags(flags);
+
+    slot = busy >> FOUR_KB_OFFSET;
+    if ((frame = swap_frame_alloc()) != 0 && slot_io(slot, frame, 0) == -1) {
+        frame_put(frame);
+        frame = 0;
+    }
+
+    cli_and_save(flags);
+    if (*pte != busy) {
+        // the program halted during the read and left the slot to us
+        slot_free(slot);
+        if (frame != 0)
+            frame_put(frame);
+    } else if (frame == 0) {
+        *pte = busy & ~SWAP_BUSY_MASK;
+        ret = -1;
+    } else {
+        *pte = frame | PRESENT_MASK | U_S_MASK | R_W_MASK;
+        flush_tlb();
+        slot_free(slot);
+        mem_charge(MEM_USER, 1);
+        swap_in_cnt++;
+    }
+    frame_put(table);
+    wake_up(&swap_wait);
+    restore_flags(flags);
+    return ret;
+}
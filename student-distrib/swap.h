@@ -0,0 +1,37 @@
+#ifndef SWAP_H
+#define SWAP_H
+
+#include "types.h"
+#include "lib.h"
+#include "paging.h"
+#include "frame.h"
+#include "ide.h"
+
+#define SWAP_MAX_SLOTS      16384       // 64MB of swap at most
+#define SWAP_SLOT_SECTORS   (FOUR_KB_SIZE / IDE_SECTOR_SIZE)
+#define SWAP_BLOCK_TRIES    64          // pages to evict before giving up on a contiguous block
+
+/* find the swap disk and empty the swap area */
+extern void init_swap();
+/* allocate a frame, pushing a cold user page to swap if the pool is empty */
+extern uint32_t swap_frame_alloc();
+/* same as swap_frame_alloc, but the frame is filled with zeros */
+extern uint32_t swap_frame_alloc_zeroed();
+/* move one cold user page to swap, 0 on success, -1 if nothing can be evicted */
+extern int32_t swap_out();
+/* bring back the page at vaddr of the mapped program page, -1 if it is not in swap */
+extern int32_t swap_in(uint32_t vaddr);
+/* swap_in for a page of pcb, which need not be mapped */
+extern int32_t swap_in_pcb(pcb_t* pcb, uint32_t vaddr);
+/* free the swap slot recorded in a swapped-out pte */
+extern void swap_release(uint32_t pte);
+/* number of pages read back from swap since boot */
+extern uint32_t swap_in_count();
+/* number of pages written to swap since boot */
+extern uint32_t swap_out_count();
+/* number of swap slots, 0 if there is no swap disk */
+extern uint32_t swap_total_slots();
+/* number of swap slots that are free */
+extern uint32_t swap_free_slots();
+
+#endif
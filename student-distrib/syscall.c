@@ -1,4 +1,6 @@
 #include "syscall.h"
+#include "scheduling.h"
+#include "thread.h"
 
 // specific file operation tables
 file_operation_ptrs fail_funcs = {fail, fail, fail, fail};
@@ -8,23 +10,22 @@ file_operation_ptrs dir_funcs = {dir_open, dir_read, dir_write, dir_close};
 file_operation_ptrs rtc_funcs = {rtc_open, rtc_read, rtc_write, rtc_close};
 file_operation_ptrs file_funcs = {file_open, file_read, file_write, file_close};
 
-// 0 indicates file discriptor not used, and 1 indicates file discriptor is in use
-uint32_t process[MAX_TASK] = {0,0,0,0,0,0};
 
+/* parse a command, load the program and build its pcb, the task is not runnable yet */
+static int32_t spawn(const uint8_t* command, uint8_t terminal_id, pcb_t* parent);
 
-// return value for halt
-uint32_t retval = 0;
 /*
  * Function:  int32_t halt(uint8_t status)
  * --------------------
- * This function does four things: restore parent data, restore parent paging,
- * close any relavent FDs, and jump to execute return. This function should
- * never return to its caller.
+ * This function terminates the calling process. It frees the memory and
+ * closes the fds of the process, hands status to the parent if the parent
+ * is blocked in execute waiting for it, and gives the cpu away for good.
+ * A terminal whose last foreground process halts gets a new shell.
  *
  *  Inputs:     uint8_t status: the status to be return by execute
  *
  *  Returns:    -1: failed
- *              status: success
+ *              never returns otherwise
  *
  *  Side effects: halt the program
  *
@@ -32,28 +33,23 @@ uint32_t retval = 0;
 int32_t halt(uint8_t status) {
     uint32_t i;             // loop counter
     pcb_t * pcb;            // pcb pointer
-    uint32_t esp, ebp;      // store parent esp and ebp
-cli();
-    pcb = get_pcb_by_index(process_terminal[running_terminal][process_terminal_cnt[running_terminal] - 1]);
-
-    //printf("--->Executing halt!\n");
-    //printf("--->pid: %d\n", running_terminal);
-    /* restore parent data */
-    // restore parent esp and ebp
-    esp = pcb->parent_esp;
-    ebp = pcb->parent_ebp;
-
-    //print("parentpid: %d\n", pcb->parent_pid);
-
-    /* restore parent paging */
-    map_program(pcb->parent_pid);
-    // set tss parameters
-    tss.ss0 = KERNEL_DS;
-    tss.esp0 = EIGHT_MB_SIZE - pcb->parent_pid * EIGHT_KB_SIZE - ESP_OFFSET;
-    // free up current pid in the pid array
-    process[pcb->pid] = NOT_IN_USE;
-    process_terminal[running_terminal][process_terminal_cnt[running_terminal] - 1] = NOT_IN_USE;
-    process_terminal_cnt[running_terminal] -= 1;
+    pcb_t * parent;         // parent pcb, NULL for the first shell of a terminal
+    uint8_t terminal_id;    // terminal of the halting process
+    uint32_t restart = 0;   // whether the terminal needs a new shell
+
+    // a thread halts alone, a process takes its threads with it
+    if (get_curr_pcb()->leader != NULL)
+        thread_exit(status);
+    thread_group_exit(get_curr_pcb());
+
+    // tear down with interrupts on, a signal waits for a return to user
+    // mode that never comes
+    pcb = get_curr_pcb();
+    terminal_id = pcb->terminal_id;
+
+    /* detach shared memory and shared text */
+    shm_release(pcb);
+    unload_program(pcb->pid);
 
     /* close any relavent fds */
     for (i = 0; i < MAX_FD; i++) {
@@ -66,23 +62,35 @@ cli();
         pcb->files[i].ptrs = &fail_funcs;
     }
 
-    // check if we are halting shell
-    if (pcb->pid == 0 || process_terminal_cnt[running_terminal] == 0) {
-        execute((uint8_t*)"shell");
+    // from here on the pid may be reused, by an interrupt too
+    cli();
+
+    // the parent is the foreground process of this terminal again
+    if (!pcb->background) {
+        process_terminal[terminal_id] = pcb->parent_pid;
+        process_terminal_cnt[terminal_id] -= 1;
+        restart = (process_terminal_cnt[terminal_id] == 0);
+    }
+
+    /* return status to execute */
+    parent = (pcb->parent_pid != pcb->pid) ? get_pcb_by_index(pcb->parent_pid) : NULL;
+    if (parent != NULL && parent->wait_pid == pcb->pid) {
+        parent->child_status = (status == EXCEPTION_MAGIC) ? EXCEPTION_RET : status;
+        parent->wait_pid = NO_PID;
+        sched_wake(parent);
     }
 
-    retval = status;
+    // free up the pid, the kernel stack goes once we are off it
+    sched_exit();
+    process_destroy(pcb->pid);
+    pid_free(pcb->pid);
+
+    // check if we are halting shell, the work task loads the next one
+    // since this task is dead and must not sleep any more
+    if (restart)
+        terminal_start_shell(terminal_id);
 
-    /* jump to execute return */
-    // return status to execute
-    asm volatile(
-        "movl %0, %%esp;"
-        "movl %1, %%ebp;"
-        "jmp return_to_execute;"
-        : /* no outputs */
-        : "g" (esp), "g" (ebp)
-        : "%eax"
-    );
+    schedule();
 
     // should never reach here
     return -1;
@@ -91,26 +99,100 @@ cli();
 /*
  * Function:  int32_t execute(const uint8_t* command)
  * --------------------
+ * This function starts a program as a child of the calling process. The
+ * caller blocks until the child halts, so only the child of a terminal
+ * chain uses the cpu. A command that ends with '&' starts a background
+ * job instead: it is scheduled next to its parent, which returns at once.
+ *
+ *  Inputs:     const uint8_t* command: the command to be executed
+ *
+ *  Returns:    -1: failed
+ *              0: success
+ *              256: exception occur
+ *              pid: the background job was started
+ *
+ *  Side effects: execute the program
+ *
+ */
+int32_t execute(const uint8_t* command) {
+    int32_t new_pid;                    // the pid of the executable
+    pcb_t * parent_pcb;                 // the caller
+    pcb_t * new_pcb;                    // new executable's pcb
+    uint32_t flags;
+
+    // only a process runs programs, its threads cannot wait for a child
+    if (command == NULL || get_curr_pcb()->leader != NULL)
+        return -1;
+
+    // loading the program runs with interrupts on and may be preempted
+    parent_pcb = get_curr_pcb();
+    if ((new_pid = spawn(command, parent_pcb->terminal_id, parent_pcb)) == -1)
+        return -1;
+    new_pcb = get_pcb_by_index(new_pid);
+
+    // a background job runs next to its parent
+    if (new_pcb->background && !parent_pcb->background) {
+        sched_wake(new_pcb);
+        return new_pid;
+    }
+
+    // sleep until halt hands back the status of the child
+    cli_and_save(flags);
+    parent_pcb->wait_pid = new_pid;
+    sched_wake(new_pcb);
+    while (parent_pcb->wait_pid != NO_PID)
+        sched_block();
+    restore_flags(flags);
+
+    return parent_pcb->child_status;
+}
+
+/*
+ * Function:  int32_t spawn_shell(uint8_t terminal_id)
+ * --------------------
+ * This function starts the first shell of a terminal. Nobody waits for
+ * it; when it halts, halt has the work task start another one.
+ *
+ *  Inputs:     uint8_t terminal_id: the terminal the shell belongs to
+ *
+ *  Returns:    -1: failed
+ *              pid: the pid of the shell
+ *
+ *  Side effects: adds the shell to the run queue
+ *
+ */
+int32_t spawn_shell(uint8_t terminal_id) {
+    int32_t pid;
+
+    if ((pid = spawn((uint8_t*)"shell", terminal_id, NULL)) != -1)
+        sched_wake(get_pcb_by_index(pid));
+    return pid;
+}
+
+/*
+ * Function:  int32_t spawn(const uint8_t* command, uint8_t terminal_id, pcb_t* parent)
+ * --------------------
  * This function does six things:
  *          1. parse arguments
  *          2. executable check
  *          3. set up program paging
  *          4. user-level program loader
  *          5. create pcb
- *          6. context switch
+ *          6. prepare the first context switch to the program
  *
  *  Inputs:     const uint8_t* command: the command to be executed
+ *              uint8_t terminal_id: the terminal of the new process
+ *              pcb_t* parent: the parent, NULL for the first shell of a terminal
  *
  *  Returns:    -1: failed
- *              0: success
- *              256: exception occur
+ *              pid: the pid of the new process, which still has to be woken
  *
- *  Side effects: execute the program
+ *  Side effects: push a foreground process on the chain of its terminal
  *
  */
-int32_t execute(const uint8_t* command) {
+static int32_t spawn(const uint8_t* command, uint8_t terminal_id, pcb_t* parent) {
     uint32_t i;                         // loop counter
-    uint32_t new_pid;                   // the pid of the executable
+    int32_t new_pid;                    // the pid of the executable
     uint8_t exe_name[F_TYPE_OFFSET];    // executable name
     uint8_t args_buf[ARG_MAX];          // buffer that stores the argument
     uint8_t magics[FOUR_BYTES];         // magic number buffer
@@ -119,12 +201,12 @@ int32_t execute(const uint8_t* command) {
     };
     uint32_t command_start = 0;         // variables to find the exe name and argument
     uint32_t command_length = 0;
+    uint8_t background = 0;             // the command ends with '&'
     dentry_t dentry;
     uint32_t entry;                     // stores the entry point of the executable
-    pcb_t * parent_pcb;                 // parent pcb
     pcb_t * new_pcb;                    // new executable's pcb
-    //printf("hi");
-cli();
+    uint32_t flags;
+
     /**********************
      * 1. Parse Arguments *
      **********************/
@@ -136,7 +218,6 @@ cli();
             && command[command_start + command_length] != '\n'
             && command[command_start + command_length] != '\0')
         command_length++;
-    // printf("%d\n", command_length);
     // copy the executable name to the exe_name buffer
     for (i = command_start; i < command_start + command_length; i++) {
         if(i > KEY_ARR_SIZE - 1){
@@ -149,7 +230,6 @@ cli();
         }
         exe_name[i-command_start] = command[i];
     }
-    //printf("hi\n");
     if (i-command_start >= F_TYPE_OFFSET)
         i = command_start + F_TYPE_OFFSET - 1;
     exe_name[i-command_start] = '\0';
@@ -159,12 +239,20 @@ cli();
     command_start = command_length;
 
     while (command[command_length] != '\n'
-            && command[command_length] != '\0') {
+            && command[command_length] != '\0'
+            && command_length - command_start < ARG_MAX - 1) {
         args_buf[command_length - command_start] = command[command_length];
         command_length++;
     }
     args_buf[command_length-command_start] = '\0';
-    //printf("hi");
+
+    // a trailing '&' runs the program in the background
+    for (i = command_length - command_start; i > 0 && args_buf[i - 1] == SPACE; i--);
+    if (i > 0 && args_buf[i - 1] == '&') {
+        background = 1;
+        for (i--; i > 0 && args_buf[i - 1] == SPACE; i--);
+        args_buf[i] = '\0';
+    }
 
     /***********************
      * 2. Executable Check *
@@ -188,64 +276,54 @@ cli();
     /***************************
      * 3. Setup Program Paging *
      ***************************/
-    // get available pid
-    for (new_pid = 0; new_pid < MAX_TASK; new_pid++) {
-        if (process[new_pid] == NOT_IN_USE) {
-            process[new_pid] = IN_USE;
-            break;
-        }
-    }
-    // check if it reaches the maximum process
-    if (new_pid >= MAX_TASK)
+    // get available pid and its kernel stack
+    if ((new_pid = pid_alloc()) == -1)
         return -1;
-    // map program paging
-    map_program(new_pid);
+    if ((new_pcb = process_create(new_pid)) == NULL) {
+        pid_free(new_pid);
+        return -1;
+    }
 
 
     /********************************
      * 4. User-level Progran Loader *
      ********************************/
-    read_data(dentry.i_node, 0, (uint8_t*)(PROGRAM_OFFSET), FOUR_MB_SIZE);
+    // map program paging, sharing the text with other instances
+    if (load_program(new_pid, dentry.i_node) == -1) {
+        process_destroy(new_pid);
+        pid_free(new_pid);
+        return -1;
+    }
 
 
     /*****************
      * 5. Create PCB *
      *****************/
-    // check if it's the first user program loaded and set the parent pcb
-    if (new_pid == 0)
-        parent_pcb = NULL;
-    else{
-        if(process_terminal_cnt[current_terminal] != 0){
-            parent_pcb = get_pcb_by_index(process_terminal[current_terminal][process_terminal_cnt[current_terminal] - 1]);
-        }else{
-            parent_pcb = get_pcb_by_index(0);
-        }
-
-    }
-
-    process_terminal_cnt[current_terminal] += 1;
-
-    // assign the new pcb
-    new_pcb = get_pcb_by_index(new_pid);
-    new_pcb->pid = new_pid;
-    process_terminal[current_terminal][process_terminal_cnt[current_terminal] - 1] = new_pid;
-    // set the parent pid parameter
-    if (parent_pcb != NULL)
-        new_pcb->parent_pid = parent_pcb->pid;
+    new_pcb->terminal_id = terminal_id;
+    new_pcb->wait_pid = NO_PID;
+    // children of a background job stay in the background
+    new_pcb->background = background || (parent != NULL && parent->background);
+    // and inherit the priority of their parent
+    new_pcb->nice = (parent != NULL) ? parent->nice : 0;
+
+    // the first program of a terminal is its own parent
+    if (parent != NULL)
+        new_pcb->parent_pid = parent->pid;
     else
         new_pcb->parent_pid = new_pid;
 
-    // save argument in pcb
-    strncpy((int8_t*)new_pcb->argument, (int8_t*)args_buf, ARG_MAX);
+    // a foreground child is the one the keyboard talks to, halt changes
+    // the chain under cli too
+    if (!new_pcb->background) {
+        cli_and_save(flags);
+        process_terminal_cnt[terminal_id] += 1;
+        process_terminal[terminal_id] = new_pid;
+        restore_flags(flags);
+    }
 
-    // save parent esp and ebp
-    asm volatile(
-        "movl %%esp, %%eax;"
-        "movl %%ebp, %%ebx;"
-        : "=a" (new_pcb->parent_esp), "=b" (new_pcb->parent_ebp)
-        :
-        : "cc"
-    );
+    // save argument and executable name in pcb
+    strncpy((int8_t*)new_pcb->argument, (int8_t*)args_buf, ARG_MAX);
+    strncpy((int8_t*)new_pcb->name, (int8_t*)exe_name, PROC_NAME_LEN);
 
     // fill up the first(stdin) and the second(stdout) entry
     // of the file discriptor table
@@ -266,41 +344,19 @@ cli();
     }
 
     new_pcb->sighandler = signal_default;
-    new_pcb->pending_signal = 0x3F;
+    new_pcb->pending_signal = NO_SIGNAL;
+
+    // no shared memory attached yet
+    shm_init_pcb(new_pcb);
 
 
     /*********************
      * 6. Context Switch *
      *********************/
-    // set tss parameters
-    tss.ss0 = KERNEL_DS;
-    tss.esp0 = EIGHT_MB_SIZE - new_pid * EIGHT_KB_SIZE - ESP_OFFSET;
-
-    // prepare for context switch
-    asm volatile(
-        "xorl %%eax, %%eax;"
-        "movw %w0, %%ax;"
-        "movw %%ax, %%ds;"
-        "pushl %%eax;"          // push the user data segment information
-        "pushl %1;"             // push user program esp
-        "pushfl;"               // push eflags
-        "popl %%eax;"           // manually enable the interrupt
-        "orl $0x200, %%eax;"
-        "pushl %%eax;"
-        "pushl %2;"             // push code segment information
-        "pushl %3;"             // push user program eip
-        "iret;"
-        "return_to_execute:;"
-        : /* no outputs */
-        : "g" (USER_DS), "g" (_128_MB_SIZE + FOUR_MB_SIZE - ESP_OFFSET), "g" (USER_CS), "g" (entry)
-        : "eax"
-    );
-
-    // check if any exception occured
-    sti();
-    if (retval == EXCEPTION_MAGIC)
-        return EXCEPTION_RET;
-    return 0;
+    // the first switch to the task irets to the entry point
+    sched_prepare(new_pcb, entry, _128_MB_SIZE + FOUR_MB_SIZE - ESP_OFFSET);
+
+    return new_pid;
 }
 
 /*
@@ -331,7 +387,7 @@ int32_t read(int32_t fd, void* buf, int32_t nbytes) {
     if (buf == NULL)
         return -1;
 
-    pcb = get_curr_pcb();
+    pcb = get_curr_proc();
     // check if file is opened
     if (pcb->files[fd].flags == NOT_IN_USE)
         return -1;
@@ -367,7 +423,7 @@ int32_t write(int32_t fd, const void* buf, int32_t nbytes) {
     if (buf == NULL)
         return -1;
 
-    pcb = get_curr_pcb();
+    pcb = get_curr_proc();
     // check if file is opened
     if (pcb->files[fd].flags == NOT_IN_USE)
         return -1;
@@ -394,7 +450,7 @@ int32_t open(const uint8_t* filename) {
     pcb_t * pcb;            // pcb pointer
     dentry_t dentry;        // holds file information
 
-    pcb = get_curr_pcb();
+    pcb = get_curr_proc();
 
     // check valid inputs
     if (filename == NULL)
@@ -472,7 +528,7 @@ int32_t close(int32_t fd) {
     if (fd < MIN_FD || fd >= MAX_FD)
         return -1;
 
-    pcb = get_curr_pcb();
+    pcb = get_curr_proc();
     // check if the file is opened before
     if (pcb->files[fd].flags == NOT_IN_USE)
         return -1;
@@ -534,9 +590,15 @@ int32_t getargs(uint8_t* buf, int32_t nbytes) {
  *
  */
 int32_t vidmap(uint8_t** screen_start) {
+    uint32_t pte;
     if((uint32_t)(screen_start) < _128_MB_SIZE || (uint32_t)(screen_start) > _128_MB_SIZE + FOUR_MB_SIZE - ESP_OFFSET){
         return -1;
     }
+    // only the pages the program owns are mapped, and text is read-only
+    pte = get_program_page(get_curr_pcb()->pid, (uint32_t)screen_start);
+    if((pte & (PRESENT_MASK | R_W_MASK)) != (PRESENT_MASK | R_W_MASK)){
+        return -1;
+    }
     map_user_video();
     *screen_start = (uint8_t*)USER_VIDEO;
     return (int32_t)USER_VIDEO;
@@ -585,13 +647,7 @@ int32_t fail() {
  * Function: this function returns the next available pid
  */
 extern int32_t get_pid() {
-    int32_t new_pid;
-    for (new_pid = 0; new_pid < MAX_TASK; new_pid++) {
-        if (process[new_pid] == NOT_IN_USE) {
-            return new_pid;
-        }
-    }
-    return -1;
+    return pid_peek();
 }
 
 /*
@@ -602,16 +658,11 @@ extern int32_t get_pid() {
  * Function: this function returns the terminal id
  */
 uint8_t get_terminal_id(uint32_t pid){
-    uint8_t i = 0;
-    uint8_t j = 0;
-    for(i = 0; i < MAX_TERMINAL_NUM; i ++){
-        for(j = 0; j < MAX_TASK; j ++){
-            if(process_terminal[i][j] == pid){
-                return i;
-            }
-        }
+    pcb_t * pcb = get_pcb_by_index(pid);
+    if(pcb == NULL){
+        return 0x3F;
     }
-    return 0x3F;
+    return pcb->terminal_id;
 }
 
 
@@ -624,6 +675,74 @@ void kill(){
     halt(0xF);
 }
 
+/* void post_signal(pcb_t* pcb, uint8_t signum)
+ * Inputs: pcb -- the target process
+ *         signum -- the signal
+ * Return Value: none
+ * Function: mark a signal pending and wake the target if it is blocked,
+ *           it is delivered once the target runs
+ */
+void post_signal(pcb_t* pcb, uint8_t signum){
+    uint32_t flags;
+
+    cli_and_save(flags);
+    pcb->pending_signal = signum;
+    if (pcb->state == TASK_BLOCKED)
+        sched_wake(pcb);
+    restore_flags(flags);
+}
+
+/* uint32_t signal_pending(pcb_t* pcb)
+ * Inputs: pcb -- a task
+ * Return Value: 1 if the task has a signal to take on its way back to
+ *               user mode, or belongs to a halting process, 0 otherwise
+ * Function: lets a blocking system call give up early
+ */
+uint32_t signal_pending(pcb_t* pcb){
+    if (pcb->pending_signal != NO_SIGNAL)
+        return 1;
+    return pcb->leader != NULL && pcb->leader->exiting;
+}
+
+/* void check_signal(pcb_t* pcb)
+ * Inputs: pcb -- the process on the cpu, NULL for the idle loop
+ * Return Value: none
+ * Function: deliver the pending signal of the running process
+ */
+void check_signal(pcb_t* pcb){
+    uint8_t signum;
+
+    if (pcb == NULL)
+        return;
+    // a thread of a halting process halts too, whatever its handler
+    if (pcb->leader != NULL && pcb->leader->exiting)
+        halt(0);
+    if (pcb->pending_signal == NO_SIGNAL)
+        return;
+    signum = pcb->pending_signal;
+    pcb->pending_signal = NO_SIGNAL;
+    send_signal(signum);
+}
+
+/* void user_return()
+ * Inputs: none
+ * Return Value: none
+ * Function: called by the linkage right before a task goes back to user
+ *           mode, the only place it holds nothing in the kernel. Delivers
+ *           its pending signal, or halts a thread of a halting process.
+ */
+void user_return(){
+    pcb_t* pcb = sched_current();
+
+    if (pcb == NULL || pcb->kthread)
+        return;
+    if (!signal_pending(pcb))
+        return;
+    // the handler halts like the halt system call, with interrupts on
+    sti();
+    check_signal(pcb);
+}
+
 void send_signal(uint8_t signum){
     pcb_t* pcb = get_curr_pcb();
     // printf("hello %d\n", running_terminal);
@@ -9,6 +9,10 @@
 #include "x86_desc.h"
 #include "exception.h"
 #include "lib.h"
+#include "shm.h"
+#include "loader.h"
+#include "meminfo.h"
+#include "process.h"
 
 #define IN_USE          1
 #define NOT_IN_USE      0
@@ -28,6 +32,10 @@
 
 
 extern void send_signal(uint8_t signum);
+extern void post_signal(pcb_t* pcb, uint8_t signum);
+extern void check_signal(pcb_t* pcb);
+extern uint32_t signal_pending(pcb_t* pcb);
+extern void user_return();
 extern void signal_default(uint8_t signum);
 
 
@@ -49,6 +57,8 @@ int32_t play(const uint8_t* filename);
 int32_t fail();
 // helper function
 extern int32_t get_pid();
+/* start the first shell of a terminal */
+extern int32_t spawn_shell(uint8_t terminal_id);
 
 uint8_t get_terminal_id(uint32_t pid);
 
@@ -0,0 +1,56 @@
+#include "sysenter.h"
+#include "lib.h"
+#include "x86_desc.h"
+
+static uint32_t sysenter_on = 0;
+
+/* write a model specific register */
+static void wrmsr(uint32_t msr, uint32_t value);
+
+/* void init_sysenter()
+ * --------------------------------------------------------------------------------------
+ * Descriptions:    Check cpuid for SYSENTER and program its msrs: the kernel
+ *                  code segment, from which the cpu also derives the kernel
+ *                  stack segment and the user segments of SYSEXIT, the entry
+ *                  point, and as the stack the address of tss.esp0, which
+ *                  sysenter_entry loads the kernel stack of the task from.
+ *                  The program stubs run the same cpuid test, so they only
+ *                  use SYSENTER when this enabled it.
+ * Inputs:          None
+ * Outputs:         None
+ * Side Effects:    Writes the SYSENTER msrs
+ */
+void init_sysenter() {
+    uint32_t signature;
+    uint32_t features;
+
+    asm volatile(
+        "movl $1, %%eax                     ;"
+        "cpuid                              ;"
+        : "=a" (signature), "=d" (features)
+        :
+        : "ebx", "ecx");
+    if (!(features & CPUID_SEP))
+        return;
+    if (((signature >> 8) & 0xF) == SEP_BAD_FAMILY && ((signature >> 16) & 0xF) == 0
+            && ((signature >> 4) & 0xF) < SEP_BAD_MODEL && (signature & 0xF) < SEP_BAD_STEPPING)
+        return;
+
+    wrmsr(MSR_SYSENTER_CS, KERNEL_CS);
+    wrmsr(MSR_SYSENTER_ESP, (uint32_t)&tss.esp0);
+    wrmsr(MSR_SYSENTER_EIP, (uint32_t)sysenter_entry);
+    sysenter_on = 1;
+}
+
+/* uint32_t sysenter_enabled()
+ * Inputs: none
+ * Return Value: 1 if the SYSENTER msrs are set up, 0 otherwise
+ * Function: tell whether programs get the fast system call path
+ */
+uint32_t sysenter_enabled() {
+    return sysenter_on;
+}
+
+static void wrmsr(uint32_t msr, uint32_t value) {
+    asm volatile("wrmsr" : : "c" (msr), "a" (value), "d" (0));
+}
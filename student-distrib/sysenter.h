@@ -0,0 +1,40 @@
+#ifndef SYSENTER_H
+#define SYSENTER_H
+
+#include "types.h"
+
+/*
+ * Fast system calls. On a cpu with SYSENTER, init_sysenter points the
+ * SYSENTER msrs at sysenter_entry, and the stubs in ece391syscall.S use it
+ * instead of int $0x80 whenever cpuid reports it. The number and the
+ * arguments go in the same registers; in addition esi holds the user
+ * address to return to and ebp the user stack pointer, which SYSEXIT
+ * needs. sysenter_entry pushes the frame int $0x80 would have pushed, so
+ * everything after the entry sees the same kernel stack, and returns with
+ * SYSEXIT unless that frame was changed.
+ */
+#define MSR_SYSENTER_CS     0x174
+#define MSR_SYSENTER_ESP    0x175
+#define MSR_SYSENTER_EIP    0x176
+#define CPUID_SEP           0x00000800      // cpuid leaf 1 edx bit 11
+#define SYSENTER_EFLAGS     0x002           // only the reserved bit 1
+#define SYSENTER_USER_EFLAGS 0x202          // and IF, what user mode runs with
+
+// SEP is set but not usable on the first Pentium Pro steppings
+#define SEP_BAD_FAMILY      6
+#define SEP_BAD_MODEL       3
+#define SEP_BAD_STEPPING    3
+
+#ifndef ASM
+
+/* program the SYSENTER msrs of the boot cpu if it has SYSENTER */
+extern void init_sysenter();
+/* 1 if system calls can come in through sysenter_entry */
+extern uint32_t sysenter_enabled();
+
+// the entry point the SYSENTER_EIP msr holds
+extern void sysenter_entry();
+
+#endif /* ASM */
+
+#endif
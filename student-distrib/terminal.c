@@ -1,6 +1,15 @@
 #include "terminal.h"
+#include "scheduling.h"
+#include "work.h"
 
 volatile uint8_t terminal_running[MAX_TERMINAL_NUM] = {0,0,0};
+// readers of each terminal waiting for enter
+static wait_queue_t terminal_wait[MAX_TERMINAL_NUM];
+// loads the shell of each terminal in the work task
+static work_t shell_work[MAX_TERMINAL_NUM];
+
+/* the work function of shell_work */
+static void shell_start(uint32_t terminal_id);
 /* int32_t terminal_open(const uint8_t* filename)
  * Inputs: filename -- pointer to the name of the file
  * Return Value: 0 on success
@@ -23,24 +32,28 @@ extern int32_t terminal_close(int32_t fd){
  * Inputs: fd -- file discriptor
  *         buf -- buffer that stores the input string
  *         nbytes -- the number of bytes to be read
- * Return Value: number of bytes read
+ * Return Value: number of bytes read, -1 if a signal came first
  * Function: read the input from the user input
  */
 extern int32_t terminal_read(int32_t fd, void* buf, int32_t nbytes){
     int32_t i = 0;
+    uint32_t flags;
     pcb_t* pcb;
     pcb = get_curr_pcb();
-    // wait for enter signal
-    while(1){
-        if(enter_state != 0 && get_terminal_id(pcb->pid) == current_terminal){
-            break;
+    uint8_t tid = get_terminal_id(pcb->pid);
+
+    // sleep until enter is pressed on this terminal while it is shown
+    cli_and_save(flags);
+    while(enter_state == 0 || tid != current_terminal){
+        if(signal_pending(pcb) || sleep_on(&terminal_wait[tid]) == -1){
+            // a signal, it is delivered on the way back to the program
+            restore_flags(flags);
+            return -1;
         }
     }
-    uint8_t tid = get_terminal_id(pcb->pid);
-    printf("current tid: %d\n", tid);
-    cli();
     enter_state = 0;
-    sti();
+    restore_flags(flags);
+    printf("current tid: %d\n", tid);
 
     // copy content to buffer
     uint8_t* buf_cast_ptr = (uint8_t *)buf;
@@ -63,29 +76,32 @@ extern int32_t terminal_read(int32_t fd, void* buf, int32_t nbytes){
  */
 extern int32_t terminal_write(int32_t fd, const void* buf, int32_t nbytes){
     int32_t i = 0;
-
-    cli();
+    uint32_t flags;
 
     pcb_t* pcb = get_curr_pcb();
     uint8_t tid = get_terminal_id(pcb->pid);
     uint8_t* buf_cast_ptr = (uint8_t *)buf;
 
-    if(tid == current_terminal){
-        for(i = 0; i < nbytes; i++){
+    if(tid >= MAX_TERMINAL_NUM){
+        return -1;
+    }
+
+    // the write stays in one piece, but the keyboard echo and the timer
+    // only wait for one character, scrolling included
+    preempt_disable();
+    for(i = 0; i < nbytes; i++){
+        cli_and_save(flags);
+        // alt+Fx may switch terminals between two characters
+        if(tid == current_terminal){
             putc(buf_cast_ptr[i]);
             set_column_stack();
-        }
-    }else{
-        if(tid >= MAX_TERMINAL_NUM){
-            return -1;
-        }
-        for(i = 0; i < nbytes; i++){
+        }else{
             putc_terminal(buf_cast_ptr[i], tid);
+            terminal_info[tid].column_stack_old = terminal_info[tid].screen_pos_x;
         }
-        terminal_info[tid].column_stack_old = terminal_info[tid].screen_pos_x;
+        restore_flags(flags);
     }
-
-    sti();
+    preempt_enable();
 
     return i;
 }
@@ -98,13 +114,13 @@ extern int32_t terminal_write(int32_t fd, const void* buf, int32_t nbytes){
  *                  2. initialize the array which stores information of whether a terminal is running
  *                  3. initialize terminal_info
  *                  4. initialize the background color and text color
- *                  5. execute shell for the first terminal
+ *                  5. start the shell of the first terminal
  * Inputs: none
  * Return Value: none
  * Function: initialize the terminal
  */
 void init_terminal(){
-    int32_t i, j;
+    int32_t i;
     clear();
     key_arr = key_arr_all[0];
     for(i = 0; i < (KEY_ARR_SIZE + 1) * 3; i ++){
@@ -112,9 +128,7 @@ void init_terminal(){
     }
 
     for (i = 0; i < MAX_TERMINAL_NUM; i++) {
-        for (j = 0; j < MAX_TASK; j++) {
-            process_terminal[i][j] = 0;
-        }
+        process_terminal[i] = 0;
         process_terminal_cnt[i] = 0;
     }
 
@@ -129,6 +143,7 @@ void init_terminal(){
         terminal_info[i].row_stack_old = 0;
         terminal_info[i].column_stack_old = 0;
         terminal_info[i].key_arr_old[0] = '\0';
+        work_init(&shell_work[i], shell_start, i);
         current_terminal = i;
         if(i == 0){
             terminal_info[i].screen_buffer = (uint8_t*)TERMINAL_BUFFER_1;
@@ -143,9 +158,8 @@ void init_terminal(){
     current_terminal = 0;
     clear();
     copy_from_screen_buffer(terminal_info[0].screen_buffer);
-    sti();
     terminal_running[0] = 1;
-    execute((uint8_t*)"shell");
+    spawn_shell(0);
 
     return;
 }
@@ -154,7 +168,7 @@ void init_terminal(){
  * --------------------------------------------------------------------------------------
  * Descriptions:    This function is responsible for terminal switching
  *                  if the terminal we want to switch to is not running
- *                      it will do a context switch and execute shell program
+ *                      the work task starts a shell for it
  *                  if the terminal we want to switch is running
  *                      it will simply switch the terminal
  * Inputs:          uint8_t terminal_id :   the terminal's id, which can be 0 or 1 or 2
@@ -163,9 +177,8 @@ void init_terminal(){
  * Side Effects: Modefies the structure of terminal info
  */
 extern int32_t switch_to_terminal(uint8_t terminal_id){
-    cli();
-    pcb_t * old_pcb;
-    int32_t new_pid;
+    uint32_t flags;
+    pcb_t * pcb;
 
     // check if the terminal id is valid
     if(terminal_id >= MAX_TERMINAL_NUM){
@@ -177,49 +190,73 @@ extern int32_t switch_to_terminal(uint8_t terminal_id){
         return 0;
     }
 
+    cli_and_save(flags);
     // if the terminal we are switching to is not running
-    if(terminal_running[terminal_id] == 0){
-        if ((new_pid = get_pid()) == -1) {
-            printf("process number reaches maximum! Can't switch to new terminal!\n391OS> ");
-            return -1;
-        }
-        terminal_running[terminal_id] = 1;
-        save_terminal_info(current_terminal);
-        current_terminal = terminal_id;
-        //map_user_video();
-        clear();
-        restore_terminal_info(current_terminal);
-        old_pcb = get_curr_pcb();
-        //save the last esp and ebp
-
-        asm volatile(
-            "movl %%esp, %%eax;"
-            "movl %%ebp, %%ebx;"
-            : "=a" (old_pcb->schedule_esp), "=b" (old_pcb->schedule_ebp)
-        );
-        //printf("========>%x\n", old_pcb->pid);
-        //printf("========>%x\n", old_pcb->schedule_esp);
-        //printf("========>%x\n", old_pcb->schedule_ebp);
-
-        running_terminal = terminal_id;
-        sti();
-
-        // execute the new terminal!
-        execute((uint8_t*)"shell");
-        return 0;
+    if(terminal_running[terminal_id] == 0 && get_pid() == -1){
+        printf("process number reaches maximum! Can't switch to new terminal!\n391OS> ");
+        restore_flags(flags);
+        return -1;
     }
 
-
     save_terminal_info(current_terminal);
     current_terminal = terminal_id;
     //map_user_video();
     clear();
-
     restore_terminal_info(terminal_id);
-    sti();
+
+    // start the shell of a new terminal, it runs when the scheduler picks it
+    if(terminal_running[terminal_id] == 0){
+        terminal_start_shell(terminal_id);
+    }
+
+    // a reader of the shown terminal may have input now
+    terminal_wake(terminal_id);
+
+    // the task on the cpu may have just been shown or hidden, a kernel
+    // task gets the mapping of the next program when it switches to it
+    if((pcb = sched_current()) != NULL && !pcb->kthread){
+        map_user_video_to_buffer(pcb->terminal_id);
+    }
+    restore_flags(flags);
     return 0;
 }
 
+/* void terminal_wake(uint8_t terminal_id)
+ * Inputs: terminal_id -- the terminal whose readers are woken
+ * Return Value: none
+ * Function: let the processes blocked in terminal_read check for input
+ */
+void terminal_wake(uint8_t terminal_id){
+    if(terminal_id < MAX_TERMINAL_NUM){
+        wake_up_interactive(&terminal_wait[terminal_id]);
+    }
+}
+
+/* void terminal_start_shell(uint8_t terminal_id)
+ * --------------------------------------------------------------------------------------
+ * Descriptions:    Start a shell for a terminal that has none. Loading it may
+ *                  sleep on the swap disk, so it is left to the work task
+ *                  instead of the keyboard work or a halting process. The
+ *                  terminal counts as running from now on.
+ * Inputs:          uint8_t terminal_id :   the terminal's id, which can be 0 or 1 or 2
+ * Outputs:         None
+ * Side Effects:    Queues work
+ */
+void terminal_start_shell(uint8_t terminal_id){
+    if(terminal_id >= MAX_TERMINAL_NUM){
+        return;
+    }
+    terminal_running[terminal_id] = 1;
+    work_queue(&shell_work[terminal_id]);
+}
+
+static void shell_start(uint32_t terminal_id){
+    // out of pids or memory, the next switch to the terminal tries again
+    if(spawn_shell(terminal_id) == -1){
+        terminal_running[terminal_id] = 0;
+    }
+}
+
 /* int32_t save_terminal_info(uint8_t terminal_id)
  * --------------------------------------------------------------------------------------
  * Descriptions:    This funtion will save all the parameters of a terminal to
@@ -23,6 +23,8 @@ extern int32_t restore_terminal_info(uint8_t terminal_id);
 // Helper functions here
 void init_terminal();
 uint8_t is_running(uint8_t terminal_id);
+void terminal_wake(uint8_t terminal_id);
+void terminal_start_shell(uint8_t terminal_id);
 
 
 
@@ -6,6 +6,24 @@
 #include "rtc.h"
 #include "terminal.h"
 #include "filesystem.h"
+#include "frame.h"
+#include "process.h"
+#include "paging.h"
+#include "meminfo.h"
+#include "timer.h"
+#include "scheduling.h"
+#include "spinlock.h"
+#include "smp.h"
+#include "thread.h"
+#include "fpu.h"
+#include "work.h"
+#include "apic.h"
+#include "cpu_group.h"
+#include "shm.h"
+#include "trace.h"
+#include "sysenter.h"
+#include "swap.h"
+#include "loader.h"
 
 #define PASS 1
 #define FAIL 0
@@ -433,9 +451,1146 @@ void test_read_whole_file_by_index(uint32_t index){
 /* Checkpoint 4 tests */
 /* Checkpoint 5 tests */
 
+/* Memory management tests */
 
-/* Test suite entry point */
-void launch_tests(){
+/* int frame_alloc_test()
+ *
+ * Allocate two frames, share one of them and give everything back
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: None
+ * Coverage: frame pool, frame reference counts
+ * Files: frame.h/c
+ */
+int frame_alloc_test(){
+	TEST_HEADER;
+
+	uint32_t free_before = frame_free_count();
+	uint32_t a = frame_alloc();
+	uint32_t b = frame_alloc();
+	int result = PASS;
+
+	if (a == 0 || b == 0 || a == b)
+		return FAIL;
+	if (a < FRAME_POOL_START || (a & (FOUR_KB_SIZE - 1)) != 0)
+		result = FAIL;
+	if (frame_free_count() != free_before - 2)
+		result = FAIL;
+
+	// the kernel can write the frame through its physical address
+	*(uint32_t*)a = 0xECE391;
+	if (*(uint32_t*)a != 0xECE391)
+		result = FAIL;
+
+	// a shared frame survives the first put
+	frame_get(a);
+	frame_put(a);
+	if (frame_free_count() != free_before - 2)
+		result = FAIL;
+
+	frame_put(a);
+	frame_put(b);
+	if (frame_free_count() != free_before)
+		result = FAIL;
+
+	return result;
+}
+
+/* int pid_alloc_test()
+ *
+ * Reserve pids, create a process and give everything back
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: None
+ * Coverage: pid bitmap, kernel stack allocation
+ * Files: process.h/c
+ */
+int pid_alloc_test(){
+	TEST_HEADER;
+
+	uint32_t free_before = frame_free_count();
+	int32_t a = pid_alloc();
+	int32_t b = pid_alloc();
+	pcb_t* pcb;
+	int result = PASS;
+
+	if (a == -1 || b == -1 || a == b)
+		return FAIL;
+	// the lowest free pid is handed out again
+	pid_free(a);
+	if (pid_peek() != a)
+		result = FAIL;
+
+	// the pcb sits at the bottom of an 8KB aligned kernel stack
+	pcb = process_create(b);
+	if (pcb == NULL || get_pcb_by_index(b) != pcb)
+		result = FAIL;
+	if (pcb != NULL && ((uint32_t)pcb & (EIGHT_KB_SIZE - 1)) != 0)
+		result = FAIL;
+
+	process_destroy(b);
+	pid_free(b);
+	if (get_pcb_by_index(b) != NULL || frame_free_count() != free_before)
+		result = FAIL;
+
+	return result;
+}
+
+
+/* int zero_pool_test()
+ *
+ * Let the idle path zero a frame and take it back zeroed
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: None
+ * Coverage: pre-zeroed frame pool, hit counter
+ * Files: frame.h/c
+ */
+int zero_pool_test(){
+	TEST_HEADER;
+
+	uint32_t free_before = frame_free_count();
+	uint32_t hits = frame_zero_hits();
+	uint32_t frame;
+	uint32_t i;
+	int result = PASS;
+
+	frame_zero_idle();
+	// zeroed frames still count as free
+	if (frame_zeroed_count() == 0 || frame_free_count() != free_before)
+		return FAIL;
+
+	frame = frame_alloc_zeroed();
+	if (frame == 0 || frame_zero_hits() != hits + 1)
+		result = FAIL;
+	for (i = 0; frame != 0 && i < FOUR_KB_SIZE / 4; i++) {
+		if (((uint32_t*)frame)[i] != 0)
+			result = FAIL;
+	}
+
+	frame_put(frame);
+	return result;
+}
+
+/* int pte_access_test()
+ *
+ * Write entries into a scratch 4MB page table and read them back
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: None
+ * Coverage: page table accessors in both paging modes
+ * Files: paging.h/c
+ */
+int pte_access_test(){
+	TEST_HEADER;
+
+	uint32_t table = frame_alloc_block(table_size() / FOUR_KB_SIZE);
+	uint32_t i;
+	int result = PASS;
+
+	if (table == 0)
+		return FAIL;
+	if (table_size() != (paging_pae ? 2 * FOUR_KB_SIZE : FOUR_KB_SIZE))
+		result = FAIL;
+
+	for (i = 0; i < TABLE_SIZE; i++)
+		pte_write((void*)table, i, (i << FOUR_KB_OFFSET) | PRESENT_MASK);
+	// neighbouring entries must not overlap in either mode
+	for (i = 0; i < TABLE_SIZE; i++) {
+		if (pte_read((void*)table, i) != ((i << FOUR_KB_OFFSET) | PRESENT_MASK))
+			result = FAIL;
+	}
+	if (pte_ptr((void*)table, TABLE_SIZE - 1) >= (uint32_t*)(table + table_size()))
+		result = FAIL;
+
+	for (i = 0; i < table_size(); i += FOUR_KB_SIZE)
+		frame_put(table + i);
+	return result;
+}
+
+/* int meminfo_test()
+ *
+ * Create and destroy a process and check the charges follow
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: None
+ * Coverage: subsystem charges, per-process footprint
+ * Files: meminfo.h/c, process.h/c
+ */
+int meminfo_test(){
+	TEST_HEADER;
+
+	uint32_t kstack = mem_charged(MEM_KSTACK);
+	uint32_t tables = mem_charged(MEM_PAGE_TABLE);
+	int32_t pid = pid_alloc();
+	meminfo_proc_t usage;
+	int result = PASS;
+
+	if (pid == -1 || process_create(pid) == NULL)
+		return FAIL;
+
+	if (mem_charged(MEM_KSTACK) != kstack + KSTACK_FRAMES
+			|| mem_charged(MEM_PAGE_TABLE) != tables + 2 * table_size() / FOUR_KB_SIZE)
+		result = FAIL;
+	if (mem_process_usage(pid, &usage) == -1 || usage.resident_pages != 0
+			|| usage.kernel_pages != KSTACK_FRAMES + 2 * table_size() / FOUR_KB_SIZE)
+		result = FAIL;
+
+	process_destroy(pid);
+	pid_free(pid);
+	if (mem_charged(MEM_KSTACK) != kstack || mem_charged(MEM_PAGE_TABLE) != tables)
+		result = FAIL;
+	if (mem_process_usage(pid, &usage) != -1)
+		result = FAIL;
+	return result;
+}
+
+/* int timer_clock_test()
+ *
+ * Check the 64-bit division and that the clock moves forward
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: None
+ * Coverage: udiv64, timer_now_ms
+ * Files: lib.h/c, timer.h/c
+ */
+int timer_clock_test(){
+	TEST_HEADER;
+
+	uint32_t start = timer_now_ms();
+	uint32_t i;
+
+	if (udiv64(0x500000000ULL, 5) != 0x100000000ULL || udiv64(1000, 3) != 333)
+		return FAIL;
+	if (udiv64(0xFFFFFFFFFFFFFFFFULL, 0xFFFFFFFF) != 0x100000001ULL)
+		return FAIL;
+
+	// the clock never runs backwards, whatever the tick does
+	for (i = 0; i < CPU_CYCLE_PER_SEC; i++) {
+		if ((int32_t)(timer_now_ms() - start) < 0)
+			return FAIL;
+	}
+	return PASS;
+}
+
+/* int sched_class_test()
+ *
+ * Queue fake tasks in the prio and fair classes, unless a class is the
+ * one scheduling the real tasks, and check which one each picks
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: None
+ * Coverage: class enqueue, dequeue, pick_next, tick
+ * Files: sched_prio.c, sched_fair.c, scheduling.h/c
+ */
+int sched_class_test(){
+	TEST_HEADER;
+
+	static pcb_t low, high;
+	int result = PASS;
+	uint32_t flags;
+
+	low.state = high.state = TASK_RUNNABLE;
+	low.nice = NICE_MAX;
+	high.nice = NICE_MIN;
+	cli_and_save(flags);
+
+	if (strncmp(sched_class_name(), (int8_t*)"prio", 5) != 0) {
+		sched_prio_class.enqueue(&low);
+		sched_prio_class.enqueue(&high);
+		// the lower nice always wins, even after its tick
+		if (sched_prio_class.pick_next(NULL) != &high)
+			result = FAIL;
+		sched_prio_class.tick(&high);
+		if (sched_prio_class.pick_next(&high) != &high)
+			result = FAIL;
+		sched_prio_class.dequeue(&high);
+		if (sched_prio_class.pick_next(NULL) != &low)
+			result = FAIL;
+		sched_prio_class.dequeue(&low);
+		if (sched_prio_class.pick_next(NULL) != NULL)
+			result = FAIL;
+	}
+
+	if (strncmp(sched_class_name(), (int8_t*)"fair", 5) != 0) {
+		sched_fair_class.task_new(&low);
+		sched_fair_class.task_new(&high);
+		sched_fair_class.enqueue(&low);
+		sched_fair_class.enqueue(&high);
+		// a tick costs the nice task far more virtual runtime
+		sched_fair_class.tick(&low);
+		if (sched_fair_class.pick_next(&low) != &high)
+			result = FAIL;
+		sched_fair_class.tick(&high);
+		if (sched_fair_class.pick_next(&high) != &high)
+			result = FAIL;
+		sched_fair_class.dequeue(&low);
+		sched_fair_class.dequeue(&high);
+		if (sched_fair_class.pick_next(NULL) != NULL)
+			result = FAIL;
+	}
+
+	restore_flags(flags);
+	return result;
+}
+
+static uint32_t timer_fired;
+
+/* count the timers that fired, and check that they fire in order */
+static void timer_test_func(uint32_t data){
+	if (data == timer_fired)
+		timer_fired++;
+}
+
+/* int timer_list_test()
+ *
+ * Arm timers out of order and check the list keeps them sorted and
+ * only fires the due ones
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: None
+ * Coverage: timer_add, timer_del, timer_run, timer_next_deadline
+ * Files: timer.h/c
+ */
+int timer_list_test(){
+	TEST_HEADER;
+
+	ktimer_t late, early, due, later_due;
+	uint32_t now = timer_now_ms();
+	int result = PASS;
+	uint32_t flags;
+
+	cli_and_save(flags);
+	timer_fired = 0;
+	timer_add(&late, now + 200000, timer_test_func, 100);
+	timer_add(&early, now + 100000, timer_test_func, 100);
+	timer_add(&later_due, now - 1, timer_test_func, 1);
+	timer_add(&due, now - 2, timer_test_func, 0);
+
+	if ((int32_t)(timer_next_deadline() - (now - 2)) > 0)
+		result = FAIL;
+	timer_run();
+	if (timer_fired != 2 || due.pending || later_due.pending || !early.pending)
+		result = FAIL;
+
+	timer_del(&early);
+	timer_del(&late);
+	if (early.pending || late.pending)
+		result = FAIL;
+	timer_del(&due);
+	restore_flags(flags);
+	return result;
+}
+
+/* int smp_test()
+ *
+ * Take and release a spinlock, and check the cpu table is consistent
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: None
+ * Coverage: spin_lock, spin_unlock, smp_cpu_id, smp_online_count
+ * Files: spinlock.h, smp.h/c
+ */
+int smp_test(){
+	TEST_HEADER;
+
+	spinlock_t lock = SPINLOCK_INIT;
+	uint32_t flags;
+	int result = PASS;
+
+	spin_lock_irqsave(&lock, flags);
+	// let go of the lock before failing, the suite goes on with interrupts
+	if (!lock.locked)
+		result = FAIL;
+	spin_unlock_irqrestore(&lock, flags);
+	if (lock.locked || result == FAIL)
+		return FAIL;
+
+	// the boot cpu runs the tests and always counts as online
+	if (smp_online_count() < 1 || smp_online_count() > SMP_MAX_CPUS)
+		return FAIL;
+	if (cpu_count > 0 && (smp_cpu_id() >= cpu_count || !cpus[smp_cpu_id()].online))
+		return FAIL;
+	return PASS;
+}
+
+/* int preempt_test()
+ *
+ * Nest preempt_disable and check that preemption only comes back with
+ * the last preempt_enable
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: None
+ * Coverage: preempt_disable, preempt_enable, preemptible
+ * Files: scheduling.h/c
+ */
+int preempt_test(){
+	TEST_HEADER;
+
+	int result = PASS;
+
+	if (!preemptible())
+		return FAIL;
+	preempt_disable();
+	preempt_disable();
+	if (preemptible())
+		result = FAIL;
+	preempt_enable();
+	if (preemptible())
+		result = FAIL;
+	// both enables run whatever failed, the suite goes on preemptible
+	preempt_enable();
+	if (!preemptible())
+		result = FAIL;
+	return result;
+}
+
+/* int thread_stack_test()
+ *
+ * Check the user stacks of the threads sit below the stack of the process,
+ * apart from each other and above the largest text
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: None
+ * Coverage: THREAD_STACK_TOP, THREAD_STACK_BOTTOM
+ * Files: loader.h, thread.h/c
+ */
+int thread_stack_test(){
+	TEST_HEADER;
+
+	uint32_t slot;
+
+	if (THREAD_STACK_TOP(0) >= USER_STACK_BOTTOM)
+		return FAIL;
+	for (slot = 0; slot < THREAD_MAX; slot++) {
+		if (THREAD_STACK_BOTTOM(slot) >= THREAD_STACK_TOP(slot))
+			return FAIL;
+		// an unmapped guard page between two stacks
+		if (slot > 0 && THREAD_STACK_TOP(slot) + FOUR_KB_SIZE > THREAD_STACK_BOTTOM(slot - 1))
+			return FAIL;
+	}
+	if (THREAD_STACK_BOTTOM(THREAD_MAX - 1) < PROGRAM_OFFSET + TEXT_MAX_PAGES * FOUR_KB_SIZE)
+		return FAIL;
+	return PASS;
+}
+
+/* int fpu_test()
+ *
+ * Check the FPU is on with lazy switching, the save area of a real pcb is
+ * aligned the way FXSAVE needs, and the first FPU use of a task traps
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: None
+ * Coverage: init_fpu, fpu_trap
+ * Files: fpu.h/c, types.h
+ */
+int fpu_test(){
+	TEST_HEADER;
+
+	uint32_t cr0;
+	uint32_t traps = fpu_trap_count();
+	int32_t pid = pid_alloc();
+	pcb_t* pcb;
+	int result = PASS;
+
+	asm volatile("movl %%cr0, %0" : "=r" (cr0));
+	if ((cr0 & CR0_EM) || !(cr0 & CR0_MP))
+		result = FAIL;
+	if (sizeof(pcb_t) > EIGHT_KB_SIZE / 2)
+		result = FAIL;
+
+	// a scratch process, so the pcb sits where every pcb does
+	if (pid == -1 || (pcb = process_create(pid)) == NULL)
+		return FAIL;
+	if (((uint32_t)pcb->fpu_state & 0xF) != 0 || pcb->fpu_used)
+		result = FAIL;
+	process_destroy(pid);
+	pid_free(pid);
+
+	// the first FPU instruction of this task traps once and gives it a state
+	if (!sched_current()->fpu_used) {
+		asm volatile("fninit");
+		if (fpu_trap_count() != traps + 1 || !sched_current()->fpu_used)
+			result = FAIL;
+	}
+	return result;
+}
+
+
+static volatile uint32_t work_ran;
+static volatile uint32_t work_context_ok;
+static pcb_t* work_tester;
+
+/* count the work that ran, check it runs in the work task with interrupts
+ * on, and sleep data ms in it */
+static void work_test_func(uint32_t data){
+	uint32_t flags;
+	pcb_t* pcb = sched_current();
+
+	asm volatile("pushfl; popl %0" : "=r" (flags));
+	if (!(flags & EFLAGS_IF) || pcb == NULL || !pcb->kthread || pcb == work_tester)
+		work_context_ok = 0;
+	if (data != 0 && sleep(data) != 0)
+		work_context_ok = 0;
+	work_ran++;
+}
+
+/* sleep until count work items ran, or a second went by */
+static int work_wait_for(uint32_t count){
+	uint32_t i;
+
+	for (i = 0; i < 100 && work_ran < count; i++)
+		sleep(10);
+	return work_ran == count;
+}
+
+/* int work_test()
+ *
+ * Queue work items, one of them twice, and sleep until the work task ran
+ * each of them once. One of them sleeps itself, more than a budget is
+ * queued, and the rest still runs
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: None
+ * Coverage: init_work, work_init, work_queue, work_thread
+ * Files: work.h/c
+ */
+int work_test(){
+	TEST_HEADER;
+
+	static work_t works[WORK_BUDGET + 1];
+	uint32_t i;
+	uint32_t flags;
+	int result = PASS;
+
+	work_tester = sched_current();
+	work_ran = 0;
+	work_context_ok = 1;
+	for (i = 0; i < WORK_BUDGET + 1; i++)
+		work_init(&works[i], work_test_func, i == 1 ? 5 : 0);
+
+	// the work task cannot run before both are queued
+	cli_and_save(flags);
+	work_queue(&works[0]);
+	work_queue(&works[0]);
+	restore_flags(flags);
+	if (!work_wait_for(1) || works[0].pending)
+		result = FAIL;
+
+	// one more than a budget, the second blocks in the work task
+	work_ran = 0;
+	for (i = 0; i < WORK_BUDGET + 1; i++)
+		work_queue(&works[i]);
+	if (!work_wait_for(WORK_BUDGET + 1) || !work_context_ok)
+		result = FAIL;
+	for (i = 0; i < WORK_BUDGET + 1; i++) {
+		if (works[i].pending)
+			result = FAIL;
+	}
+	return result;
+}
+
+static wait_queue_t test_wait;
+static volatile uint32_t test_cond;
+static volatile uint32_t sleeper_done;
+static volatile int32_t sleeper_ret[2];
+
+/* sleep until pcb blocked, or a second went by */
+static int wait_blocked(pcb_t* pcb){
+	uint32_t i;
+
+	for (i = 0; i < 100 && pcb->state != TASK_BLOCKED; i++)
+		sleep(10);
+	return pcb->state == TASK_BLOCKED;
+}
+
+/* sleep until the sleeper task finished, or a second went by */
+static int wait_done(){
+	uint32_t i;
+
+	for (i = 0; i < 100 && !sleeper_done; i++)
+		sleep(10);
+	return sleeper_done;
+}
+
+/* sleep on test_wait until test_cond is set */
+static void wait_queue_sleeper(uint32_t data){
+	uint32_t flags;
+
+	cli_and_save(flags);
+	while (!test_cond) {
+		if ((sleeper_ret[0] = sleep_on(&test_wait)) == -1)
+			break;
+	}
+	restore_flags(flags);
+	sleeper_done = 1;
+}
+
+/* int wait_queue_test()
+ *
+ * Block a kernel task on a wait queue, wake it before its condition
+ * holds and check it sleeps again, then wake it for good
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: None
+ * Coverage: sleep_on, wake_up, kthread_create
+ * Files: scheduling.h/c
+ */
+int wait_queue_test(){
+	TEST_HEADER;
+
+	pcb_t* sleeper;
+	uint32_t flags;
+	int result = PASS;
+
+	test_cond = 0;
+	sleeper_done = 0;
+	sleeper_ret[0] = 0;
+	if ((sleeper = kthread_create((int8_t*)"wait_test", wait_queue_sleeper, 0, SCHED_NORMAL)) == NULL)
+		return FAIL;
+	if (!wait_blocked(sleeper))
+		result = FAIL;
+
+	// the condition does not hold yet, it goes back to sleep
+	cli_and_save(flags);
+	wake_up(&test_wait);
+	restore_flags(flags);
+	sleep(20);
+	if (sleeper_done || !wait_blocked(sleeper))
+		result = FAIL;
+
+	cli_and_save(flags);
+	test_cond = 1;
+	wake_up(&test_wait);
+	restore_flags(flags);
+	if (!wait_done() || sleeper_ret[0] != 0)
+		result = FAIL;
+	return result;
+}
+
+/* sleep twice, the process the task stands in a thread of halts meanwhile */
+static void thread_exit_sleeper(uint32_t data){
+	sleeper_ret[0] = sleep(1000);
+	// the process is still halting, this one does not block
+	sleeper_ret[1] = sleep(1000);
+	sleeper_done = 1;
+}
+
+/* int thread_exit_test()
+ *
+ * Let a kernel task stand in for a thread of a scratch process and block
+ * in sleep, then halt the process: the sleep gives up at once, and so
+ * does the next one. A real thread needs a user program the file system
+ * does not have
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: None
+ * Coverage: thread_group_exit, signal_pending, sleep
+ * Files: thread.h/c, syscall.c, scheduling.c
+ */
+int thread_exit_test(){
+	TEST_HEADER;
+
+	int32_t pid = pid_alloc();
+	pcb_t* proc;
+	pcb_t* thread;
+	uint32_t start;
+	uint32_t flags;
+	int result = PASS;
+
+	if (pid == -1 || (proc = process_create(pid)) == NULL)
+		return FAIL;
+	sleeper_done = 0;
+	sleeper_ret[0] = sleeper_ret[1] = 0;
+
+	// it joins the process before it first runs
+	cli_and_save(flags);
+	if ((thread = kthread_create((int8_t*)"thread_test", thread_exit_sleeper, 0, SCHED_NORMAL)) != NULL)
+		thread->leader = proc;
+	restore_flags(flags);
+	if (thread == NULL) {
+		process_destroy(pid);
+		pid_free(pid);
+		return FAIL;
+	}
+	if (!wait_blocked(thread))
+		result = FAIL;
+
+	start = timer_now_ms();
+	thread_group_exit(proc);
+	// not in the thread table, woken the way thread_group_exit wakes one
+	cli_and_save(flags);
+	if (!sleeper_done && thread->state == TASK_BLOCKED)
+		sched_wake(thread);
+	restore_flags(flags);
+	// the task still looks at the process until it is done
+	if (!wait_done())
+		return FAIL;
+	if (sleeper_ret[0] != -1 || sleeper_ret[1] != -1)
+		result = FAIL;
+	// well before either sleep would have run out
+	if (timer_now_ms() - start >= 1000)
+		result = FAIL;
+
+	process_destroy(pid);
+	pid_free(pid);
+	return result;
+}
+
+static volatile uint32_t swappers_done;
+
+/* evict one page, keep what swap_out returned in sleeper_ret[data] */
+static void swap_test_func(uint32_t data){
+	uint32_t flags;
+
+	sleeper_ret[data] = swap_out();
+	cli_and_save(flags);
+	swappers_done++;
+	restore_flags(flags);
+}
+
+/* int swap_test()
+ *
+ * Two kernel tasks evict a page each at the same time, so one of them
+ * waits for the disk. Then a page of a scratch process goes to swap and
+ * comes back with the same content. Without a swap disk nothing can be
+ * evicted
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: Pushes two pages of the running programs to swap
+ * Coverage: swap_out, swap_in_pcb, slot_io
+ * Files: swap.h/c, loader.c
+ */
+int swap_test(){
+	TEST_HEADER;
+
+	uint32_t vaddr = THREAD_STACK_BOTTOM(0);
+	uint32_t outs = swap_out_count();
+	uint32_t ins = swap_in_count();
+	uint32_t* page;
+	uint32_t pte;
+	uint32_t i;
+	uint32_t flags;
+	int32_t pid;
+	int result = PASS;
+
+	if (swap_total_slots() == 0)
+		return swap_out() == -1 ? PASS : FAIL;
+
+	// both are created before either runs
+	swappers_done = 0;
+	sleeper_ret[0] = sleeper_ret[1] = -1;
+	cli_and_save(flags);
+	for (i = 0; i < 2; i++) {
+		if (kthread_create((int8_t*)"swap_test", swap_test_func, i, SCHED_NORMAL) == NULL)
+			swappers_done++;
+	}
+	restore_flags(flags);
+	for (i = 0; i < 100 && swappers_done < 2; i++)
+		sleep(10);
+	if (swappers_done < 2 || sleeper_ret[0] != 0 || sleeper_ret[1] != 0 || swap_out_count() < outs + 2)
+		return FAIL;
+
+	if ((pid = pid_alloc()) == -1 || process_create(pid) == NULL)
+		return FAIL;
+	if (load_stack(pid, vaddr, vaddr + FOUR_KB_SIZE) == -1) {
+		process_destroy(pid);
+		pid_free(pid);
+		return FAIL;
+	}
+	page = (uint32_t*)(get_program_page(pid, vaddr) & FOUR_LB_PB_MASK);
+	for (i = 0; i < FOUR_KB_SIZE / sizeof(uint32_t); i++)
+		page[i] = i * 0x9E3779B9;
+
+	// the clock gets to the page within one eviction per user page
+	for (i = 0; i <= mem_charged(MEM_USER) && (get_program_page(pid, vaddr) & PRESENT_MASK); i++) {
+		if (swap_out() == -1)
+			break;
+	}
+	pte = get_program_page(pid, vaddr);
+	if ((pte & PRESENT_MASK) || !(pte & SWAPPED_MASK))
+		result = FAIL;
+
+	for (i = 0; i < 100 && !(get_program_page(pid, vaddr) & PRESENT_MASK); i++) {
+		if (swap_in_pcb(get_pcb_by_index(pid), vaddr) == -1)
+			break;
+	}
+	pte = get_program_page(pid, vaddr);
+	if (!(pte & PRESENT_MASK) || swap_in_count() < ins + 1) {
+		result = FAIL;
+	} else {
+		page = (uint32_t*)(pte & FOUR_LB_PB_MASK);
+		for (i = 0; i < FOUR_KB_SIZE / sizeof(uint32_t); i++) {
+			if (page[i] != i * 0x9E3779B9)
+				result = FAIL;
+		}
+	}
+
+	unload_stack(pid, vaddr, vaddr + FOUR_KB_SIZE);
+	process_destroy(pid);
+	pid_free(pid);
+	return result;
+}
+
+/* int apic_test()
+ *
+ * Check the keyboard line is routed to its vector by whichever
+ * interrupt controller the kernel picked
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: None
+ * Coverage: init_apic, ioapic_enable_irq, ioapic_irq_entry
+ * Files: apic.h/c, i8259.h/c
+ */
+int apic_test(){
+	TEST_HEADER;
+
+	uint32_t entry = ioapic_irq_entry(KEYBOARD_IRQ);
+
+	// with the 8259 the I/O APIC routes nothing
+	if (!apic_enabled())
+		return entry == IOAPIC_MASKED ? PASS : FAIL;
+
+	if (!(lapic_read(LAPIC_SVR) & LAPIC_SVR_ENABLE))
+		return FAIL;
+	if ((entry & IOAPIC_VECTOR_MASK) != IDT_KEYBOARD || (entry & IOAPIC_MASKED))
+		return FAIL;
+	return PASS;
+}
+
+/* int sched_rt_test()
+ *
+ * Check the real time class runs its tasks in order and a tick does not
+ * take the cpu away, only a yield does. The class is always in use, so
+ * the real tasks queued in it are set aside and put back afterwards
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: None
+ * Coverage: sched_rt_class
+ * Files: sched_rt.c
+ */
+int sched_rt_test(){
+	TEST_HEADER;
+
+	static pcb_t first, second;
+	pcb_t* real = NULL;
+	pcb_t* task;
+	int result = PASS;
+	uint32_t flags;
+
+	first.state = second.state = TASK_RUNNABLE;
+	first.policy = second.policy = SCHED_FIFO;
+	cli_and_save(flags);
+
+	// like the audio refill task, in the order they run
+	while ((task = sched_rt_class.pick_next(NULL)) != NULL) {
+		sched_rt_class.dequeue(task);
+		run_list_add(&real, task);
+	}
+
+	sched_rt_class.task_new(&first);
+	sched_rt_class.task_new(&second);
+	sched_rt_class.enqueue(&first);
+	sched_rt_class.enqueue(&second);
+	if (sched_rt_class.pick_next(NULL) != &first)
+		result = FAIL;
+	sched_rt_class.tick(&first);
+	if (sched_rt_class.pick_next(&first) != &first || sched_rt_class.preempt(&second, &first))
+		result = FAIL;
+	sched_rt_class.yield(&first);
+	if (sched_rt_class.pick_next(&first) != &second)
+		result = FAIL;
+	sched_rt_class.dequeue(&second);
+	if (sched_rt_class.pick_next(NULL) != &first)
+		result = FAIL;
+	sched_rt_class.dequeue(&first);
+	if (sched_rt_class.pick_next(NULL) != NULL)
+		result = FAIL;
+
+	while ((task = real) != NULL) {
+		run_list_remove(&real, task);
+		sched_rt_class.enqueue(task);
+	}
+	restore_flags(flags);
+	return result;
+}
+
+/* int cpu_group_test()
+ *
+ * Spin a millisecond at a time and charge it to a task of terminal 1, and
+ * check the terminal is throttled once the time it ran reaches its quota,
+ * and runs again once the quota goes back up
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: Charges some time to terminal 1
+ * Coverage: cpu_group_charge, cpu_group_throttled, cpu_quota
+ * Files: cpu_group.c
+ */
+int cpu_group_test(){
+	TEST_HEADER;
+
+	static pcb_t task;
+	int result = PASS;
+	uint32_t i;
+	uint32_t flags;
+	uint64_t until;
+
+	task.terminal_id = 1;
+	task.policy = SCHED_NORMAL;
+	if (cpu_quota(MAX_TERMINAL_NUM, GROUP_QUOTA_MAX) != -1 || cpu_quota(1, 0) != -1)
+		return FAIL;
+	cli_and_save(flags);
+
+	cpu_quota(1, GROUP_QUOTA_MIN);
+	cpu_group_charge(NULL);
+	// a new period may start in between, so allow for two of them; without
+	// a TSC every charge is a whole tick
+	for (i = 0; i < 2 * GROUP_PERIOD_MS; i++) {
+		until = timer_tsc() + timer_tsc_per_ms();
+		while (timer_tsc() < until);
+		if (cpu_group_charge(&task))
+			break;
+	}
+	if (i == 2 * GROUP_PERIOD_MS || !cpu_group_throttled(&task))
+		result = FAIL;
+	cpu_quota(1, GROUP_QUOTA_MAX);
+	if (cpu_group_throttled(&task))
+		result = FAIL;
+
+	restore_flags(flags);
+	return result;
+}
+
+/* int cpustat_test()
+ *
+ * Check the runtime of a task that is not on the cpu is what it was
+ * charged at its last switch, and the idle time never goes backwards
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: None
+ * Coverage: sched_runtime, sched_idle_time
+ * Files: scheduling.c
+ */
+int cpustat_test(){
+	TEST_HEADER;
+
+	static pcb_t task;
+	uint64_t idle;
+
+	task.runtime_tsc = 12345;
+	if (sched_runtime(&task) != 12345)
+		return FAIL;
+	idle = sched_idle_time();
+	if (sched_idle_time() < idle)
+		return FAIL;
+	return PASS;
+}
+
+static pcb_t* shm_test_proc;
+
+/* wait on the first word of the segment the scratch process maps at SHM_VIRTUAL */
+static void shm_test_waiter(uint32_t data){
+	sleeper_ret[0] = shm_wait_addr(shm_test_proc, SHM_VIRTUAL, 0);
+	sleeper_done = 1;
+}
+
+/* block a task on the word at SHM_VIRTUAL and wake it through second */
+static int shm_wait_block(uint32_t second){
+	uint32_t* word = (uint32_t*)(pte_read(shm_test_proc->shm_table, 0) & FOUR_LB_PB_MASK);
+	pcb_t* waiter;
+	int result = PASS;
+
+	// the word does not hold the value, no wait
+	if (shm_wait_addr(shm_test_proc, second, 1) != 0)
+		result = FAIL;
+
+	sleeper_done = 0;
+	sleeper_ret[0] = -1;
+	if ((waiter = kthread_create((int8_t*)"shm_test", shm_test_waiter, 0, SCHED_NORMAL)) == NULL) {
+		sleeper_done = 1;
+		return FAIL;
+	}
+	if (!wait_blocked(waiter) || sleeper_done)
+		result = FAIL;
+	*word = 1;
+	if (shm_wake_addr(shm_test_proc, second) != 0)
+		result = FAIL;
+	if (!wait_done() || sleeper_ret[0] != 0)
+		result = FAIL;
+	return result;
+}
+
+/* int shm_wait_test()
+ *
+ * Check shm_wait and shm_wake refuse a word outside the shared memory
+ * window or not aligned. Then a kernel task blocks on a word of a segment
+ * a scratch process maps twice, and a wake through the other mapping
+ * lets it go
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: None
+ * Coverage: shm_wait, shm_wake, shm_wait_addr, shm_wake_addr
+ * Files: shm.h/c
+ */
+int shm_wait_test(){
+	TEST_HEADER;
+
+	uint32_t second = SHM_VIRTUAL + 2 * FOUR_KB_SIZE;
+	int32_t pid;
+	int32_t shmid;
+	int result = PASS;
+
+	if (shm_wait((uint32_t*)_128_MB_SIZE, 0) != -1)
+		return FAIL;
+	if (shm_wake((uint32_t*)(SHM_VIRTUAL + 2)) != -1)
+		return FAIL;
+	if (shm_wake((uint32_t*)SHM_VIRTUAL_END) != -1)
+		return FAIL;
+
+	if ((pid = pid_alloc()) == -1 || (shm_test_proc = process_create(pid)) == NULL)
+		return FAIL;
+	shm_init_pcb(shm_test_proc);
+	sleeper_done = 1;
+	if ((shmid = shmget(0x5EED, FOUR_KB_SIZE)) == -1
+			|| shm_attach(shm_test_proc, shmid, SHM_VIRTUAL) != SHM_VIRTUAL
+			|| shm_attach(shm_test_proc, shmid, second) != (int32_t)second)
+		result = FAIL;
+	else
+		result = shm_wait_block(second);
+	// a waiter that never woke still uses the mapping
+	if (!sleeper_done)
+		return FAIL;
+
+	shm_release(shm_test_proc);
+	process_destroy(pid);
+	pid_free(pid);
+	return result;
+}
+
+/* int shm_refcount_test()
+ *
+ * Attach a segment twice to a scratch process and check it lives until
+ * the last detach, which gives its frames back
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: None
+ * Coverage: shmget, shm_attach, shm_detach_addr, shm_release
+ * Files: shm.h/c
+ */
+int shm_refcount_test(){
+	TEST_HEADER;
+
+	uint32_t free_before = frame_free_count();
+	uint32_t charged = mem_charged(MEM_SHM);
+	uint32_t second = SHM_VIRTUAL + 2 * FOUR_KB_SIZE;
+	int32_t pid = pid_alloc();
+	int32_t shmid;
+	pcb_t* pcb;
+	int result = PASS;
+
+	if (pid == -1 || (pcb = process_create(pid)) == NULL)
+		return FAIL;
+	shm_init_pcb(pcb);
+
+	shmid = shmget(0x7E57, 2 * FOUR_KB_SIZE);
+	if (shmid == -1 || mem_charged(MEM_SHM) != charged + 2)
+		result = FAIL;
+	// the same key finds the same segment, a larger size does not fit it
+	if (shmget(0x7E57, FOUR_KB_SIZE) != shmid || shmget(0x7E57, 3 * FOUR_KB_SIZE) != -1)
+		result = FAIL;
+	if (shm_attach(pcb, shmid, SHM_VIRTUAL) != SHM_VIRTUAL
+			|| shm_attach(pcb, shmid, second) != (int32_t)second)
+		result = FAIL;
+	// a mapping may not overlap another one
+	if (shm_attach(pcb, shmid, SHM_VIRTUAL + FOUR_KB_SIZE) != -1)
+		result = FAIL;
+
+	// one mapping left, the frames stay
+	if (shm_detach_addr(pcb, SHM_VIRTUAL) != 0 || shm_page_present(pid, SHM_VIRTUAL)
+			|| !shm_page_present(pid, second) || mem_charged(MEM_SHM) != charged + 2)
+		result = FAIL;
+	if (shm_detach_addr(pcb, SHM_VIRTUAL) != -1)
+		result = FAIL;
+	// the last detach frees the segment
+	if (shm_detach_addr(pcb, second) != 0 || mem_charged(MEM_SHM) != charged)
+		result = FAIL;
+	if (shm_attach(pcb, shmid, SHM_VIRTUAL) != -1)
+		result = FAIL;
+
+	shm_release(pcb);
+	process_destroy(pid);
+	pid_free(pid);
+	if (frame_free_count() != free_before)
+		result = FAIL;
+	return result;
+}
+
+/* int wakeup_trace_test()
+ *
+ * Check a wakeup followed by the switch to the woken task is measured,
+ * and the worst case trace starts with the wakeup and ends with the switch
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: Resets the wakeup latency figures
+ * Coverage: trace_wake, trace_switch, trace_read
+ * Files: trace.c
+ */
+int wakeup_trace_test(){
+	TEST_HEADER;
+
+	static pcb_t task;
+	static wakeup_trace_t trace;
+	int result = PASS;
+	uint32_t flags;
+
+	// the tracer needs the TSC
+	if (timer_tsc_per_ms() == 0)
+		return PASS;
+	task.pid = 7;
+	cli_and_save(flags);
+
+	trace_read(&trace, 1);
+	trace_wake(&task);
+	trace_tick(NULL);
+	trace_switch(NULL, &task);
+	trace_read(&trace, 1);
+	if (trace.count != 1 || trace.max_pid != 7 || task.wake_tsc != 0)
+		result = FAIL;
+	if (trace.worst_len != 3 || trace.worst[0].type != TRACE_WAKE
+			|| trace.worst[2].type != TRACE_SWITCH || trace.worst[2].arg != TRACE_PID_IDLE)
+		result = FAIL;
+
+	restore_flags(flags);
+	return result;
+}
+
+/* int sysenter_test()
+ *
+ * Check the SYSENTER msrs point at the kernel code segment, tss.esp0 and
+ * sysenter_entry when the fast path is enabled
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: None
+ * Coverage: init_sysenter
+ * Files: sysenter.c
+ */
+int sysenter_test(){
+	TEST_HEADER;
+
+	uint32_t cs, esp, eip, high;
+
+	if (!sysenter_enabled())
+		return PASS;
+	asm volatile("rdmsr" : "=a" (cs), "=d" (high) : "c" (MSR_SYSENTER_CS));
+	asm volatile("rdmsr" : "=a" (esp), "=d" (high) : "c" (MSR_SYSENTER_ESP));
+	asm volatile("rdmsr" : "=a" (eip), "=d" (high) : "c" (MSR_SYSENTER_EIP));
+	if (cs != KERNEL_CS || esp != (uint32_t)&tss.esp0 || eip != (uint32_t)sysenter_entry)
+		return FAIL;
+	return PASS;
+}
+
+/* Test suite, in a kernel task so a test can block and be woken */
+static void test_task(uint32_t data){
 	/* 3.1 tests */
 
 	// TEST_OUTPUT("idt_test", idt_test());
@@ -496,4 +1651,36 @@ void launch_tests(){
 	/* 3.3 tests */
 	/* 3.4 tests */
 	/* 3.5 tests */
+
+	/* memory management tests */
+	TEST_OUTPUT("frame_alloc_test", frame_alloc_test());
+	TEST_OUTPUT("pid_alloc_test", pid_alloc_test());
+	TEST_OUTPUT("pte_access_test", pte_access_test());
+	TEST_OUTPUT("zero_pool_test", zero_pool_test());
+	TEST_OUTPUT("meminfo_test", meminfo_test());
+	TEST_OUTPUT("timer_clock_test", timer_clock_test());
+	TEST_OUTPUT("sched_class_test", sched_class_test());
+	TEST_OUTPUT("timer_list_test", timer_list_test());
+	TEST_OUTPUT("smp_test", smp_test());
+	TEST_OUTPUT("preempt_test", preempt_test());
+	TEST_OUTPUT("thread_stack_test", thread_stack_test());
+	TEST_OUTPUT("fpu_test", fpu_test());
+	TEST_OUTPUT("work_test", work_test());
+	TEST_OUTPUT("wait_queue_test", wait_queue_test());
+	TEST_OUTPUT("thread_exit_test", thread_exit_test());
+	TEST_OUTPUT("swap_test", swap_test());
+	TEST_OUTPUT("apic_test", apic_test());
+	TEST_OUTPUT("sched_rt_test", sched_rt_test());
+	TEST_OUTPUT("cpu_group_test", cpu_group_test());
+	TEST_OUTPUT("cpustat_test", cpustat_test());
+	TEST_OUTPUT("shm_wait_test", shm_wait_test());
+	TEST_OUTPUT("shm_refcount_test", shm_refcount_test());
+	TEST_OUTPUT("wakeup_trace_test", wakeup_trace_test());
+	TEST_OUTPUT("sysenter_test", sysenter_test());
+}
+
+/* Test suite entry point */
+void launch_tests(){
+	if (kthread_create((int8_t*)"tests", test_task, 0, SCHED_NORMAL) == NULL)
+		printf("[TEST] no memory for the test task\n");
 }
@@ -0,0 +1,233 @@
+#include "thread.h"
+#include "scheduling.h"
+#include "syscall.h"
+
+/* wake the tasks of proc that join the thread tid */
+static void wake_joiners(pcb_t* proc, uint32_t tid);
+/* number of threads of proc that did not halt yet */
+static uint32_t thread_live_count(pcb_t* proc);
+
+/*
+ * Function:  int32_t thread_create(uint32_t entry, uint32_t func, uint32_t arg)
+ * --------------------
+ * This function starts a thread of the calling process. The thread gets a
+ * pid, a kernel stack and a user stack of its own and shares the rest
+ * with the process. It enters user mode at entry with func on top of its
+ * stack and arg below; the library passes a stub as entry that calls
+ * func(arg) and halts with its return value.
+ *
+ *  Inputs:     uint32_t entry: user address the thread starts at
+ *              uint32_t func: pushed for entry
+ *              uint32_t arg: pushed for entry
+ *
+ *  Returns:    -1: bad entry, no free slot, pid or memory
+ *              tid: the pid of the new thread
+ *
+ *  Side effects: maps the user stack of the thread, the thread is runnable
+ *
+ */
+int32_t thread_create(uint32_t entry, uint32_t func, uint32_t arg) {
+    pcb_t * curr = get_curr_pcb();
+    pcb_t * proc = get_curr_proc();
+    pcb_t * pcb;
+    thread_slot_t * t;
+    int32_t pid;
+    uint32_t slot;
+    uint32_t* sp;
+    uint32_t flags;
+
+    if (entry < _128_MB_SIZE || entry >= _128_MB_SIZE + FOUR_MB_SIZE)
+        return -1;
+
+    // claim a slot first, creating the thread may sleep
+    cli_and_save(flags);
+    for (slot = 0; slot < THREAD_MAX && proc->threads[slot].state != THREAD_FREE; slot++);
+    if (slot == THREAD_MAX || proc->exiting) {
+        restore_flags(flags);
+        return -1;
+    }
+    t = &proc->threads[slot];
+    t->state = THREAD_RUNNING;
+    t->pid = NO_PID;
+    restore_flags(flags);
+
+    pcb = NULL;
+    if ((pid = pid_alloc()) == -1
+            || (pcb = thread_alloc(pid, proc)) == NULL
+            || load_stack(proc->pid, THREAD_STACK_BOTTOM(slot), THREAD_STACK_TOP(slot)) == -1) {
+        if (pcb != NULL)
+            process_destroy(pid);
+        if (pid != -1)
+            pid_free(pid);
+        cli_and_save(flags);
+        t->state = THREAD_FREE;
+        // a halting process may be waiting for this slot
+        if (proc->exiting)
+            sched_wake(proc);
+        restore_flags(flags);
+        return -1;
+    }
+
+    pcb->parent_pid = proc->pid;
+    pcb->terminal_id = curr->terminal_id;
+    pcb->background = curr->background;
+    pcb->nice = curr->nice;
+    pcb->wait_pid = NO_PID;
+    pcb->pending_signal = NO_SIGNAL;
+    pcb->sighandler = curr->sighandler;
+    pcb->text_id = NO_TEXT;
+    pcb->thread_slot = slot;
+    shm_init_pcb(pcb);
+    strncpy((int8_t*)pcb->argument, (int8_t*)proc->argument, ARG_MAX);
+    strncpy((int8_t*)pcb->name, (int8_t*)proc->name, PROC_NAME_LEN);
+
+    // the program page of the process is mapped, so the stack is written in place
+    sp = (uint32_t*)THREAD_STACK_TOP(slot);
+    *--sp = arg;
+    *--sp = func;
+    sched_prepare(pcb, entry, (uint32_t)sp);
+
+    t->pid = pid;
+    t->status = 0;
+    sched_wake(pcb);
+    return pid;
+}
+
+/*
+ * Function:  int32_t thread_join(int32_t tid)
+ * --------------------
+ * This function waits for a thread of the same process to halt and frees
+ * its slot. Any task of the process may join any thread but itself, and
+ * each thread is joined once.
+ *
+ *  Inputs:     int32_t tid: the pid thread_create returned
+ *
+ *  Returns:    -1: no such thread, or a signal came first
+ *              status: what the thread passed to halt, 256 for an exception
+ *
+ *  Side effects: blocks the caller
+ *
+ */
+int32_t thread_join(int32_t tid) {
+    pcb_t * pcb = get_curr_pcb();
+    pcb_t * proc = get_curr_proc();
+    thread_slot_t * t = NULL;
+    uint32_t slot;
+    int32_t status;
+    uint32_t flags;
+
+    cli_and_save(flags);
+    for (slot = 0; slot < THREAD_MAX; slot++) {
+        if (proc->threads[slot].state != THREAD_FREE && proc->threads[slot].pid == (uint32_t)tid) {
+            t = &proc->threads[slot];
+            break;
+        }
+    }
+    if (t == NULL || (uint32_t)tid == pcb->pid) {
+        restore_flags(flags);
+        return -1;
+    }
+
+    // thread_exit wakes whoever waits for its pid
+    pcb->wait_pid = tid;
+    while (t->state == THREAD_RUNNING && !signal_pending(pcb))
+        sched_block();
+    pcb->wait_pid = NO_PID;
+
+    // another task may have joined it first
+    if (t->state != THREAD_EXITED || t->pid != (uint32_t)tid) {
+        restore_flags(flags);
+        return -1;
+    }
+    status = t->status;
+    t->state = THREAD_FREE;
+    restore_flags(flags);
+    return status;
+}
+
+/* void thread_exit(uint8_t status)
+ * --------------------------------------------------------------------------------------
+ * Descriptions:    What halt does for a thread: free its user stack, leave its
+ *                  status for thread_join and give the cpu away for good. The
+ *                  files and memory of the process stay.
+ * Inputs:          uint8_t status :    the halt status
+ * Outputs:         never returns
+ * Side Effects:    Frees the pid and the kernel stack of the thread
+ */
+void thread_exit(uint8_t status) {
+    pcb_t * pcb = get_curr_pcb();
+    pcb_t * proc = pcb->leader;
+    thread_slot_t * t = &proc->threads[pcb->thread_slot];
+
+    // free the stack with interrupts on
+    unload_stack(proc->pid, THREAD_STACK_BOTTOM(pcb->thread_slot), THREAD_STACK_TOP(pcb->thread_slot));
+
+    cli();
+    t->status = (status == EXCEPTION_MAGIC) ? EXCEPTION_RET : status;
+    t->state = THREAD_EXITED;
+    wake_joiners(proc, pcb->pid);
+    // a halting process waits for the last of its threads
+    if (proc->exiting)
+        sched_wake(proc);
+
+    sched_exit();
+    process_destroy(pcb->pid);
+    pid_free(pcb->pid);
+
+    schedule();
+}
+
+/* void thread_group_exit(pcb_t* proc)
+ * --------------------------------------------------------------------------------------
+ * Descriptions:    Called by halt of a process before it frees anything the
+ *                  threads use. Every thread halts on its way back to user
+ *                  mode, whatever handler it has. A blocked thread is woken
+ *                  and its system call gives up as for a signal. Returns
+ *                  once the last one is gone.
+ * Inputs:          pcb_t* proc :   the halting process
+ * Outputs:         None
+ * Side Effects:    Blocks the caller
+ */
+void thread_group_exit(pcb_t* proc) {
+    pcb_t * pcb;
+    uint32_t slot;
+    uint32_t flags;
+
+    cli_and_save(flags);
+    // not a signal, that would replace one the thread has not taken yet
+    proc->exiting = 1;
+    for (slot = 0; slot < THREAD_MAX; slot++) {
+        if (proc->threads[slot].state == THREAD_RUNNING
+                && (pcb = get_pcb_by_index(proc->threads[slot].pid)) != NULL
+                && pcb->state == TASK_BLOCKED)
+            sched_wake(pcb);
+    }
+    while (thread_live_count(proc) > 0)
+        sched_block();
+    restore_flags(flags);
+}
+
+static void wake_joiners(pcb_t* proc, uint32_t tid) {
+    pcb_t * pcb;
+    uint32_t slot;
+
+    if (proc->wait_pid == tid)
+        sched_wake(proc);
+    for (slot = 0; slot < THREAD_MAX; slot++) {
+        if (proc->threads[slot].state == THREAD_RUNNING
+                && (pcb = get_pcb_by_index(proc->threads[slot].pid)) != NULL
+                && pcb->wait_pid == tid)
+            sched_wake(pcb);
+    }
+}
+
+static uint32_t thread_live_count(pcb_t* proc) {
+    uint32_t slot;
+    uint32_t count = 0;
+
+    for (slot = 0; slot < THREAD_MAX; slot++) {
+        if (proc->threads[slot].state == THREAD_RUNNING)
+            count++;
+    }
+    return count;
+}
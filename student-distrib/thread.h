@@ -0,0 +1,31 @@
+#ifndef THREAD_H
+#define THREAD_H
+
+#include "types.h"
+#include "lib.h"
+#include "process.h"
+#include "loader.h"
+
+/*
+ * A thread is a task with its own pid, kernel stack and user stack that
+ * runs in the program page of its process. It shares the page tables,
+ * files and shared memory of the process, which is the leader the pcb of
+ * the thread points at. The user stack of a thread is the slot below the
+ * stack of the process that matches its index in the threads of the
+ * leader. Halting a thread only ends the thread; halting the process
+ * halts its threads first.
+ */
+#define THREAD_FREE         0
+#define THREAD_RUNNING      1
+#define THREAD_EXITED       2           // halted, its status waits for thread_join
+
+/* system call: start a thread at entry, with func and arg on its stack */
+extern int32_t thread_create(uint32_t entry, uint32_t func, uint32_t arg);
+/* system call: wait for a thread of the same process to halt */
+extern int32_t thread_join(int32_t tid);
+/* halt the calling thread, never returns */
+extern void thread_exit(uint8_t status);
+/* halt the threads of a halting process and wait for them */
+extern void thread_group_exit(pcb_t* proc);
+
+#endif
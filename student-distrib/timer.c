@@ -0,0 +1,349 @@
+#include "timer.h"
+#include "apic.h"
+
+// periodic tick rate and the divisor that produces it
+static uint32_t tick_hz = 0;
+static uint32_t tick_divisor = 0;
+static uint32_t tick_mode = TICK_STOPPED;
+// local APIC timer counts per millisecond and per tick, 0 when the PIT ticks
+static uint32_t lapic_per_ms = 0;
+static uint32_t lapic_tick_count = 0;
+// interrupts seen, the clock when there is no TSC
+static uint32_t tick_count = 0;
+// TSC cycles per millisecond and the TSC at boot, 0 without a TSC
+static uint32_t tsc_per_ms = 0;
+static uint64_t tsc_boot = 0;
+// armed timers, the earliest first
+static ktimer_t* timer_list = NULL;
+
+/* measure the TSC against a one shot of PIT channel 2 */
+static void calibrate_tsc();
+/* load channel 0 with a mode and a count */
+static void pit_program(uint8_t mode, uint32_t count);
+/* start the tick at tick_hz */
+static void tick_start_periodic();
+/* fire the tick once after left milliseconds */
+static void tick_start_oneshot(int32_t left);
+/* no tick until it is started again */
+static void tick_stop();
+
+/* void init_pit(uint32_t frequency)
+ * --------------------------------------------------------------------------------------
+ * Descriptions:    This function will initialize pit, after measuring the TSC
+ *                  with it so the clock survives a stopped tick. With the
+ *                  APICs on, the local APIC timer measured against the TSC
+ *                  ticks instead, one shot at a time on the PIT vector, and
+ *                  frequency is not limited by the PIT divisor.
+ * Inputs:          uint32_t frequency :    The frequency you want
+ * Outputs:         None
+ * Side Effects:    None
+ */
+void init_pit(uint32_t frequency) {
+    calibrate_tsc();
+
+    tick_hz = frequency;
+    tick_divisor = PIT_CONST / frequency;
+    lapic_per_ms = lapic_timer_calibrate();
+    lapic_tick_count = (uint32_t)udiv64((uint64_t)lapic_per_ms * 1000, frequency);
+    tick_start_periodic();
+    tick_mode = TICK_PERIODIC;
+}
+
+/* void timer_tick()
+ * Inputs: none
+ * Return Value: none
+ * Function: count a tick interrupt and arm the next local APIC one shot;
+ *           a one shot of the idle loop fires only once
+ */
+void timer_tick() {
+    if (tick_mode == TICK_PERIODIC) {
+        tick_count++;
+        if (lapic_per_ms != 0)
+            lapic_timer_oneshot(lapic_tick_count);
+    }
+}
+
+/* uint32_t timer_now_ms()
+ * Inputs: none
+ * Return Value: milliseconds since init_pit, wraps after 49 days
+ * Function: read the clock
+ */
+uint32_t timer_now_ms() {
+    if (tsc_per_ms == 0)
+        return tick_hz == 0 ? 0 : tick_count * (1000 / tick_hz);
+    return (uint32_t)udiv64(timer_tsc() - tsc_boot, tsc_per_ms);
+}
+
+/* uint32_t timer_tick_us()
+ * Inputs: none
+ * Return Value: microseconds between two periodic ticks, 0 before init_pit
+ * Function: what one tick charges to the task it hit
+ */
+uint32_t timer_tick_us() {
+    return tick_hz == 0 ? 0 : 1000000 / tick_hz;
+}
+
+/* uint64_t timer_tsc()
+ * Inputs: none
+ * Return Value: the time stamp counter, 0 without a TSC
+ * Function: read the cycle counter
+ */
+uint64_t timer_tsc() {
+    uint64_t tsc;
+
+    if (tsc_per_ms == 0)
+        return 0;
+    asm volatile("rdtsc" : "=A" (tsc));
+    return tsc;
+}
+
+/* uint32_t timer_tsc_per_ms()
+ * Inputs: none
+ * Return Value: TSC cycles per millisecond, 0 without a TSC
+ * Function: scale for timer_tsc
+ */
+uint32_t timer_tsc_per_ms() {
+    return tsc_per_ms;
+}
+
+/* void timer_udelay(uint32_t us)
+ * Inputs: us -- microseconds to wait, up to a few seconds
+ * Return Value: none
+ * Function: spin on the TSC, or on a rough loop count without one
+ */
+void timer_udelay(uint32_t us) {
+    uint64_t end;
+    volatile uint32_t spin;
+
+    if (tsc_per_ms == 0) {
+        for (spin = 0; spin < us * (CPU_CYCLE_PER_SEC / 1000000); spin++);
+        return;
+    }
+    end = timer_tsc() + udiv64((uint64_t)us * tsc_per_ms, 1000);
+    while (timer_tsc() < end)
+        asm volatile("pause");
+}
+
+/* void timer_idle(uint32_t deadline)
+ * --------------------------------------------------------------------------------------
+ * Descriptions:    Called by the idle loop with interrupts disabled, right
+ *                  before hlt. With no deadline the tick stops; otherwise
+ *                  it fires once when the deadline is due, or after the
+ *                  longest one shot the timer can count, and the idle loop
+ *                  arms it again. Keeps ticking when there is no TSC to
+ *                  measure the time spent asleep. The tick turns periodic
+ *                  again through timer_resume before a task runs.
+ * Inputs:          uint32_t deadline : timer_now_ms time to wake at,
+ *                                      or TIMER_NO_DEADLINE
+ * Outputs:         None
+ * Side Effects:    Reprograms the tick
+ */
+void timer_idle(uint32_t deadline) {
+    if (tsc_per_ms == 0 || tick_hz == 0)
+        return;
+
+    if (deadline == TIMER_NO_DEADLINE) {
+        if (tick_mode != TICK_STOPPED) {
+            tick_stop();
+            tick_mode = TICK_STOPPED;
+        }
+        return;
+    }
+
+    tick_start_oneshot((int32_t)(deadline - timer_now_ms()));
+    tick_mode = TICK_ONESHOT;
+}
+
+/* void timer_resume()
+ * Inputs: none
+ * Return Value: none
+ * Function: restart the periodic tick after timer_idle, a task is runnable
+ */
+void timer_resume() {
+    uint32_t flags;
+
+    cli_and_save(flags);
+    if (tick_mode != TICK_PERIODIC) {
+        tick_start_periodic();
+        tick_mode = TICK_PERIODIC;
+    }
+    restore_flags(flags);
+}
+
+/* uint32_t timer_tick_mode()
+ * Inputs: none
+ * Return Value: TICK_PERIODIC, TICK_ONESHOT or TICK_STOPPED
+ * Function: tell whether the tick runs
+ */
+uint32_t timer_tick_mode() {
+    return tick_mode;
+}
+
+/* void timer_add(ktimer_t* timer, uint32_t expires, void (*func)(uint32_t), uint32_t data)
+ * --------------------------------------------------------------------------------------
+ * Descriptions:    Insert a timer into the sorted timer list. It fires at
+ *                  the first tick at or after expires, or right at it when
+ *                  the cpu is idle, and is off the list when func runs.
+ * Inputs:          ktimer_t* timer :       the timer, not armed yet
+ *                  uint32_t expires :      timer_now_ms time to fire at
+ *                  void (*func)(uint32_t): the callback, runs with interrupts off
+ *                  uint32_t data :         argument of func
+ * Outputs:         None
+ * Side Effects:    Changing the timer list
+ */
+void timer_add(ktimer_t* timer, uint32_t expires, void (*func)(uint32_t), uint32_t data) {
+    ktimer_t ** link;
+    uint32_t flags;
+
+    timer->expires = expires;
+    timer->func = func;
+    timer->data = data;
+
+    cli_and_save(flags);
+    // behind every timer due at the same time, so equal timers fire in order
+    for (link = &timer_list; *link != NULL; link = &(*link)->next) {
+        if ((int32_t)(expires - (*link)->expires) < 0)
+            break;
+    }
+    timer->next = *link;
+    *link = timer;
+    timer->pending = 1;
+    restore_flags(flags);
+}
+
+/* void timer_del(ktimer_t* timer)
+ * Inputs: timer -- an armed or fired timer
+ * Return Value: none
+ * Function: take the timer off the list if it did not fire yet
+ */
+void timer_del(ktimer_t* timer) {
+    ktimer_t ** link;
+    uint32_t flags;
+
+    cli_and_save(flags);
+    if (timer->pending) {
+        for (link = &timer_list; *link != NULL; link = &(*link)->next) {
+            if (*link == timer) {
+                *link = timer->next;
+                break;
+            }
+        }
+        timer->pending = 0;
+    }
+    restore_flags(flags);
+}
+
+/* void timer_run()
+ * Inputs: none
+ * Return Value: none
+ * Function: fire every timer whose time has come
+ */
+void timer_run() {
+    ktimer_t * timer;
+    uint32_t now = timer_now_ms();
+    uint32_t flags;
+
+    cli_and_save(flags);
+    while ((timer = timer_list) != NULL && (int32_t)(now - timer->expires) >= 0) {
+        timer_list = timer->next;
+        timer->pending = 0;
+        timer->func(timer->data);
+    }
+    restore_flags(flags);
+}
+
+/* uint32_t timer_next_deadline()
+ * Inputs: none
+ * Return Value: when the earliest timer fires, TIMER_NO_DEADLINE if none
+ * Function: tell the idle loop how long the tick may stay off
+ */
+uint32_t timer_next_deadline() {
+    return timer_list != NULL ? timer_list->expires : TIMER_NO_DEADLINE;
+}
+
+static void calibrate_tsc() {
+    uint32_t features;
+    uint32_t count = TSC_CALIBRATE_MS * PIT_CYCLES_PER_MS;
+    uint32_t spins = 0;
+    uint8_t gate;
+    uint64_t start;
+    uint64_t end;
+
+    // cpuid leaf 1 reports the TSC in bit 4 of edx
+    asm volatile(
+        "movl $1, %%eax                     ;"
+        "cpuid                              ;"
+        : "=d" (features)
+        :
+        : "eax", "ebx", "ecx");
+    if (!(features & CPUID_TSC))
+        return;
+
+    // gate channel 2 on with the speaker off, its output rises at zero
+    gate = inb(PIT_GATE_PORT);
+    outb((gate & ~PIT_SPEAKER) | PIT_GATE_2, PIT_GATE_PORT);
+    outb(PIT_MODE_0_CH2, PIT_REG);
+    outb(count & PIT_MASK, CHANNEL_2);
+    outb(count >> 8, CHANNEL_2);
+
+    asm volatile("rdtsc" : "=A" (start));
+    while (!(inb(PIT_GATE_PORT) & PIT_OUT_2)) {
+        // a missing channel 2 leaves the tick running forever instead
+        if (++spins == CPU_CYCLE_PER_SEC) {
+            outb(gate, PIT_GATE_PORT);
+            return;
+        }
+    }
+    asm volatile("rdtsc" : "=A" (end));
+    outb(gate, PIT_GATE_PORT);
+
+    tsc_per_ms = (uint32_t)udiv64(end - start, TSC_CALIBRATE_MS);
+    tsc_boot = end;
+}
+
+static void pit_program(uint8_t mode, uint32_t count) {
+    outb(mode, PIT_REG);
+    outb(count & PIT_MASK, CHANNEL_0);
+    outb((count >> 8) & PIT_MASK, CHANNEL_0);
+}
+
+static void tick_start_periodic() {
+    if (lapic_per_ms != 0) {
+        // timer_tick arms the next one
+        lapic_timer_oneshot(lapic_tick_count);
+        return;
+    }
+    pit_program(PIT_MODE_2, tick_divisor);
+    enable_irq(PIT_IRQ);
+}
+
+static void tick_start_oneshot(int32_t left) {
+    uint32_t count;
+
+    if (lapic_per_ms != 0) {
+        if (left <= 0)
+            count = 1;
+        else if ((uint32_t)left >= 0xFFFFFFFF / lapic_per_ms)
+            count = 0xFFFFFFFF;
+        else
+            count = left * lapic_per_ms;
+        lapic_timer_oneshot(count);
+        return;
+    }
+
+    if (left <= 0)
+        count = 1;
+    else if ((uint32_t)left >= PIT_MAX_COUNT / PIT_CYCLES_PER_MS)
+        count = PIT_MAX_COUNT;
+    else
+        count = left * PIT_CYCLES_PER_MS;
+    pit_program(PIT_MODE_0, count);
+    enable_irq(PIT_IRQ);
+}
+
+static void tick_stop() {
+    if (lapic_per_ms != 0)
+        lapic_timer_stop();
+    else
+        disable_irq(PIT_IRQ);
+}
@@ -0,0 +1,83 @@
+#ifndef TIMER_H
+#define TIMER_H
+
+#include "types.h"
+#include "lib.h"
+#include "i8259.h"
+
+/*
+ * PIT channel 0 drives the scheduler tick on IRQ 0. While tasks run it is
+ * a periodic rate generator. When nothing is runnable the idle loop stops
+ * it, or arms it once for the next deadline, so an idle cpu sleeps in hlt
+ * until a device interrupt or the deadline instead of waking at every
+ * tick. Time keeps running on the TSC, calibrated against PIT channel 2
+ * at boot; without a TSC the tick never stops and counts the time. When
+ * init_apic switched to the APICs, the local APIC timer takes the place
+ * of channel 0 on the same vector, armed one shot per tick.
+ */
+#define PIT_IRQ             0
+#define PIT_CONST           1193182
+#define PIT_CYCLES_PER_MS   1193
+#define PIT_REG             0x43
+#define PIT_MODE_0          0x30        // channel 0, one shot
+#define PIT_MODE_2          0x34        // channel 0, rate generator
+#define CHANNEL_0           0x40
+#define CHANNEL_2           0x42
+#define PIT_MODE_0_CH2      0xB0        // channel 2, one shot, for calibration
+#define PIT_GATE_PORT       0x61
+#define PIT_GATE_2          0x01
+#define PIT_SPEAKER         0x02
+#define PIT_OUT_2           0x20
+#define PIT_MAX_COUNT       0xFFFF
+#define PIT_MASK            0xFF
+
+#define CPUID_TSC           0x00000010
+#define TSC_CALIBRATE_MS    10
+
+#define TIMER_NO_DEADLINE   0xFFFFFFFF
+
+// a callback run by the timer interrupt once timer_now_ms reaches expires
+typedef struct ktimer {
+    uint32_t expires;
+    void (*func)(uint32_t data);
+    uint32_t data;
+    struct ktimer* next;
+    uint8_t pending;                    // on the timer list
+} ktimer_t;
+
+// what channel 0 does right now
+#define TICK_PERIODIC       0
+#define TICK_ONESHOT        1
+#define TICK_STOPPED        2
+
+/* calibrate the clock and start the periodic tick at frequency Hz */
+extern void init_pit(uint32_t frequency);
+/* account one PIT interrupt, called first thing by pit_handler */
+extern void timer_tick();
+/* milliseconds since boot */
+extern uint32_t timer_now_ms();
+/* length of a tick in microseconds, 0 before init_pit */
+extern uint32_t timer_tick_us();
+/* raw time stamp counter, 0 without a TSC */
+extern uint64_t timer_tsc();
+/* TSC cycles per millisecond, 0 without a TSC */
+extern uint32_t timer_tsc_per_ms();
+/* busy wait for us microseconds, for hardware that needs a pause */
+extern void timer_udelay(uint32_t us);
+/* stop the tick until deadline, in timer_now_ms time, nothing is runnable */
+extern void timer_idle(uint32_t deadline);
+/* go back to the periodic tick once a task is runnable */
+extern void timer_resume();
+/* one of the TICK_* modes */
+extern uint32_t timer_tick_mode();
+
+/* arm a timer, func(data) runs from the timer interrupt at expires */
+extern void timer_add(ktimer_t* timer, uint32_t expires, void (*func)(uint32_t), uint32_t data);
+/* disarm a timer that may have fired already */
+extern void timer_del(ktimer_t* timer);
+/* run the timers that are due, called by pit_handler */
+extern void timer_run();
+/* expiry of the earliest timer, TIMER_NO_DEADLINE if none is armed */
+extern uint32_t timer_next_deadline();
+
+#endif
@@ -0,0 +1,194 @@
+#include "trace.h"
+#include "scheduling.h"
+
+// one scheduler event in the ring, with the raw time stamp
+typedef struct {
+    uint64_t tsc;
+    uint32_t type;
+    uint32_t pid;
+    uint32_t arg;
+} ring_event_t;
+
+static ring_event_t ring[TRACE_RING_LEN];
+static uint32_t ring_head = 0;              // next slot to write
+static uint32_t ring_count = 0;
+
+// latency figures since boot or the last reset
+static uint32_t wakeups = 0;
+static uint64_t total_us = 0;
+static uint32_t max_us = 0;
+static uint32_t max_pid = TRACE_PID_IDLE;
+static uint32_t hist[TRACE_HIST_BUCKETS];
+static uint32_t worst_len = 0;
+static uint32_t worst_truncated = 0;
+static trace_event_t worst[TRACE_WORST_LEN];
+
+/* what the events call a task */
+static uint32_t trace_pid(pcb_t* pcb);
+/* add an event to the ring, returns its time stamp */
+static uint64_t trace_event(uint32_t type, uint32_t pid, uint32_t arg);
+/* keep the events from the wakeup of a task to its dispatch as the worst case */
+static void keep_worst(uint64_t wake_tsc, uint32_t per_us);
+
+/* void trace_wake(pcb_t* pcb)
+ * Inputs: pcb -- the task sched_wake made runnable
+ * Return Value: none
+ * Function: stamp the task, its latency runs from here. Called with
+ *           interrupts disabled.
+ */
+void trace_wake(pcb_t* pcb) {
+    if (timer_tsc_per_ms() == 0)
+        return;
+    pcb->wake_tsc = trace_event(TRACE_WAKE, trace_pid(pcb), trace_pid(sched_current()));
+}
+
+/* void trace_switch(pcb_t* prev, pcb_t* next)
+ * --------------------------------------------------------------------------------------
+ * Descriptions:    Called by schedule right before the switch. If next was
+ *                  woken and did not run since, its wait is over: add it to
+ *                  the histogram, and keep the events in between if it is
+ *                  the worst wait so far.
+ * Inputs:          pcb_t* prev :   the task that had the cpu, NULL for idle
+ *                  pcb_t* next :   the task that gets it, NULL for idle
+ * Outputs:         None
+ * Side Effects:    None
+ */
+void trace_switch(pcb_t* prev, pcb_t* next) {
+    uint32_t per_us = timer_tsc_per_ms() / 1000;
+    uint64_t now;
+    uint32_t lat;
+    uint32_t bucket;
+
+    if (per_us == 0)
+        return;
+    now = trace_event(TRACE_SWITCH, trace_pid(next), trace_pid(prev));
+    if (next == NULL || next->wake_tsc == 0)
+        return;
+
+    lat = (uint32_t)udiv64(now - next->wake_tsc, per_us);
+    for (bucket = 0; bucket < TRACE_HIST_BUCKETS - 1 && (lat >> (bucket + 1)) != 0; bucket++);
+    hist[bucket]++;
+    wakeups++;
+    total_us += lat;
+    if (lat >= max_us) {
+        max_us = lat;
+        max_pid = trace_pid(next);
+        keep_worst(next->wake_tsc, per_us);
+    }
+    next->wake_tsc = 0;
+}
+
+/* void trace_tick(pcb_t* curr)
+ * Inputs: curr -- the task the tick hit, NULL for idle
+ * Return Value: none
+ * Function: called by pit_handler, shows the slices in a trace
+ */
+void trace_tick(pcb_t* curr) {
+    if (timer_tsc_per_ms() == 0)
+        return;
+    trace_event(TRACE_TICK, trace_pid(curr), 0);
+}
+
+/* void trace_read(wakeup_trace_t* out, uint32_t reset)
+ * Inputs: out -- kernel buffer to fill
+ *         reset -- nonzero to start over afterwards
+ * Return Value: none
+ * Function: a consistent copy of the latency figures
+ */
+void trace_read(wakeup_trace_t* out, uint32_t reset) {
+    uint32_t i;
+    uint32_t flags;
+
+    cli_and_save(flags);
+    out->count = wakeups;
+    out->avg_us = wakeups == 0 ? 0 : (uint32_t)udiv64(total_us, wakeups);
+    out->max_us = max_us;
+    out->max_pid = max_pid;
+    for (i = 0; i < TRACE_HIST_BUCKETS; i++)
+        out->hist[i] = hist[i];
+    out->worst_len = worst_len;
+    out->worst_truncated = worst_truncated;
+    memcpy(out->worst, worst, worst_len * sizeof(trace_event_t));
+    if (reset) {
+        wakeups = 0;
+        total_us = 0;
+        max_us = 0;
+        max_pid = TRACE_PID_IDLE;
+        memset(hist, 0, sizeof(hist));
+        worst_len = 0;
+        worst_truncated = 0;
+    }
+    restore_flags(flags);
+}
+
+/*
+ * Function:  int32_t wakeup_trace(wakeup_trace_t* buf, uint32_t reset)
+ * --------------------
+ * This function reports how long woken tasks waited for the cpu: the
+ * count, average and worst wait, a histogram, and the scheduler events
+ * of the worst wait.
+ *
+ *  Inputs:     wakeup_trace_t* buf: a writable buffer in the program page
+ *              uint32_t reset: nonzero to start measuring again afterwards
+ *
+ *  Returns:    -1: failed
+ *              n: the number of wakeups measured
+ *
+ *  Side effects: none
+ *
+ */
+int32_t wakeup_trace(wakeup_trace_t* buf, uint32_t reset) {
+    wakeup_trace_t trace;
+
+    if (user_writable((uint32_t)buf, sizeof(wakeup_trace_t)) == -1)
+        return -1;
+    trace_read(&trace, reset);
+    memcpy(buf, &trace, sizeof(trace));
+    return trace.count;
+}
+
+static uint32_t trace_pid(pcb_t* pcb) {
+    if (pcb == NULL)
+        return TRACE_PID_IDLE;
+    return pcb->kthread ? TRACE_PID_KERNEL : pcb->pid;
+}
+
+static uint64_t trace_event(uint32_t type, uint32_t pid, uint32_t arg) {
+    ring_event_t * ev = &ring[ring_head];
+
+    ev->tsc = timer_tsc();
+    ev->type = type;
+    ev->pid = pid;
+    ev->arg = arg;
+    ring_head = (ring_head + 1) % TRACE_RING_LEN;
+    if (ring_count < TRACE_RING_LEN)
+        ring_count++;
+    return ev->tsc;
+}
+
+static void keep_worst(uint64_t wake_tsc, uint32_t per_us) {
+    uint32_t n;
+    uint32_t i;
+    ring_event_t * ev;
+
+    // walk back from the switch just recorded to the wakeup
+    for (n = 0; n < ring_count; n++) {
+        if (ring[(ring_head + TRACE_RING_LEN - 1 - n) % TRACE_RING_LEN].tsc < wake_tsc)
+            break;
+    }
+    worst_truncated = n == ring_count && n == TRACE_RING_LEN;
+    // the newest events matter most, they end at the dispatch
+    if (n > TRACE_WORST_LEN) {
+        n = TRACE_WORST_LEN;
+        worst_truncated = 1;
+    }
+
+    for (i = 0; i < n; i++) {
+        ev = &ring[(ring_head + TRACE_RING_LEN - n + i) % TRACE_RING_LEN];
+        worst[i].offset_us = (uint32_t)udiv64(ev->tsc - wake_tsc, per_us);
+        worst[i].type = ev->type;
+        worst[i].pid = ev->pid;
+        worst[i].arg = ev->arg;
+    }
+    worst_len = n;
+}
@@ -0,0 +1,58 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "types.h"
+#include "lib.h"
+
+/*
+ * Wakeup latency tracer: sched_wake stamps a blocked task with the TSC
+ * when it becomes runnable, and schedule measures how long it took until
+ * the task got the cpu. Every wakeup, switch and tick also goes into a
+ * ring of recent events. When a latency beats the worst one so far, the
+ * events from that wakeup to its dispatch are kept, so the worst case
+ * shows what ran in between. Needs the TSC, without it nothing is
+ * recorded.
+ */
+#define TRACE_RING_LEN      64              // recent scheduler events
+#define TRACE_WORST_LEN     32              // events kept for the worst wakeup
+#define TRACE_HIST_BUCKETS  20              // bucket i below 2^(i + 1) us, the last one open
+
+// event types
+#define TRACE_WAKE          0               // pid became runnable, arg woke it
+#define TRACE_SWITCH        1               // pid got the cpu from arg
+#define TRACE_TICK          2               // timer tick while pid ran
+
+#define TRACE_PID_IDLE      0xFFFFFFFF      // the idle loop
+#define TRACE_PID_KERNEL    0xFFFFFFFE      // a kernel task
+
+typedef struct {
+    uint32_t offset_us;                 // after the wakeup
+    uint32_t type;
+    uint32_t pid;
+    uint32_t arg;
+} trace_event_t;
+
+typedef struct {
+    uint32_t count;                     // wakeups measured
+    uint32_t avg_us;
+    uint32_t max_us;
+    uint32_t max_pid;                   // the task that waited longest
+    uint32_t hist[TRACE_HIST_BUCKETS];
+    uint32_t worst_len;                 // events in worst
+    uint32_t worst_truncated;           // older events of the worst case were lost
+    trace_event_t worst[TRACE_WORST_LEN];
+} wakeup_trace_t;
+
+/* a blocked or new task became runnable */
+extern void trace_wake(pcb_t* pcb);
+/* next gets the cpu from prev, either may be NULL for the idle loop */
+extern void trace_switch(pcb_t* prev, pcb_t* next);
+/* a timer tick came while curr ran */
+extern void trace_tick(pcb_t* curr);
+/* copy the latency figures, then clear them if reset is set */
+extern void trace_read(wakeup_trace_t* out, uint32_t reset);
+
+// system call
+int32_t wakeup_trace(wakeup_trace_t* buf, uint32_t reset);
+
+#endif
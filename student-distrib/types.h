@@ -14,10 +14,17 @@
 #define SCREEN_COLUMN   80
 #define SCREEN_ROW      25
 #define KEY_ARR_SIZE_OLD    128
+#define SHM_MAX_ATTACH  4           // shared memory segments a process can attach
+#define THREAD_MAX      4           // threads a process can have besides itself
+#define FPU_STATE_SIZE  512         // FXSAVE area
+#define PROC_NAME_LEN   32          // executable name kept in the pcb
 
 #ifndef ASM
 
 /* Types defined here just like in <stdint.h> */
+typedef long long int64_t;
+typedef unsigned long long uint64_t;
+
 typedef int int32_t;
 typedef unsigned int uint32_t;
 
@@ -50,16 +57,59 @@ typedef struct {
 } file_desc_t;
 
 typedef struct {
+    int32_t shmid;
+    uint32_t vaddr;
+} shm_attach_t;
+
+// a thread of a process, kept by the process until it is joined
+typedef struct {
+    uint32_t pid;
+    uint8_t state;                      // THREAD_* in thread.h
+    int32_t status;                     // halt status once the thread exited
+} thread_slot_t;
+
+typedef struct pcb {
     file_desc_t files[MAX_FD];
     uint32_t pid;
     uint32_t parent_pid;
-    uint32_t parent_esp;
-    uint32_t parent_ebp;
-    uint32_t schedule_esp;
-    uint32_t schedule_ebp;
+    uint32_t kernel_esp;                // saved by context_switch while the task is off the cpu
+    uint32_t state;                     // TASK_* in scheduling.h
+    struct pcb* run_next;               // run queue links, valid while runnable
+    struct pcb* run_prev;
+    struct pcb* wait_next;              // next task blocked on the same wait queue
+    void* wait_queue;                   // the wait queue the task sleeps on, NULL if none
+    int32_t nice;                       // NICE_MIN to NICE_MAX, lower gets more cpu
+    uint32_t counter;                   // goodness class: ticks left of the slice
+    uint8_t boost;                      // goodness class: woken by the keyboard
+    uint64_t vruntime;                  // fair class: weighted ticks run so far
+    uint8_t policy;                     // SCHED_NORMAL or SCHED_FIFO, picks the class
+    uint8_t kthread;                    // kernel task, never runs in user mode
+    uint8_t throttled;                  // runnable, but its cpu group is out of quota
+    uint32_t preempt_count;             // preempt_disable and irq_enter nesting, kept across a block
+    uint64_t runtime_tsc;               // cycles on the cpu up to the last switch away
+    uint32_t nvcsw;                     // switches away after it blocked or halted
+    uint32_t nivcsw;                    // switches away while still runnable
+    uint32_t syscall_count;             // system calls made
+    uint64_t wake_tsc;                  // when it was woken, 0 once it got the cpu
+    uint32_t wait_pid;                  // child a blocked execute waits for
+    int32_t child_status;               // halt status of that child
+    uint8_t background;                 // started with '&', not part of the terminal chain
     uint8_t argument[ARG_MAX];
     uint32_t pending_signal;
     void (*sighandler)(uint8_t);
+    shm_attach_t shm[SHM_MAX_ATTACH];
+    int32_t text_id;
+    uint8_t terminal_id;
+    uint32_t* program_table;
+    uint32_t* shm_table;
+    uint8_t name[PROC_NAME_LEN];
+    struct pcb* leader;                 // process of a thread, NULL for a process
+    uint32_t thread_slot;               // thread: its slot in the threads of the leader
+    thread_slot_t threads[THREAD_MAX];  // process: its threads, by user stack slot
+    uint8_t exiting;                    // process: halting, its threads halt too
+    uint8_t fpu_used;                   // the task has FPU state, lost when it halts
+    // FPU and SSE registers while another task owns the FPU
+    uint8_t fpu_state[FPU_STATE_SIZE] __attribute__((aligned(16)));
 } pcb_t;
 
 typedef struct {
@@ -0,0 +1,98 @@
+#include "work.h"
+#include "scheduling.h"
+
+// queued work in the order it was queued
+static work_t* work_head = NULL;
+static work_t* work_tail = NULL;
+// the work task sleeps here while the queue is empty
+static wait_queue_t work_wait = {NULL};
+
+/* the kernel task that runs the queued work */
+static void work_thread(uint32_t data);
+
+/* void init_work()
+ * Inputs: none
+ * Return Value: none
+ * Function: start the kernel task that runs the work. Work queued before
+ *           it runs waits for it.
+ */
+void init_work() {
+    if (kthread_create((int8_t*)"work", work_thread, 0, SCHED_FIFO) == NULL)
+        printf("work: no memory for the work task\n");
+}
+
+/* void work_init(work_t* work, void (*func)(uint32_t), uint32_t data)
+ * Inputs: work -- the work item
+ *         func -- what it runs
+ *         data -- argument of func
+ * Return Value: none
+ * Function: set up a work item that is not queued
+ */
+void work_init(work_t* work, void (*func)(uint32_t), uint32_t data) {
+    work->func = func;
+    work->data = data;
+    work->next = NULL;
+    work->pending = 0;
+}
+
+/* void work_queue(work_t* work)
+ * Inputs: work -- an initialized work item
+ * Return Value: none
+ * Function: put the work item at the end of the queue and wake the work
+ *           task. Queueing it again before it ran does nothing, it runs once.
+ */
+void work_queue(work_t* work) {
+    uint32_t flags;
+
+    cli_and_save(flags);
+    if (!work->pending) {
+        work->pending = 1;
+        work->next = NULL;
+        if (work_tail != NULL)
+            work_tail->next = work;
+        else
+            work_head = work;
+        work_tail = work;
+        wake_up(&work_wait);
+    }
+    restore_flags(flags);
+}
+
+/* void work_thread(uint32_t data)
+ * --------------------------------------------------------------------------------------
+ * Descriptions:    Run the queued work in order with interrupts enabled, and
+ *                  sleep while there is none. After WORK_BUDGET items in a
+ *                  row it sleeps a millisecond, so a flood of interrupts
+ *                  cannot keep the other tasks off the cpu.
+ * Inputs:          uint32_t data : unused
+ * Outputs:         never returns
+ * Side Effects:    Whatever the work functions do
+ */
+static void work_thread(uint32_t data) {
+    work_t * work;
+    uint32_t flags;
+    uint32_t budget;
+
+    while (1) {
+        cli_and_save(flags);
+        while (work_head == NULL)
+            sleep_on(&work_wait);
+
+        for (budget = 0; budget < WORK_BUDGET && work_head != NULL; budget++) {
+            work = work_head;
+            work_head = work->next;
+            if (work_head == NULL)
+                work_tail = NULL;
+            // it may be queued again while it runs
+            work->pending = 0;
+
+            sti();
+            work->func(work->data);
+            cli();
+        }
+        restore_flags(flags);
+
+        if (budget == WORK_BUDGET)
+            sleep(1);
+    }
+}
@@ -0,0 +1,33 @@
+#ifndef WORK_H
+#define WORK_H
+
+#include "types.h"
+#include "lib.h"
+
+/*
+ * Bottom halves for the device interrupts. A handler acknowledges the
+ * device, saves what it has to and queues a work item; the slow part runs
+ * in the "work" kernel task with interrupts enabled, so the tick and the
+ * other devices are not held back while it copies or draws. The task is
+ * real time, it gets the cpu in irq_exit of the interrupt that queued the
+ * work. It runs on its own stack like any task, so a work function may
+ * block, load a program or wait for the swap disk.
+ */
+#define WORK_BUDGET         8               // work items run in a row before the other tasks get the cpu
+
+// a function to run later with interrupts enabled
+typedef struct work {
+    void (*func)(uint32_t data);
+    uint32_t data;
+    struct work* next;
+    uint8_t pending;                    // on the work queue
+} work_t;
+
+/* set the function a work item runs */
+extern void work_init(work_t* work, void (*func)(uint32_t), uint32_t data);
+/* queue a work item unless it is queued already, safe from an interrupt handler */
+extern void work_queue(work_t* work);
+/* start the kernel task that runs the work, before interrupts are enabled */
+extern void init_work();
+
+#endif
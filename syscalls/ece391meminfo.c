@@ -0,0 +1,126 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define MEM_SUBSYS_NUM      6
+#define MEMINFO_MAX_PROCS   16
+#define PROC_NAME_LEN       32
+#define PAGE_KB             4
+#define NUMBUF              12
+
+/* same layout as meminfo_t in the kernel */
+typedef struct {
+    uint32_t pid;
+    uint32_t parent_pid;
+    uint32_t terminal_id;
+    uint32_t resident_pages;
+    uint32_t swapped_pages;
+    uint32_t text_pages;
+    uint32_t shm_pages;
+    uint32_t kernel_pages;
+    uint8_t name[PROC_NAME_LEN];
+} proc_info_t;
+
+typedef struct {
+    uint32_t total_pages;
+    uint32_t free_pages;
+    uint32_t zeroed_pages;
+    uint32_t charged_pages[MEM_SUBSYS_NUM];
+    uint32_t unaccounted_pages;
+    uint32_t swap_total_pages;
+    uint32_t swap_free_pages;
+    uint32_t image_bytes;
+    uint32_t dma_bytes;
+    uint32_t video_bytes;
+    uint32_t fs_addr;
+    uint32_t fs_bytes;
+    uint32_t num_procs;
+    proc_info_t procs[MEMINFO_MAX_PROCS];
+} mem_info_t;
+
+static const char* subsys_names[MEM_SUBSYS_NUM] = {
+    "process table ", "kernel stacks ", "page tables   ",
+    "user pages    ", "text cache    ", "shared memory "
+};
+
+static mem_info_t info;
+
+/* print a number followed by a string */
+static void
+put_num (uint32_t value, const char* suffix)
+{
+    uint8_t buf[NUMBUF];
+
+    ece391_fdputs (1, ece391_itoa (value, buf, 10));
+    ece391_fdputs (1, (uint8_t*)suffix);
+}
+
+/* print a number padded to width columns */
+static void
+put_col (uint32_t value, uint32_t width)
+{
+    uint8_t buf[NUMBUF];
+    uint32_t len;
+
+    ece391_itoa (value, buf, 10);
+    for (len = ece391_strlen (buf); len < width; len++)
+        ece391_fdputs (1, (uint8_t*)" ");
+    ece391_fdputs (1, buf);
+}
+
+int main ()
+{
+    uint32_t i;
+    uint32_t shown;
+    uint8_t addr[NUMBUF];
+
+    if (-1 == ece391_meminfo (&info)) {
+        ece391_fdputs (1, (uint8_t*)"meminfo failed\n");
+        return 3;
+    }
+
+    ece391_fdputs (1, (uint8_t*)"frames        ");
+    put_num (info.total_pages * PAGE_KB, " KB total, ");
+    put_num (info.free_pages * PAGE_KB, " KB free, ");
+    put_num (info.zeroed_pages * PAGE_KB, " KB zeroed\n");
+    for (i = 0; i < MEM_SUBSYS_NUM; i++) {
+        ece391_fdputs (1, (uint8_t*)subsys_names[i]);
+        put_num (info.charged_pages[i] * PAGE_KB, " KB\n");
+    }
+    ece391_fdputs (1, (uint8_t*)"unaccounted   ");
+    put_num (info.unaccounted_pages * PAGE_KB, " KB\n");
+    ece391_fdputs (1, (uint8_t*)"swap          ");
+    put_num ((info.swap_total_pages - info.swap_free_pages) * PAGE_KB, " KB used of ");
+    put_num (info.swap_total_pages * PAGE_KB, " KB\n");
+    ece391_fdputs (1, (uint8_t*)"kernel image  ");
+    put_num (info.image_bytes / 1024, " KB, dma buffer ");
+    put_num (info.dma_bytes / 1024, " KB\n");
+    ece391_fdputs (1, (uint8_t*)"video         ");
+    put_num (info.video_bytes / 1024, " KB, file system ");
+    put_num (info.fs_bytes / 1024, " KB at 0x");
+    ece391_fdputs (1, ece391_itoa (info.fs_addr, addr, 16));
+    ece391_fdputs (1, (uint8_t*)"\n\n");
+
+    ece391_fdputs (1, (uint8_t*)"  PID PPID TERM   RES  SWAP  TEXT   SHM  KERN NAME\n");
+    shown = info.num_procs < MEMINFO_MAX_PROCS ? info.num_procs : MEMINFO_MAX_PROCS;
+    for (i = 0; i < shown; i++) {
+        put_col (info.procs[i].pid, 5);
+        put_col (info.procs[i].parent_pid, 5);
+        put_col (info.procs[i].terminal_id, 5);
+        put_col (info.procs[i].resident_pages * PAGE_KB, 6);
+        put_col (info.procs[i].swapped_pages * PAGE_KB, 6);
+        put_col (info.procs[i].text_pages * PAGE_KB, 6);
+        put_col (info.procs[i].shm_pages * PAGE_KB, 6);
+        put_col (info.procs[i].kernel_pages * PAGE_KB, 6);
+        ece391_fdputs (1, (uint8_t*)" ");
+        ece391_fdputs (1, info.procs[i].name);
+        ece391_fdputs (1, (uint8_t*)"\n");
+    }
+    if (info.num_procs > shown) {
+        put_num (info.num_procs - shown, " more processes\n");
+    }
+    ece391_fdputs (1, (uint8_t*)"sizes in KB\n");
+
+    return 0;
+}
@@ -0,0 +1,50 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define BUFSIZE 1024
+
+/* usage: nice <increment> <command>, the command inherits the new nice */
+int main ()
+{
+    uint8_t buf[BUFSIZE];
+    uint32_t i = 0;
+    int32_t sign = 1;
+    int32_t increment = 0;
+    int32_t rval;
+
+    if (0 != ece391_getargs (buf, BUFSIZE)) {
+        ece391_fdputs (1, (uint8_t*)"usage: nice <increment> <command>\n");
+        return 3;
+    }
+
+    if ('-' == buf[i]) {
+        sign = -1;
+        i++;
+    }
+    if (buf[i] < '0' || buf[i] > '9') {
+        ece391_fdputs (1, (uint8_t*)"usage: nice <increment> <command>\n");
+        return 3;
+    }
+    while (buf[i] >= '0' && buf[i] <= '9')
+        increment = increment * 10 + (buf[i++] - '0');
+    while (' ' == buf[i])
+        i++;
+    if ('\0' == buf[i]) {
+        ece391_fdputs (1, (uint8_t*)"usage: nice <increment> <command>\n");
+        return 3;
+    }
+
+    if (-1 == ece391_nice (sign * increment)) {
+        ece391_fdputs (1, (uint8_t*)"nice value out of range\n");
+        return 3;
+    }
+
+    rval = ece391_execute (buf + i);
+    if (-1 == rval) {
+        ece391_fdputs (1, (uint8_t*)"no such command\n");
+        return 3;
+    }
+    return rval;
+}
@@ -0,0 +1,90 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define BUFSIZE         1024
+#define NUM_TERMINALS   3
+#define NUMBUF          12
+
+/* same layout as cpu_group_info_t in the kernel */
+typedef struct {
+    uint32_t terminal_id;
+    uint32_t quota;
+    uint32_t period_ms;
+    uint32_t total_ms;
+    uint32_t throttle_count;
+    uint32_t throttled;
+} group_info_t;
+
+static group_info_t groups[NUM_TERMINALS];
+
+/* print a number padded to width columns */
+static void
+put_col (uint32_t value, uint32_t width)
+{
+    uint8_t buf[NUMBUF];
+    uint32_t len;
+
+    ece391_itoa (value, buf, 10);
+    for (len = ece391_strlen (buf); len < width; len++)
+        ece391_fdputs (1, (uint8_t*)" ");
+    ece391_fdputs (1, buf);
+}
+
+/* read a decimal number at buf[*i], -1 if there is none */
+static int32_t
+get_num (uint8_t* buf, uint32_t* i)
+{
+    int32_t value = 0;
+
+    while (' ' == buf[*i])
+        (*i)++;
+    if (buf[*i] < '0' || buf[*i] > '9')
+        return -1;
+    while (buf[*i] >= '0' && buf[*i] <= '9')
+        value = value * 10 + (buf[(*i)++] - '0');
+    return value;
+}
+
+/* usage: quota, to show the cpu groups, or quota <terminal 1-3> <percent> */
+int main ()
+{
+    uint8_t buf[BUFSIZE];
+    uint32_t i = 0;
+    int32_t terminal;
+    int32_t percent;
+    int32_t count;
+
+    if (0 == ece391_getargs (buf, BUFSIZE)) {
+        terminal = get_num (buf, &i);
+        percent = get_num (buf, &i);
+        if (terminal < 1 || percent < 0) {
+            ece391_fdputs (1, (uint8_t*)"usage: quota [<terminal 1-3> <percent>]\n");
+            return 3;
+        }
+        if (-1 == ece391_cpu_quota (terminal - 1, percent)) {
+            ece391_fdputs (1, (uint8_t*)"no such terminal or percent out of range\n");
+            return 3;
+        }
+        return 0;
+    }
+
+    if (-1 == (count = ece391_cpu_groups (groups))) {
+        ece391_fdputs (1, (uint8_t*)"cpu_groups failed\n");
+        return 3;
+    }
+    ece391_fdputs (1, (uint8_t*)"TERM QUOTA PERIOD    TOTAL THROTTLED\n");
+    for (i = 0; i < count && i < NUM_TERMINALS; i++) {
+        put_col (groups[i].terminal_id + 1, 4);
+        put_col (groups[i].quota, 5);
+        ece391_fdputs (1, (uint8_t*)"%");
+        put_col (groups[i].period_ms, 6);
+        put_col (groups[i].total_ms, 9);
+        put_col (groups[i].throttle_count, 10);
+        ece391_fdputs (1, (uint8_t*)(groups[i].throttled ? " now\n" : "\n"));
+    }
+    ece391_fdputs (1, (uint8_t*)"times in ms, quota of each 1000 ms period\n");
+
+    return 0;
+}
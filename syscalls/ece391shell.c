@@ -5,10 +5,20 @@
 
 #define BUFSIZE 1024
 
+/* a command that ends with '&' runs in the background */
+static int32_t
+is_background (const uint8_t* buf, int32_t cnt)
+{
+    while (cnt > 0 && ' ' == buf[cnt - 1])
+        cnt--;
+    return (cnt > 0 && '&' == buf[cnt - 1]);
+}
+
 int main ()
 {
     int32_t cnt, rval;
     uint8_t buf[BUFSIZE];
+    uint8_t num[12];
     ece391_fdputs (1, (uint8_t*)"Starting 391 Shell\n");
 
     while (1) {
@@ -27,7 +37,12 @@ int main ()
 		rval = ece391_execute (buf);
 		if (-1 == rval)
 			ece391_fdputs (1, (uint8_t*)"no such command\n");
-		else if (256 == rval)
+		else if (is_background (buf, cnt)) {
+			/* execute returns the pid of a background job right away */
+			ece391_fdputs (1, (uint8_t*)"[");
+			ece391_fdputs (1, ece391_itoa (rval, num, 10));
+			ece391_fdputs (1, (uint8_t*)"] started\n");
+		} else if (256 == rval)
 			ece391_fdputs (1, (uint8_t*)"program terminated by exception\n");
 		else if (0 != rval)
 			ece391_fdputs (1, (uint8_t*)"program terminated abnormally\n");
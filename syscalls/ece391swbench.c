@@ -0,0 +1,184 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+/* same channel as in swpeer */
+#define SWBENCH_KEY     0x53574200
+#define SHM_WINDOW      0x08400000          // start of the shared memory window
+#define TURN_BENCH      0
+#define TURN_PEER       1
+
+#define BUFSIZE         1024
+#define NUMBUF          12
+#define MAX_ROUNDS      1000
+#define WARMUP_ROUNDS   16
+#define SWITCH_HIST_BUCKETS 16
+#define SWITCH_HIST_SHIFT   8
+
+typedef struct {
+    volatile uint32_t turn;
+    volatile uint32_t done;
+} channel_t;
+
+/* same layout as switch_stat_t in the kernel */
+typedef struct {
+    uint32_t tsc_per_ms;
+    uint32_t count;
+    uint32_t avg_cycles;
+    uint32_t min_cycles;
+    uint32_t max_cycles;
+    uint32_t avg_mm_cycles;
+    uint32_t hist[SWITCH_HIST_BUCKETS];
+} switch_stat_t;
+
+static uint32_t samples[MAX_ROUNDS];
+static switch_stat_t stat;
+
+/* low half of the time stamp counter, enough for one round trip */
+static uint32_t
+rdtsc (void)
+{
+    uint32_t lo;
+
+    asm volatile ("rdtsc" : "=a" (lo) : : "edx");
+    return lo;
+}
+
+/* print a number followed by a string */
+static void
+put_num (uint32_t value, const char* suffix)
+{
+    uint8_t buf[NUMBUF];
+
+    ece391_fdputs (1, ece391_itoa (value, buf, 10));
+    ece391_fdputs (1, (uint8_t*)suffix);
+}
+
+/* print cycles, and microseconds with one decimal when the tsc rate is known */
+static void
+put_cycles (const char* label, uint32_t cycles)
+{
+    uint32_t per_100ns = stat.tsc_per_ms / 10000;
+
+    ece391_fdputs (1, (uint8_t*)label);
+    put_num (cycles, " cycles");
+    if (0 != per_100ns) {
+        ece391_fdputs (1, (uint8_t*)", ");
+        put_num (cycles / per_100ns / 10, ".");
+        put_num (cycles / per_100ns % 10, " us");
+    }
+    ece391_fdputs (1, (uint8_t*)"\n");
+}
+
+/* one turn to the peer and back */
+static uint32_t
+round_trip (channel_t* ch)
+{
+    uint32_t start = rdtsc ();
+
+    ch->turn = TURN_PEER;
+    ece391_shm_wake ((uint32_t*)&ch->turn);
+    while (TURN_PEER == ch->turn)
+        ece391_shm_wait ((uint32_t*)&ch->turn, TURN_PEER);
+    return rdtsc () - start;
+}
+
+/* shell sort, the samples are few */
+static void
+sort (uint32_t* a, uint32_t n)
+{
+    uint32_t gap;
+    uint32_t i;
+    uint32_t j;
+    uint32_t v;
+
+    for (gap = n / 2; gap > 0; gap /= 2) {
+        for (i = gap; i < n; i++) {
+            v = a[i];
+            for (j = i; j >= gap && a[j - gap] > v; j -= gap)
+                a[j] = a[j - gap];
+            a[j] = v;
+        }
+    }
+}
+
+/*
+ * usage: swbench [rounds]
+ * Starts swpeer in the background and passes a turn back and forth with
+ * it through shm_wait and shm_wake, two context switches per round trip.
+ * Prints the round trip percentiles, then what the kernel measured for
+ * its context switches over the same rounds.
+ */
+int main ()
+{
+    uint8_t buf[BUFSIZE];
+    uint32_t rounds = MAX_ROUNDS;
+    uint32_t i;
+    int32_t shmid;
+    channel_t* ch;
+
+    if (0 == ece391_getargs (buf, BUFSIZE)) {
+        for (rounds = 0, i = 0; buf[i] >= '0' && buf[i] <= '9'; i++)
+            rounds = rounds * 10 + (buf[i] - '0');
+        if (0 == rounds || rounds > MAX_ROUNDS) {
+            ece391_fdputs (1, (uint8_t*)"usage: swbench [rounds, at most 1000]\n");
+            return 3;
+        }
+    }
+
+    if (-1 == (shmid = ece391_shmget (SWBENCH_KEY, sizeof (channel_t)))
+            || -1 == ece391_shmat (shmid, (void*)SHM_WINDOW)) {
+        ece391_fdputs (1, (uint8_t*)"swbench: no channel\n");
+        return 3;
+    }
+    ch = (channel_t*)SHM_WINDOW;
+    ch->turn = TURN_BENCH;
+    ch->done = 0;
+    if (-1 == ece391_execute ((uint8_t*)"swpeer &")) {
+        ece391_fdputs (1, (uint8_t*)"swbench: cannot start swpeer\n");
+        ece391_shmdt ((void*)SHM_WINDOW);
+        return 3;
+    }
+
+    // the first rounds wait for the peer to load
+    for (i = 0; i < WARMUP_ROUNDS; i++)
+        round_trip (ch);
+    ece391_switch_stat (&stat, 1);
+    for (i = 0; i < rounds; i++)
+        samples[i] = round_trip (ch);
+    ece391_switch_stat (&stat, 0);
+
+    ch->done = 1;
+    ch->turn = TURN_PEER;
+    ece391_shm_wake ((uint32_t*)&ch->turn);
+    ece391_shmdt ((void*)SHM_WINDOW);
+
+    sort (samples, rounds);
+    put_num (rounds, " round trips\n");
+    put_cycles ("min  ", samples[0]);
+    put_cycles ("p50  ", samples[rounds / 2]);
+    put_cycles ("p90  ", samples[rounds * 9 / 10]);
+    put_cycles ("p99  ", samples[rounds * 99 / 100]);
+    put_cycles ("max  ", samples[rounds - 1]);
+
+    put_num (stat.count, " context switches in the kernel\n");
+    put_cycles ("avg  ", stat.avg_cycles);
+    put_cycles ("min  ", stat.min_cycles);
+    put_cycles ("max  ", stat.max_cycles);
+    put_cycles ("mm   ", stat.avg_mm_cycles);         // page tables, video, tlb
+    for (i = 0; i < SWITCH_HIST_BUCKETS; i++) {
+        if (0 == stat.hist[i])
+            continue;
+        if (SWITCH_HIST_BUCKETS - 1 == i) {
+            ece391_fdputs (1, (uint8_t*)"  >= ");
+            put_num (1 << (i + SWITCH_HIST_SHIFT), " cycles: ");
+        } else {
+            ece391_fdputs (1, (uint8_t*)"  < ");
+            put_num (1 << (i + SWITCH_HIST_SHIFT + 1), " cycles: ");
+        }
+        put_num (stat.hist[i], "\n");
+    }
+
+    return 0;
+}
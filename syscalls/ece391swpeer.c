@@ -0,0 +1,41 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+/* same channel as in swbench */
+#define SWBENCH_KEY     0x53574200
+#define SHM_WINDOW      0x08400000          // start of the shared memory window
+#define TURN_BENCH      0
+#define TURN_PEER       1
+
+typedef struct {
+    volatile uint32_t turn;
+    volatile uint32_t done;
+} channel_t;
+
+/* the other half of swbench: hand every turn straight back */
+int main ()
+{
+    int32_t shmid;
+    channel_t* ch;
+
+    if (-1 == (shmid = ece391_shmget (SWBENCH_KEY, sizeof (channel_t)))
+            || -1 == ece391_shmat (shmid, (void*)SHM_WINDOW)) {
+        ece391_fdputs (1, (uint8_t*)"swpeer: no channel\n");
+        return 3;
+    }
+    ch = (channel_t*)SHM_WINDOW;
+
+    while (1) {
+        while (TURN_BENCH == ch->turn)
+            ece391_shm_wait ((uint32_t*)&ch->turn, TURN_BENCH);
+        if (ch->done)
+            break;
+        ch->turn = TURN_BENCH;
+        ece391_shm_wake ((uint32_t*)&ch->turn);
+    }
+
+    ece391_shmdt ((void*)SHM_WINDOW);
+    return 0;
+}
@@ -22,6 +22,24 @@ extern int32_t ece391_vidmap (uint8_t** screen_start);
 extern int32_t ece391_set_handler (int32_t signum, void* handler);
 extern int32_t ece391_sigreturn (void);
 extern int32_t ece391_play(const uint8_t* filename);
+extern int32_t ece391_shmget (uint32_t key, uint32_t size);
+extern int32_t ece391_shmat (int32_t shmid, void* addr);
+extern int32_t ece391_shmdt (void* addr);
+extern int32_t ece391_meminfo (void* buf);
+extern int32_t ece391_nice (int32_t increment);
+extern int32_t ece391_yield (void);
+extern int32_t ece391_sleep (uint32_t ms);
+/* func(arg) runs in a new thread of the process, which halts with its return value */
+extern int32_t ece391_thread_create (int32_t (*func)(void*), void* arg);
+extern int32_t ece391_thread_join (int32_t tid);
+extern int32_t ece391_cpu_quota (uint32_t terminal, uint32_t percent);
+extern int32_t ece391_cpu_groups (void* buf);
+extern int32_t ece391_cpustat (void* buf);
+/* block while the word at addr, in a shared memory segment, holds val */
+extern int32_t ece391_shm_wait (uint32_t* addr, uint32_t val);
+extern int32_t ece391_shm_wake (uint32_t* addr);
+extern int32_t ece391_switch_stat (void* buf, uint32_t reset);
+extern int32_t ece391_wakeup_trace (void* buf, uint32_t reset);
 
 enum signums {
 	DIV_ZERO = 0,
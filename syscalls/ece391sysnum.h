@@ -12,5 +12,21 @@
 #define SYS_SET_HANDLER  9
 #define SYS_SIGRETURN  10
 #define SYS_PLAY       11
+#define SYS_SHMGET     12
+#define SYS_SHMAT      13
+#define SYS_SHMDT      14
+#define SYS_MEMINFO    15
+#define SYS_NICE       16
+#define SYS_YIELD      17
+#define SYS_SLEEP      18
+#define SYS_THREAD_CREATE  19
+#define SYS_THREAD_JOIN    20
+#define SYS_CPU_QUOTA      21
+#define SYS_CPU_GROUPS     22
+#define SYS_CPUSTAT        23
+#define SYS_SHM_WAIT       24
+#define SYS_SHM_WAKE       25
+#define SYS_SWITCH_STAT    26
+#define SYS_WAKEUP_TRACE   27
 
 #endif /* ECE391SYSNUM_H */
@@ -0,0 +1,52 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define NUM_THREADS 3
+#define ROUNDS      5
+#define BUFSIZE     16
+
+/* print a few lines while the other threads do the same, halt with id */
+static int32_t worker (void* arg)
+{
+    uint32_t id = (uint32_t)arg;
+    uint8_t buf[BUFSIZE];
+    uint32_t i;
+
+    for (i = 0; i < ROUNDS; i++) {
+        ece391_fdputs (1, (uint8_t*)"thread ");
+        ece391_fdputs (1, ece391_itoa (id, buf, 10));
+        ece391_fdputs (1, (uint8_t*)" round ");
+        ece391_fdputs (1, ece391_itoa (i, buf, 10));
+        ece391_fdputs (1, (uint8_t*)"\n");
+        ece391_sleep (100 * (id + 1));
+    }
+    return id;
+}
+
+/* start a few threads, then wait for each and print its status */
+int main ()
+{
+    int32_t tid[NUM_THREADS];
+    uint8_t buf[BUFSIZE];
+    uint32_t i;
+    int32_t status;
+
+    for (i = 0; i < NUM_THREADS; i++) {
+        if (-1 == (tid[i] = ece391_thread_create (worker, (void*)i))) {
+            ece391_fdputs (1, (uint8_t*)"thread_create failed\n");
+            return 3;
+        }
+    }
+
+    for (i = 0; i < NUM_THREADS; i++) {
+        status = ece391_thread_join (tid[i]);
+        ece391_fdputs (1, (uint8_t*)"joined thread ");
+        ece391_fdputs (1, ece391_itoa (i, buf, 10));
+        ece391_fdputs (1, (uint8_t*)", status ");
+        ece391_fdputs (1, ece391_itoa (status, buf, 10));
+        ece391_fdputs (1, (uint8_t*)"\n");
+    }
+    return 0;
+}
@@ -0,0 +1,207 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define CPUSTAT_MAX_PROCS   16
+#define PROC_NAME_LEN       32
+#define NUMBUF              12
+
+#define SCREEN_COLS         80
+#define SCREEN_ROWS         25
+#define ATTRIB              0x7
+#define RTC_HZ              2
+#define REFRESH_TICKS       2               // one refresh a second
+
+#define TASK_RUNNABLE       1
+#define TASK_BLOCKED        2
+
+/* same layout as cpustat_t in the kernel */
+typedef struct {
+    uint32_t pid;
+    uint32_t parent_pid;
+    uint32_t terminal_id;
+    uint32_t state;
+    int32_t nice;
+    uint32_t runtime_ms;
+    uint32_t nvcsw;
+    uint32_t nivcsw;
+    uint32_t syscalls;
+    uint8_t name[PROC_NAME_LEN];
+} proc_stat_t;
+
+typedef struct {
+    uint32_t uptime_ms;
+    uint32_t idle_ms;
+    uint32_t switches;
+    uint32_t num_procs;
+    proc_stat_t procs[CPUSTAT_MAX_PROCS];
+} cpu_stat_t;
+
+// this refresh and the one before, the cpu share is the difference
+static cpu_stat_t stats[2];
+static cpu_stat_t* stat = &stats[0];
+static cpu_stat_t* last = &stats[1];
+static uint8_t* screen;
+
+/* write s at column col of row, return the column after it */
+static uint32_t
+put_str (uint32_t row, uint32_t col, const uint8_t* s)
+{
+    while ('\0' != *s && col < SCREEN_COLS) {
+        screen[(row * SCREEN_COLS + col) * 2] = *s++;
+        screen[(row * SCREEN_COLS + col) * 2 + 1] = ATTRIB;
+        col++;
+    }
+    return col;
+}
+
+/* write a number right aligned in width columns */
+static uint32_t
+put_col (uint32_t row, uint32_t col, uint32_t value, uint32_t width)
+{
+    uint8_t buf[NUMBUF];
+    uint32_t len;
+
+    ece391_itoa (value, buf, 10);
+    for (len = ece391_strlen (buf); len < width; len++)
+        col = put_str (row, col, (uint8_t*)" ");
+    return put_str (row, col, buf);
+}
+
+/* write a signed number right aligned in width columns */
+static uint32_t
+put_signed (uint32_t row, uint32_t col, int32_t value, uint32_t width)
+{
+    uint8_t buf[NUMBUF];
+    uint32_t len;
+
+    if (value >= 0)
+        return put_col (row, col, value, width);
+    ece391_itoa (-value, buf, 10);
+    for (len = ece391_strlen (buf) + 1; len < width; len++)
+        col = put_str (row, col, (uint8_t*)" ");
+    col = put_str (row, col, (uint8_t*)"-");
+    return put_str (row, col, buf);
+}
+
+/* write a tenth of a percent as a percent with one decimal */
+static uint32_t
+put_permille (uint32_t row, uint32_t col, uint32_t permille, uint32_t width)
+{
+    uint8_t buf[NUMBUF];
+
+    col = put_col (row, col, permille / 10, width > 2 ? width - 2 : 0);
+    col = put_str (row, col, (uint8_t*)".");
+    return put_str (row, col, ece391_itoa (permille % 10, buf, 10));
+}
+
+/* blank a whole row */
+static void
+clear_row (uint32_t row)
+{
+    uint32_t col;
+
+    for (col = 0; col < SCREEN_COLS; col++) {
+        screen[(row * SCREEN_COLS + col) * 2] = ' ';
+        screen[(row * SCREEN_COLS + col) * 2 + 1] = ATTRIB;
+    }
+}
+
+/* runtime of pid at the last refresh, 0 if it did not exist then */
+static uint32_t
+last_runtime (uint32_t pid)
+{
+    uint32_t i;
+
+    for (i = 0; i < last->num_procs && i < CPUSTAT_MAX_PROCS; i++) {
+        if (last->procs[i].pid == pid)
+            return last->procs[i].runtime_ms;
+    }
+    return 0;
+}
+
+/* draw one refresh, cpu shares are over the time since the last one */
+static void
+draw (void)
+{
+    uint32_t i;
+    uint32_t row;
+    uint32_t col;
+    uint32_t shown;
+    uint32_t elapsed = stat->uptime_ms - last->uptime_ms;
+    uint32_t idle = stat->idle_ms - last->idle_ms;
+    proc_stat_t* p;
+
+    if (0 == elapsed)
+        elapsed = 1;
+    for (row = 0; row < SCREEN_ROWS; row++)
+        clear_row (row);
+
+    col = put_str (0, 0, (uint8_t*)"top - up ");
+    col = put_col (0, col, stat->uptime_ms / 1000, 0);
+    col = put_str (0, col, (uint8_t*)" s, idle ");
+    col = put_permille (0, col, idle * 1000 / elapsed, 0);
+    col = put_str (0, col, (uint8_t*)"%, ");
+    col = put_col (0, col, stat->switches - last->switches, 0);
+    col = put_str (0, col, (uint8_t*)" switches, ");
+    col = put_col (0, col, stat->num_procs, 0);
+    put_str (0, col, (uint8_t*)" processes");
+
+    put_str (2, 0, (uint8_t*)"  PID TERM S NICE  %CPU  TIME ms    VCSW   IVCSW SYSCALLS NAME");
+    shown = stat->num_procs < CPUSTAT_MAX_PROCS ? stat->num_procs : CPUSTAT_MAX_PROCS;
+    for (i = 0, row = 3; i < shown && row < SCREEN_ROWS; i++, row++) {
+        p = &stat->procs[i];
+        col = put_col (row, 0, p->pid, 5);
+        col = put_col (row, col, p->terminal_id + 1, 5);
+        col = put_str (row, col, (uint8_t*)(TASK_RUNNABLE == p->state ? " R"
+                                          : TASK_BLOCKED == p->state ? " S" : " Z"));
+        col = put_signed (row, col, p->nice, 5);
+        col = put_permille (row, col, (p->runtime_ms - last_runtime (p->pid)) * 1000 / elapsed, 6);
+        col = put_col (row, col, p->runtime_ms, 9);
+        col = put_col (row, col, p->nvcsw, 8);
+        col = put_col (row, col, p->nivcsw, 8);
+        col = put_col (row, col, p->syscalls, 9);
+        col = put_str (row, col, (uint8_t*)" ");
+        put_str (row, col, p->name);
+    }
+    if (stat->num_procs > shown && row < SCREEN_ROWS) {
+        col = put_col (row, 0, stat->num_procs - shown, 0);
+        put_str (row, col, (uint8_t*)" more processes");
+    }
+}
+
+/* usage: top, redraws the screen every second until ctrl-c */
+int main ()
+{
+    int32_t rtc;
+    int32_t hz = RTC_HZ;
+    int32_t garbage;
+    uint32_t tick;
+    cpu_stat_t* swap;
+
+    if (-1 == ece391_vidmap (&screen)) {
+        ece391_fdputs (1, (uint8_t*)"vidmap failed\n");
+        return 3;
+    }
+    if (-1 == (rtc = ece391_open ((uint8_t*)"rtc"))
+            || -1 == ece391_write (rtc, &hz, sizeof (hz))) {
+        ece391_fdputs (1, (uint8_t*)"cannot open the rtc\n");
+        return 3;
+    }
+
+    while (1) {
+        if (-1 == ece391_cpustat (stat)) {
+            ece391_fdputs (1, (uint8_t*)"cpustat failed\n");
+            return 3;
+        }
+        draw ();
+        swap = last;
+        last = stat;
+        stat = swap;
+        for (tick = 0; tick < REFRESH_TICKS; tick++)
+            ece391_read (rtc, &garbage, sizeof (garbage));
+    }
+
+    return 0;
+}
@@ -0,0 +1,132 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define BUFSIZE             1024
+#define NUMBUF              12
+#define TRACE_WORST_LEN     32
+#define TRACE_HIST_BUCKETS  20
+
+#define TRACE_WAKE          0
+#define TRACE_SWITCH        1
+#define TRACE_TICK          2
+#define TRACE_PID_IDLE      0xFFFFFFFF
+#define TRACE_PID_KERNEL    0xFFFFFFFE
+
+/* same layout as wakeup_trace_t in the kernel */
+typedef struct {
+    uint32_t offset_us;
+    uint32_t type;
+    uint32_t pid;
+    uint32_t arg;
+} trace_event_t;
+
+typedef struct {
+    uint32_t count;
+    uint32_t avg_us;
+    uint32_t max_us;
+    uint32_t max_pid;
+    uint32_t hist[TRACE_HIST_BUCKETS];
+    uint32_t worst_len;
+    uint32_t worst_truncated;
+    trace_event_t worst[TRACE_WORST_LEN];
+} wakeup_trace_t;
+
+static wakeup_trace_t trace;
+
+/* print a number followed by a string */
+static void
+put_num (uint32_t value, const char* suffix)
+{
+    uint8_t buf[NUMBUF];
+
+    ece391_fdputs (1, ece391_itoa (value, buf, 10));
+    ece391_fdputs (1, (uint8_t*)suffix);
+}
+
+/* print a pid, or what runs without one */
+static void
+put_pid (uint32_t pid, const char* suffix)
+{
+    if (TRACE_PID_IDLE == pid)
+        ece391_fdputs (1, (uint8_t*)"idle");
+    else if (TRACE_PID_KERNEL == pid)
+        ece391_fdputs (1, (uint8_t*)"kernel");
+    else
+        put_num (pid, "");
+    ece391_fdputs (1, (uint8_t*)suffix);
+}
+
+/*
+ * usage: wakelat [reset]
+ * Prints how long woken processes waited for the cpu since boot or the
+ * last reset, and what the scheduler did during the worst wait. With
+ * "reset" the figures start over afterwards.
+ */
+int main ()
+{
+    uint8_t buf[BUFSIZE];
+    uint32_t reset = 0;
+    uint32_t i;
+    trace_event_t* ev;
+
+    if (0 == ece391_getargs (buf, BUFSIZE)) {
+        if (0 != ece391_strcmp (buf, (uint8_t*)"reset")) {
+            ece391_fdputs (1, (uint8_t*)"usage: wakelat [reset]\n");
+            return 3;
+        }
+        reset = 1;
+    }
+
+    if (-1 == ece391_wakeup_trace (&trace, reset)) {
+        ece391_fdputs (1, (uint8_t*)"wakeup_trace failed\n");
+        return 3;
+    }
+
+    put_num (trace.count, " wakeups, avg ");
+    put_num (trace.avg_us, " us, max ");
+    put_num (trace.max_us, " us for pid ");
+    put_pid (trace.max_pid, "\n");
+    for (i = 0; i < TRACE_HIST_BUCKETS; i++) {
+        if (0 == trace.hist[i])
+            continue;
+        if (TRACE_HIST_BUCKETS - 1 == i) {
+            ece391_fdputs (1, (uint8_t*)"  >= ");
+            put_num (1 << i, " us: ");
+        } else {
+            ece391_fdputs (1, (uint8_t*)"  < ");
+            put_num (1 << (i + 1), " us: ");
+        }
+        put_num (trace.hist[i], "\n");
+    }
+
+    if (0 == trace.worst_len)
+        return 0;
+    ece391_fdputs (1, (uint8_t*)"worst wakeup:\n");
+    if (trace.worst_truncated)
+        ece391_fdputs (1, (uint8_t*)"  ... earlier events lost\n");
+    for (i = 0; i < trace.worst_len; i++) {
+        ev = &trace.worst[i];
+        ece391_fdputs (1, (uint8_t*)"  +");
+        put_num (ev->offset_us, " us ");
+        switch (ev->type) {
+            case TRACE_WAKE:
+                ece391_fdputs (1, (uint8_t*)"wake ");
+                put_pid (ev->pid, " by ");
+                put_pid (ev->arg, "\n");
+                break;
+            case TRACE_SWITCH:
+                ece391_fdputs (1, (uint8_t*)"switch ");
+                put_pid (ev->arg, " -> ");
+                put_pid (ev->pid, "\n");
+                break;
+            default:
+                ece391_fdputs (1, (uint8_t*)"tick ");
+                put_pid (ev->pid, "\n");
+                break;
+        }
+    }
+
+    return 0;
+}